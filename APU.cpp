@@ -1,4 +1,5 @@
 #include "APU.h"
+#include "SaveState.h"
 #include <cstdio>
 #include <cstring>
 #include <iostream>
@@ -18,13 +19,13 @@ const uint8_t APU::LENGTH_TABLE[32] = {
     12, 16, 24, 18, 48, 20, 96, 22, 192, 24, 72, 26, 16, 28, 32, 30
 };
 
-APU::APU() {
+APU::APU(bool openDevice) {
     pulse1_duty = 0;
     pulse1_sweep = 0;
     pulse1_timer_low = 0;
     pulse1_length = 0;
     pulse1_timer = 0;
-    pulse1_timer_counter = 0.0f;
+    pulse1_timer_counter = 0;
     pulse1_duty_pos = 0;
     pulse1_volume = 0;
     pulse1_enabled = false;
@@ -39,6 +40,13 @@ APU::APU() {
     length_counter = 0;
     length_counter_halt = false;
 
+    frame_counter = 0;
+
+    audioDevice = 0;
+    if (!openDevice) {
+        return;
+    }
+
     SDL_Init(SDL_INIT_AUDIO);
     SDL_AudioSpec want;
     SDL_zero(want);
@@ -60,12 +68,19 @@ APU::APU() {
         printf("Failed to open audio: %s\n", SDL_GetError());
         return;
     }
+
+    // Decimate from the CPU clock to whatever rate the device actually gave us
+    resampler = std::make_unique<Resampler>(1789773.0, audioSpec.freq, audioQuality);
+    resampled.resize(resampler->maxOutputFor(SAMPLE_BLOCK));
+    outputQueue.assign(8192, 0.0f);
     SDL_PauseAudioDevice(audioDevice, 0);
 }
 
 APU::~APU() {
-    SDL_CloseAudioDevice(audioDevice);
-    SDL_Quit();
+    if (audioDevice != 0) {
+        SDL_CloseAudioDevice(audioDevice);
+        SDL_Quit();
+    }
 }
 
 void APU::writeRegister(uint16_t address, uint8_t value) {
@@ -122,39 +137,27 @@ uint8_t APU::readRegister(uint16_t address) {
     }
 }
 
+// Audio callback: drains the resampled queue filled by the emulation thread
 void APU::generateSamples(float* stream, int length) {
-    // std::cout << "[APU] Generating audio samples...\n";
-
-    if (!pulse1_enabled || pulse1_timer == 0) {
-        for (int i = 0; i < length; i++) {
-            stream[i] = 0.0f;
-        }
-        return;
-    }
-
-    float cpu_cycles_per_sample = 1789773.0f / audioSpec.freq;
-    float timer_period = pulse1_timer + 1;
+    size_t read = queueRead.load(std::memory_order_relaxed);
+    size_t write = queueWrite.load(std::memory_order_acquire);
+    size_t mask = outputQueue.size() - 1;
 
     for (int i = 0; i < length; i++) {
-        pulse1_timer_counter -= cpu_cycles_per_sample;
-        if (pulse1_timer_counter <= 0) {
-            pulse1_duty_pos = (pulse1_duty_pos + 1) % 8;
-            pulse1_timer_counter += timer_period;
+        // On underrun hold the last level instead of dropping to zero, which would click
+        if (read != write) {
+            lastSample = outputQueue[read & mask];
+            read++;
         }
-
-        uint8_t duty_cycle = (pulse1_duty >> 6) & 0x03;
-        float sample = DUTY_WAVEFORMS[duty_cycle][pulse1_duty_pos] ?
-                       (pulse1_volume / 15.0f) : 0.0f;
-
-        stream[i] = sample * 0.3f;
+        stream[i] = lastSample;
     }
+    queueRead.store(read, std::memory_order_release);
 }
 
 void APU::clock() {
     // Envelope clock (runs at ~240 Hz)
-    static uint32_t frame_counter = 0;
     frame_counter++;
-    if (frame_counter >= (1789773 / 240)) { // ~7459 CPU cycles per frame tick
+    if (frame_counter >= (1789773 / 240)) { // ~7457 CPU cycles per frame tick
         frame_counter = 0;
 
         // Update envelope
@@ -185,6 +188,67 @@ void APU::clock() {
             }
         }
     }
+
+    // Pulse timer is clocked every other CPU cycle, so the duty sequencer steps every 2 * (t + 1) CPU cycles
+    if (pulse1_timer_counter == 0) {
+        pulse1_timer_counter = 2 * (pulse1_timer + 1);
+        pulse1_duty_pos = (pulse1_duty_pos + 1) % 8;
+    }
+    pulse1_timer_counter--;
+
+    // Periods below 8 are muted by the sweep unit on hardware
+    float sample = 0.0f;
+    if (pulse1_enabled && pulse1_timer >= 8) {
+        uint8_t duty_cycle = (pulse1_duty >> 6) & 0x03;
+        sample = DUTY_WAVEFORMS[duty_cycle][pulse1_duty_pos] ? (pulse1_volume / 15.0f) * 0.3f : 0.0f;
+    }
+
+    if (!outputEnabled) {
+        return;
+    }
+    cpuSamples[cpuSampleCount++] = sample;
+    if (cpuSampleCount == SAMPLE_BLOCK) {
+        flushSamples();
+    }
+}
+
+// Resample a full block of CPU-rate samples and hand the result to the audio callback
+void APU::flushSamples() {
+    int count = cpuSampleCount;
+    cpuSampleCount = 0;
+
+    // Nobody is listening without a device, skip the filter entirely
+    if (audioDevice == 0) {
+        return;
+    }
+
+    int produced = resampler->process(cpuSamples, count, resampled.data(), static_cast<int>(resampled.size()));
+
+    size_t write = queueWrite.load(std::memory_order_relaxed);
+    size_t read = queueRead.load(std::memory_order_acquire);
+    size_t mask = outputQueue.size() - 1;
+    for (int i = 0; i < produced; i++) {
+        // Queue full means emulation is running ahead of the device, drop the excess
+        if (write - read >= outputQueue.size()) {
+            break;
+        }
+        outputQueue[write & mask] = resampled[i];
+        write++;
+    }
+    queueWrite.store(write, std::memory_order_release);
+}
+
+void APU::setAudioQuality(Resampler::Quality quality) {
+    audioQuality = quality;
+    if (resampler) {
+        resampler->configure(1789773.0, audioSpec.freq, quality);
+        resampled.resize(resampler->maxOutputFor(SAMPLE_BLOCK));
+    }
+}
+
+size_t APU::bufferBytes() const {
+    size_t bytes = (resampled.capacity() + outputQueue.capacity()) * sizeof(float);
+    return resampler ? bytes + sizeof(Resampler) + resampler->memoryBytes() : bytes;
 }
 
 void APU::reset() {
@@ -193,7 +257,7 @@ void APU::reset() {
     pulse1_timer_low = 0;
     pulse1_length = 0;
     pulse1_timer = 0;
-    pulse1_timer_counter = 0.0f;
+    pulse1_timer_counter = 0;
     pulse1_duty_pos = 0;
     pulse1_volume = 0;
     pulse1_enabled = false;
@@ -207,5 +271,56 @@ void APU::reset() {
 
     length_counter = 0;
     length_counter_halt = false;
+
+    frame_counter = 0;
+    cpuSampleCount = 0;
+    if (resampler) {
+        resampler->reset();
+    }
 }
 
+void APU::saveState(StateWriter& state) const {
+    size_t chunk = state.beginChunk(stateTag("APU "));
+    state.put(pulse1_duty);
+    state.put(pulse1_sweep);
+    state.put(pulse1_timer_low);
+    state.put(pulse1_length);
+    state.put(pulse1_timer);
+    state.put(pulse1_timer_counter);
+    state.put(pulse1_duty_pos);
+    state.put(pulse1_volume);
+    state.put(pulse1_enabled);
+    state.put(envelope_loop);
+    state.put(envelope_constant);
+    state.put(envelope_period);
+    state.put(envelope_counter);
+    state.put(envelope_volume);
+    state.put(envelope_start);
+    state.put(length_counter);
+    state.put(length_counter_halt);
+    state.put(frame_counter);
+    state.endChunk(chunk);
+}
+
+bool APU::loadState(StateReader& state) {
+    state.enterChunk(stateTag("APU "));
+    state.get(pulse1_duty);
+    state.get(pulse1_sweep);
+    state.get(pulse1_timer_low);
+    state.get(pulse1_length);
+    state.get(pulse1_timer);
+    state.get(pulse1_timer_counter);
+    state.get(pulse1_duty_pos);
+    state.get(pulse1_volume);
+    state.get(pulse1_enabled);
+    state.get(envelope_loop);
+    state.get(envelope_constant);
+    state.get(envelope_period);
+    state.get(envelope_counter);
+    state.get(envelope_volume);
+    state.get(envelope_start);
+    state.get(length_counter);
+    state.get(length_counter_halt);
+    state.get(frame_counter);
+    return state.leaveChunk();
+}
@@ -1,22 +1,45 @@
 #ifndef APU_H
 #define APU_H
 
+#include <atomic>
 #include <cstdint>
+#include <memory>
+#include <vector>
 #define SDL_MAIN_HANDLED
 #include <SDL2/SDL.h>
+#include "Resampler.h"
+
+class StateWriter;
+class StateReader;
 
 class APU {
 public:
-    APU();
+    // Without `openDevice` no SDL audio device is opened and nothing is resampled (headless / batch runs)
+    explicit APU(bool openDevice = true);
     ~APU();
 
     void writeRegister(uint16_t address, uint8_t value);
     uint8_t readRegister(uint16_t address);
     void generateSamples(float* stream, int length);
 
-    void clock();       // Step APU internals (envelope, length counter)
+    void clock();       // Step APU internals once per CPU cycle and emit one CPU-rate sample
     void reset();       // Reset APU state
 
+    // When false, channels keep running but no samples are emitted (run-ahead frames that get rolled back)
+    bool outputEnabled = true;
+
+    // Resampler quality for the CPU rate -> device rate conversion
+    void setAudioQuality(Resampler::Quality quality);
+    Resampler::Quality getAudioQuality() const { return audioQuality; }
+
+    // Heap bytes of the audio path (resampler tables, sample queues), zero without a device
+    size_t bufferBytes() const;
+
+    // Save state. Only the channel state is stored; samples already queued for the device
+    // keep playing after a load, so a rewind does not click on an emptied queue.
+    void saveState(StateWriter& state) const;
+    bool loadState(StateReader& state);
+
 private:
     // Pulse 1 registers
     uint8_t pulse1_duty;        // $4000: Duty and envelope/volume
@@ -26,7 +49,7 @@ private:
 
     // Pulse 1 internal state
     uint16_t pulse1_timer;      // 11-bit timer value
-    float pulse1_timer_counter; // Timing accumulator
+    uint16_t pulse1_timer_counter; // CPU cycles left until the next duty step
     uint8_t pulse1_duty_pos;    // Duty cycle position
     uint8_t pulse1_volume;      // Current volume (from envelope or constant)
     bool pulse1_enabled;        // Channel enabled flag
@@ -43,9 +66,28 @@ private:
     uint8_t length_counter;     // Counts down to silence channel
     bool length_counter_halt;   // From $4000 bit 5 (same as envelope_loop)
 
+    // Frame sequencer divider (CPU cycles until the next 240 Hz tick)
+    uint32_t frame_counter;
+
     SDL_AudioSpec audioSpec;
     SDL_AudioDeviceID audioDevice;
 
+    // CPU-rate samples are gathered into blocks and resampled on the emulation thread
+    static const int SAMPLE_BLOCK = 1024;
+    float cpuSamples[SAMPLE_BLOCK];
+    int cpuSampleCount = 0;
+    // Only built once a device is open, headless instances never produce output samples
+    Resampler::Quality audioQuality = Resampler::MEDIUM;
+    std::unique_ptr<Resampler> resampler;
+    std::vector<float> resampled;
+    void flushSamples();
+
+    // Single producer (emulation) / single consumer (SDL callback) queue of device-rate samples
+    std::vector<float> outputQueue;
+    std::atomic<size_t> queueRead{0};
+    std::atomic<size_t> queueWrite{0};
+    float lastSample = 0.0f;
+
     static const uint8_t DUTY_WAVEFORMS[4][8];
     static const uint8_t LENGTH_TABLE[32]; // Lookup table for length counter
 };
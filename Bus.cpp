@@ -1,20 +1,25 @@
 #include "Bus.h"
 #include "CPU.h"
+#include "HostZones.h"
+#include "Log.h"
+#include "Mapper.h"
+#include "Movie.h"
+#include "SaveState.h"
 #include <thread>
-#include <iostream>
 
-Bus::Bus() {
-    cpu = new CPU();
-    apu = new APU();
-    cpu->connectBus(this);  // Connect CPU to Bus
-}
-
-Bus::~Bus() {
-    delete cpu;
-    delete apu;
-}
+Bus::Bus(CPU& cpu, APU& apu) : cpu(cpu), apu(apu) {}
 
 void Bus::write(uint16_t address, uint8_t data) {
+    if (rom == nullptr) {
+        if (flatMemory) {
+            if (accessLog) {
+                accessLog->push_back({address, data, true});
+            }
+            testFallbackRAM(address) = data;
+            return;
+        }
+    }
+
     // Handles CPU RAM --> 0x0000-0x1FFF (mirrored every 0x0800)
     if (address <= 0x1FFF) {
         cpuRam[address & 0x07FF] = data;
@@ -23,73 +28,66 @@ void Bus::write(uint16_t address, uint8_t data) {
 
     // Handles PPU registers --> 0x2000-0x3FFF (mirrored every 8 bytes)
     if (address >= 0x2000 && address <= 0x3FFF) {
+        perf.ppuWrites++;
+        perf.ppuWritesByScanline[(ppu.scanline + 1) % PerfCounters::SCANLINES]++;
         ppu.cpuWrite(address & 0x0007, data);
         return;
     }
 
     // Handles APU registers --> 0x4000-0x4013, 0x4015, 0x4017
     if ((address >= 0x4000 && address <= 0x4013) || address == 0x4015 || address == 0x4017) {
-        apu->writeRegister(address, data);
+        apu.writeRegister(address, data);
         return;
     }
 
     // Handles OAM DMA --> 0x4014
     if (address == 0x4014) {
+        perf.dmaTransfers++;
         DMATransfer = true;
         DMAPage = data;
         DMAAddress = 0x00;
         return;
     }
 
-    // Handles controller ports (placeholder)
-    if (address == 0x4016 || address == 0x4017) {
-        // TODO: Implement controller writing
+    // Controller strobe: setting bit 0 latches the buttons into the shift register
+    if (address == 0x4016) {
+        controllerStrobe = data & 1;
+        if (controllerStrobe) {
+            latchController();
+        }
         return;
     }
 
-    // If ROM is connected, handle cartridge space writes
-    if (rom && address >= 0x4020 && address <= 0xFFFF) {
-        bool handled = false;
-
-        // NROM-128 or NROM-256
-        if (rom->ROMheader.flags6 == 0x00 || rom->ROMheader.flags6 == 0x01) {
-            uint16_t offset;
-            if (rom->mirrored && address >= 0xC000) {
-                offset = address - 0xC000;
-                if (offset < 0x4000) {
-                    rom->prgRom[offset] = data;
-                    handled = true;
-                }
-            } else if (!rom->mirrored && address >= 0x8000) {
-                offset = address - 0x8000;
-                if (offset < rom->ROMheader.prgRomSize * 16 * 1024) {
-                    rom->prgRom[offset] = data;
-                    handled = true;
-                }
-            }
-        }
-
-        if (!handled) {
-            static int warnCount = 0;
-            if (warnCount++ < 10) {
-                std::cerr << "Warning: Ignored write to PRG-ROM at 0x" << std::hex << address << "\n";
-            } else if (warnCount == 10) {
-                std::cerr << "(Further PRG-ROM write warnings suppressed...)\n";
-            }
-        }
-
+    // If ROM is connected, handle cartridge space writes. $8000-$FFFF is where mappers keep
+    // their registers and $6000-$7FFF is work RAM; nothing is emulated between the APU and that.
+    if (rom && address >= 0x8000) {
+        rom->writeMemoryPRG(address, data);
+        return;
+    }
+    if (rom && address >= 0x6000) {
+        rom->writeMemoryPRGRAM(address, data);
+        return;
+    }
+    if (rom && address >= 0x4020) {
+        NES_LOG_WARN("Ignored write to cartridge space at $%04X", address);
         return;
     }
 
     // Default fallback (always works for tests)
-    testFallbackRAM[address] = data;
+    testFallbackRAM(address) = data;
 }
 
 
 uint8_t Bus::read(uint16_t address) {
     if (rom == nullptr) {
-        std::cerr << "ERROR: Bus::read() called before ROM is connected! Address: 0x"
-                  << std::hex << address << "\n";
+        if (flatMemory) {
+            uint8_t data = testFallbackRAM(address);
+            if (accessLog) {
+                accessLog->push_back({address, data, false});
+            }
+            return data;
+        }
+        NES_LOG_WARN("Read from $%04X with no cartridge connected", address);
     }
 
     // Handles CPU RAM --> 0x0000-0x1FFF
@@ -99,12 +97,13 @@ uint8_t Bus::read(uint16_t address) {
 
     // Handles PPU registers --> 0x2000-0x3FFF
     if (address >= 0x2000 && address <= 0x3FFF) {
+        perf.statusPolls += (address & 0x0007) == 0x0002;
         return ppu.cpuRead(address & 0x0007);
     }
 
     // Handles APU registers --> 0x4000–0x4017
     if ((address >= 0x4000 && address <= 0x4013) || address == 0x4015 || address == 0x4017) {
-        return apu->readRegister(address);
+        return apu.readRegister(address);
     }
 
     // Handles OAM DMA
@@ -114,30 +113,47 @@ uint8_t Bus::read(uint16_t address) {
 
     // Controller reading
     if (address == 0x4016) {
-        if (controller_read == 8) {
-            copyController = controller1;
-            controller_read = 0;
-        }
         uint8_t data = copyController.reg & 1;
-        copyController.reg >>= 1;
-        controller_read++;
+        if (!controllerStrobe) {
+            // A standard controller returns 1 once all eight buttons are out
+            copyController.reg = static_cast<uint8_t>((copyController.reg >> 1) | 0x80);
+        }
         return data;
     }
 
-    // Cartridge memory space
-    if (address >= 0x4020 && address <= 0xFFFF && rom) {
+    // Cartridge memory space: PRG ROM through the mapper's windows, work RAM below that
+    if (rom && address >= 0x8000) {
         return rom->readMemoryPRG(address);
     }
+    if (rom && address >= 0x6000) {
+        return rom->readMemoryPRGRAM(address);
+    }
+    if (rom && address >= 0x4020) {
+        return 0;
+    }
+
+    NES_LOG_DEBUG("Fallback test RAM read at $%04X = $%02X", address, testFallbackRAM(address));
+    return testFallbackRAM(address);
+}
 
-    std::cerr << "Fallback test RAM used at 0x" << std::hex << address
-          << " = 0x" << std::hex << int(testFallbackRAM[address]) << "\n";
-    return testFallbackRAM[address];
+uint8_t& Bus::testFallbackRAM(uint16_t address) {
+    if (!fallbackRAM) {
+        fallbackRAM = std::make_unique<uint8_t[]>(0x10000);
+    }
+    return fallbackRAM[address];
 }
 
 
+void Bus::latchController() {
+    if (movie != nullptr) {
+        movie->latch(ppu.total_frames, controller1.reg);
+    }
+    copyController = controller1;
+}
+
 void Bus::reset() {
-    cpu->reset();
-    apu->reset();
+    cpu.reset();
+    apu.reset();
     ppu.reset();
     clockCounter = 0;
     cpuClockCounter = 0;
@@ -149,15 +165,31 @@ void Bus::reset() {
 }
 
 void Bus::clock() {
-    // Cycle ppu & apu every clock cycle
-    ppu.clock();
-    apu->clock();
+    // Cycle ppu every clock cycle
+    {
+        NES_ZONE(PPU);
+        ppu.clock();
+    }
 
     // CPU is three times slower than ppu
     if (clockCounter % 3 == 0) {
+        // APU runs off the CPU clock, DMA does not stall it
+        {
+            NES_ZONE(APU);
+            apu.clock();
+        }
+
+        // The PPU has reached the A12 edge it scheduled for this line (never, unless a mapper watches A12)
+        if (ppu.cycle >= ppu.nextA12Edge) {
+            ppu.a12EdgeTaken();
+            rom->mapper->clockScanline();
+        }
 
         // Check if a DMA transfer is happening, it suspends the CPU
+        perf.cpuCycles++;
         if (DMATransfer) {
+            NES_COUNT(DMA_CYCLES, 1);
+            perf.dmaStallCycles++;
             if (!DMACanStart) {
                 if (clockCounter % 2 == 1) {
                     DMACanStart = true;
@@ -183,7 +215,15 @@ void Bus::clock() {
         }
         // If no DMA transfer, cycle CPU
         else {
-            cpu->cycleExecute();
+            NES_ZONE(CPU);
+            NES_COUNT(CPU_CYCLES, 1);
+            if (cartridgeIrq && cpu.cycles == 0) {
+                cpu.irq_interrupt();
+                // Taken unless the I flag masked it, in which case the next instruction starts now
+                perf.irqs += cpu.cycles != 0;
+            }
+            perf.instructions += cpu.cycles == 0;
+            cpu.cycleExecute();
             cpuClockCounter++;
         }
 
@@ -192,14 +232,51 @@ void Bus::clock() {
     // if vblank started, inform cpu through nmi interrupt.
     if (ppu.nmi) {
         ppu.nmi = false;
-        cpu->nmi_interrupt();
+        perf.nmis++;
+        cpu.nmi_interrupt();
     }
 
     clockCounter++;
 }
 
 void Bus::connectROM(NESROM& ROM) {
-    std::cout << "Bus::connectROM() called — assigning rom pointer!\n";
+    NES_LOG_DEBUG("Connecting cartridge");
     ppu.connectROM(ROM);
     rom = &ROM;
+    cartridgeIrq = false;
+    if (ROM.mapper) {
+        ROM.mapper->attach(&ppu, &cartridgeIrq, &perf.bankSwitches);
+    }
+}
+
+void Bus::saveState(StateWriter& state) const {
+    size_t chunk = state.beginChunk(stateTag("BUS "));
+    state.write(cpuRam.data(), cpuRam.size());
+    state.put(controller1.reg);
+    state.put(copyController.reg);
+    state.put(controllerStrobe);
+    state.put(clockCounter);
+    state.put(cpuClockCounter);
+    state.put(DMATransfer);
+    state.put(DMACanStart);
+    state.put(DMAPage);
+    state.put(DMAAddress);
+    state.put(DMAData);
+    state.endChunk(chunk);
+}
+
+bool Bus::loadState(StateReader& state) {
+    state.enterChunk(stateTag("BUS "));
+    state.read(cpuRam.data(), cpuRam.size());
+    state.get(controller1.reg);
+    state.get(copyController.reg);
+    state.get(controllerStrobe);
+    state.get(clockCounter);
+    state.get(cpuClockCounter);
+    state.get(DMATransfer);
+    state.get(DMACanStart);
+    state.get(DMAPage);
+    state.get(DMAAddress);
+    state.get(DMAData);
+    return state.leaveChunk();
 }
@@ -3,24 +3,31 @@
 
 #include <array>
 #include <cstdint>
+#include <memory>
+#include <vector>
 #include "PPU.h"
 #include "ROM.h"
 #include "APU.h"
+#include "PerfCounters.h"
+
+class Movie;
 
 class CPU;
 class APU;
+class StateWriter;
+class StateReader;
 
 class Bus {
 public:
-    Bus();  // Constructor
-    ~Bus(); // Destructor
+    // The CPU and APU live next to the bus in NES; the references never change
+    Bus(CPU& cpu, APU& apu);
 
     // Devices
-    CPU* cpu;
-    APU* apu;
+    CPU& cpu;
+    APU& apu;
     PPU  ppu;
     std::array<uint8_t, 2 * 1024> cpuRam{}; // 2KB of CPU RAM
-    NESROM* rom;
+    NESROM* rom = nullptr;
 
 
     union controller {
@@ -34,26 +41,72 @@ public:
             uint8_t left: 1;
             uint8_t right: 1;
         }; uint8_t reg;
-    } controller1;
-    controller copyController;
-    int controller_read = 0;
+    } controller1{};
+    // Shift register the game reads controller 1 from; reloaded from controller1 at the strobe
+    controller copyController{};
+    // $4016 bit 0: while high, reads return A and the shift register does not shift
+    bool controllerStrobe = false;
+    // Input movie fed from / recorded at each strobe (see Movie.h), null when none is attached
+    Movie* movie = nullptr;
 
     // Bus read and write functions
     void write(uint16_t address, uint8_t data);
     uint8_t read(uint16_t address);
 
+    // What a read would return for RAM and cartridge memory, without side effects; 0 for registers.
+    // For tracers and debuggers.
+    uint8_t peek(uint16_t address) const {
+        if (address <= 0x1FFF) {
+            return cpuRam[address & 0x07FF];
+        }
+        if (rom && address >= 0x8000) {
+            return rom->readMemoryPRG(address);
+        }
+        if (rom && address >= 0x6000) {
+            return rom->readMemoryPRGRAM(address);
+        }
+        return 0;
+    }
+
     void reset();
     void clock();
 
     // Connect Game Rom to Bus
     void connectROM(NESROM& ROM);
 
+    // Save state (bus-owned state only: RAM, controller shift register, clocks, DMA)
+    void saveState(StateWriter& state) const;
+    bool loadState(StateReader& state);
+
     uint32_t clockCounter = 0;
-    uint32_t cpuClockCounter = 0;
+    uint64_t cpuClockCounter = 0;   // CPU cycles since power on; 64 bits so traces never wrap
+
+    // Counters for the frame in progress (see PerfCounters.h); NES::run_frame takes them at the
+    // frame boundary
+    PerfCounters perf;
 
-    // Fallback RAM for testing without ROM
-    uint8_t testFallbackRAM[0x10000]{};
+    // Cartridge /IRQ output. Level triggered: the CPU keeps taking the interrupt at instruction
+    // boundaries (while I is clear) until the mapper releases the line.
+    bool cartridgeIrq = false;
+
+    // CPU test harness mode: with no cartridge connected every address is plain RAM (the fallback
+    // RAM below), and each access is appended to `accessLog` when one is set
+    struct Access {
+        uint16_t address;
+        uint8_t value;
+        bool write;
+    };
+    bool flatMemory = false;
+    std::vector<Access>* accessLog = nullptr;
+
+    // Fallback RAM for testing without ROM, allocated on first use
+    uint8_t& testFallbackRAM(uint16_t address);
+    size_t fallbackRAMBytes() const { return fallbackRAM ? 0x10000 : 0; }
 private:
+    std::unique_ptr<uint8_t[]> fallbackRAM;
+
+    void latchController();
+
     // Device status
 
     bool DMATransfer = false;
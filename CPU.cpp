@@ -1,39 +1,41 @@
 #include "CPU.h"
 #include "Bus.h"
+#include "Debugger.h"
+#include "GuestProfiler.h"
+#include "Log.h"
+#include "SaveState.h"
+#include "Trace.h"
 #include <cstdio>
 #include <cstdint>
 #include <iostream>
 #include <iomanip>
+#include <mutex>
 
-CPU::CPU() : bus(nullptr), A(0x00), X(0x00), Y(0x00), S(0xFD), PC(0x0000), P(0x00), cycles(0) {
-    std::cout << "CPU constructor: PC = " << std::hex << PC << "\n";
-    initInstructionTable();
-    std::cout << "After initInstructionTable: PC = " << std::hex << PC << "\n";
+CPU::Instruction CPU::instructionTable[256];
+
+CPU::CPU(Bus& bus) : bus(bus), A(0x00), X(0x00), Y(0x00), S(0xFD), PC(0x0000), P(0x00), cycles(0) {
+    static std::once_flag tableBuilt;
+    std::call_once(tableBuilt, &CPU::initInstructionTable);
+    NES_LOG_DEBUG("CPU constructed");
 }
 
 CPU::~CPU() {
     // no cleanup needed atm
 }
 
-void CPU::connectBus(Bus* bus) {
-    this->bus = bus;
-}
-
 void CPU::writeBus(uint16_t address, uint8_t value) {
-    if (bus) {
-        bus->write(address, value);
-    } else {
-        throw std::runtime_error("CPU: Bus not connected");
+    if (debugger != nullptr && debugger->has(Debugger::WRITE, address)) {
+        debugger->access(Debugger::WRITE, address, value, bus);
     }
+    bus.write(address, value);
 }
 
 uint8_t CPU::readBus(uint16_t address) {
-    if (bus) {
-        return bus->read(address);
-    } else {
-        throw std::runtime_error("CPU: Bus not connected");
-        return 0;
+    uint8_t value = bus.read(address);
+    if (debugger != nullptr && debugger->has(Debugger::READ, address)) {
+        debugger->access(Debugger::READ, address, value, bus);
     }
+    return value;
 }
 
 // Sets or clears a bit of the status register
@@ -58,40 +60,22 @@ void CPU::printRegisters() const {
 
 // Set the CPU registers as specified by a console reset
 void CPU::reset() {
-    std::cout << "🛠 CPU::reset() called\n";
-
     const uint16_t read_address = 0xFFFC;
 
-    // Step 1: Confirm bus pointer is valid
-    if (bus == nullptr) {
-        std::cerr << "ERROR: CPU::bus is nullptr during reset!\n";
-        return;
-    } else {
-        std::cout << "Bus pointer is valid\n";
-    }
-
-    // Step 2: Try reading reset vector
-    std::cout << "Attempting to read from 0xFFFC and 0xFFFD...\n";
+    // Step 1: Read the reset vector
     uint16_t lo = readBus(read_address);
-    std::cout << "Read 0xFFFC (low byte): 0x" << std::hex << int(lo) << "\n";
-
     uint16_t hi = readBus(read_address + 1);
-    std::cout << "Read 0xFFFD (high byte): 0x" << std::hex << int(hi) << "\n";
 
-    // Step 3: Set PC
+    // Step 2: Set PC
     PC = (hi << 8) | lo;
-    std::cout << "PC set to 0x" << std::hex << PC << "\n";
 
-    // Step 4: Reset stack and flags
+    // Step 3: Reset stack and flags
     S = 0xFD;
     P = 0x00;
-    std::cout << "Stack pointer reset to 0xFD, Status set to 0x00\n";
-
     setFlag(I, true);
     setFlag(U, true);
-    std::cout << "⚙Flags I and U set\n";
 
-    std::cout << "CPU::reset() completed successfully\n";
+    NES_LOG_DEBUG("CPU reset, PC = $%04X", PC);
 }
 
 // Read and execute cycles until the next instruction has ran
@@ -108,16 +92,22 @@ int CPU::cycleExecute() {
 
     // Ready to run next instruction
     if (cycles == 0) {
+#ifdef NES_PROFILE
+        uint16_t opcodeAddress = PC;
+#endif
         // Read the opcode
         uint8_t opcode = readBus(PC++);
-        // printf("Opcode: %02X\n", opcode);
-        // printRegisters();
+#ifdef NES_TRACE
+        if (trace != nullptr) {
+            traceInstruction(opcode);
+        }
+#endif
 
         // Get the address mode and instruction type from the opcode
         //std::cout << "Opcode: 0x" << std::hex << std::uppercase << std::setw(2) << std::setfill('0') << static_cast<int>(opcode) << std::endl;
         Instruction opcodeInstr = instructionTable[opcode];
         if (opcodeInstr.operation == nullptr || opcodeInstr.addressingMode == nullptr) {
-            std::cout << "Error: Invalid opcode";
+            NES_LOG_ERROR("Invalid opcode $%02X at $%04X", opcode, static_cast<uint16_t>(PC - 1));
         }
 
         // Find the address, cycles and additional cycles
@@ -132,6 +122,11 @@ int CPU::cycleExecute() {
         if (res.additionalCycles) {
             cycles += instrCycles;
         }
+#ifdef NES_PROFILE
+        if (profiler != nullptr) {
+            profiler->instruction(opcodeAddress, opcode, cycles, *this);
+        }
+#endif
 
         // Return ran
         ran = 0;
@@ -144,6 +139,24 @@ int CPU::cycleExecute() {
     return ran;
 }
 
+// Registers as they are before the instruction runs; operands are peeked so tracing has no side effects
+void CPU::traceInstruction(uint8_t opcode) {
+    TraceRecord entry;
+    entry.cycle = bus.cpuClockCounter;
+    entry.pc = static_cast<uint16_t>(PC - 1);
+    entry.opcode = opcode;
+    entry.operand[0] = bus.peek(PC);
+    entry.operand[1] = bus.peek(static_cast<uint16_t>(PC + 1));
+    entry.a = A;
+    entry.x = X;
+    entry.y = Y;
+    entry.p = P;
+    entry.s = S;
+    entry.scanline = bus.ppu.scanline;
+    entry.dot = bus.ppu.cycle;
+    trace->record(entry);
+}
+
 // ---------------------------------------------------------------------------- //
 // ----------------------------- INSTRUCTIONS TABLE --------------------------- //
 // ---------------------------------------------------------------------------- //
@@ -1534,6 +1547,11 @@ void CPU::nmi_interrupt() {
     uint16_t hi = readBus(PC + 1);
     PC = (hi << 8) | lo;
     cycles += 8;
+#ifdef NES_PROFILE
+    if (profiler != nullptr) {
+        profiler->interrupt(GuestProfiler::NMI, 8, *this);
+    }
+#endif
 }
 
 // CPU Handling of an IRQ Interrupt
@@ -1550,5 +1568,38 @@ void CPU::irq_interrupt() {
         uint16_t lo = readBus(read_address);
         uint16_t hi = readBus(read_address + 1);
         PC = (hi << 8) | lo;
+        cycles += 7;
+#ifdef NES_PROFILE
+        if (profiler != nullptr) {
+            profiler->interrupt(GuestProfiler::IRQ, 7, *this);
+        }
+#endif
     }
 }
+
+// ---------------------------------------------------------------------------- //
+// -------------------------------- SAVE STATE -------------------------------- //
+// ---------------------------------------------------------------------------- //
+void CPU::saveState(StateWriter& state) const {
+    size_t chunk = state.beginChunk(stateTag("CPU "));
+    state.put(A);
+    state.put(X);
+    state.put(Y);
+    state.put(S);
+    state.put(PC);
+    state.put(P);
+    state.put(cycles);
+    state.endChunk(chunk);
+}
+
+bool CPU::loadState(StateReader& state) {
+    state.enterChunk(stateTag("CPU "));
+    state.get(A);
+    state.get(X);
+    state.get(Y);
+    state.get(S);
+    state.get(PC);
+    state.get(P);
+    state.get(cycles);
+    return state.leaveChunk();
+}
@@ -8,10 +8,16 @@
 #include <cstdint>
 
 class Bus;
+class Debugger;
+class TraceLog;
+class GuestProfiler;
+class StateWriter;
+class StateReader;
 
 class CPU {
 public:
-    CPU();
+    // The bus is fixed for the CPU's lifetime; NES builds both side by side
+    explicit CPU(Bus& bus);
     ~CPU();
 
     // Registers (initialized in .cpp constructor)
@@ -41,17 +47,29 @@ public:
     uint8_t readBus(uint16_t address);
 
     // Various helper functions
-    void connectBus(Bus* bus);
     void reset();
     void execute();
     int cycleExecute();
     void printRegisters() const;
-    void initInstructionTable();
+    // Fills the opcode table shared by every CPU, runs once from the first constructor
+    static void initInstructionTable();
 
     // Interrupt Handling
     void nmi_interrupt();
     void irq_interrupt();
 
+    // Save state
+    void saveState(StateWriter& state) const;
+    bool loadState(StateReader& state);
+
+    // Receives every instruction the CPU starts in builds with NES_TRACE (see Trace.h), ignored otherwise.
+    // The member exists either way so the layout does not depend on the flag.
+    TraceLog* trace = nullptr;
+    // Same for the game code profiler in builds with NES_PROFILE (see GuestProfiler.h)
+    GuestProfiler* profiler = nullptr;
+    // Set by NES::run_frame only while the debugger watches memory, so unwatched runs pay one null test per access
+    Debugger* debugger = nullptr;
+
     // Flag operations
     void setFlag(FLAGS flag, bool set);
     uint8_t getFlag(FLAGS flag) const;
@@ -72,7 +90,7 @@ public:
         int (CPU::*operation)(uint16_t);
         AddressResult (CPU::*addressingMode)();
     };
-    Instruction instructionTable[256];
+    static Instruction instructionTable[256];
 
     // Addressing Modes
     AddressResult Implicit();
@@ -181,7 +199,9 @@ public:
     int AXS(uint16_t address);
 
 private:
-    Bus* bus; // Pointer to the Bus for memory operations
+    Bus& bus; // Bus for memory operations
+
+    void traceInstruction(uint8_t opcode);
 
 
 };
@@ -0,0 +1,167 @@
+#include "Debugger.h"
+#include "Bus.h"
+#include "CPU.h"
+
+void Debugger::add(uint8_t kinds, uint16_t first, uint16_t last) {
+    if (!maps) {
+        maps = std::make_unique<Maps>();
+    }
+    for (uint32_t address = first; address <= last; address++) {
+        for (int kind = 0; kind < 3; kind++) {
+            uint64_t bit = uint64_t(1) << (address & 63);
+            uint64_t& word = maps->bits[kind][address >> 6];
+            if ((kinds >> kind & 1) && !(word & bit)) {
+                word |= bit;
+                points++;
+                memoryPoints += kind != 0;
+            }
+        }
+        updatePage(static_cast<uint8_t>(address >> 8));
+    }
+}
+
+void Debugger::remove(uint8_t kinds, uint16_t first, uint16_t last) {
+    if (!maps) {
+        return;
+    }
+    for (uint32_t address = first; address <= last; address++) {
+        for (int kind = 0; kind < 3; kind++) {
+            uint64_t bit = uint64_t(1) << (address & 63);
+            uint64_t& word = maps->bits[kind][address >> 6];
+            if ((kinds >> kind & 1) && (word & bit)) {
+                word &= ~bit;
+                points--;
+                memoryPoints -= kind != 0;
+            }
+        }
+        updatePage(static_cast<uint8_t>(address >> 8));
+    }
+}
+
+void Debugger::updatePage(uint8_t page) {
+    uint8_t kinds = 0;
+    for (int kind = 0; kind < 3; kind++) {
+        const uint64_t* words = &maps->bits[kind][page * 4];
+        if (words[0] | words[1] | words[2] | words[3]) {
+            kinds |= 1 << kind;
+        }
+    }
+    pages[page] = kinds;
+}
+
+void Debugger::addPpuDot(int scanline, int dot) {
+    if (scanline < -1 || scanline >= SCANLINES - 1 || dot < 0 || dot >= DOTS) {
+        return;
+    }
+    if (ppuDots.empty()) {
+        ppuDots.assign((SCANLINES * DOTS + 63) / 64, 0);
+    }
+    size_t index = static_cast<size_t>(scanline + 1) * DOTS + dot;
+    uint64_t bit = uint64_t(1) << (index & 63);
+    if (!(ppuDots[index >> 6] & bit)) {
+        ppuDots[index >> 6] |= bit;
+        ppuPoints++;
+    }
+}
+
+void Debugger::clear() {
+    // The instruction in progress is the machine's, not a point; a stop right after clear() reports it
+    uint16_t pc = instructionPC;
+    *this = Debugger();
+    instructionPC = pc;
+}
+
+size_t Debugger::mapBytes() const {
+    return (maps ? sizeof(Maps) : 0) + ppuDots.capacity() * sizeof(uint64_t);
+}
+
+void Debugger::untilPC(uint16_t pc) {
+    untilFlags |= UNTIL_PC_FLAG;
+    untilPc = pc;
+}
+
+void Debugger::untilValue(uint16_t address, uint8_t value) {
+    untilFlags |= UNTIL_VALUE_FLAG;
+    untilAddress = address;
+    untilData = value;
+}
+
+void Debugger::untilFrame(uint32_t frame) {
+    untilFlags |= UNTIL_FRAME_FLAG;
+    untilFrameNumber = frame;
+}
+
+void Debugger::resume() {
+    if (current.reason == Reason::BREAKPOINT || current.reason == Reason::UNTIL_PC) {
+        skipOnce = true;
+        skipPC = current.pc;
+    }
+    current = Stop();
+}
+
+bool Debugger::halt(Reason reason, const Bus& bus) {
+    current.reason = reason;
+    current.pc = instructionPC;
+    current.scanline = bus.ppu.scanline;
+    current.dot = bus.ppu.cycle;
+    current.frame = bus.ppu.total_frames;
+    // A condition is met once; points stay until removed
+    if (reason == Reason::UNTIL_PC) {
+        untilFlags &= ~UNTIL_PC_FLAG;
+    } else if (reason == Reason::UNTIL_VALUE) {
+        untilFlags &= ~UNTIL_VALUE_FLAG;
+    } else if (reason == Reason::UNTIL_FRAME) {
+        untilFlags &= ~UNTIL_FRAME_FLAG;
+    }
+    return true;
+}
+
+void Debugger::access(Access kind, uint16_t address, uint8_t value, const Bus& bus) {
+    if (stopped() || !has(kind, address)) {
+        return;
+    }
+    halt(kind == READ ? Reason::READ : Reason::WRITE, bus);
+    current.address = address;
+    current.value = value;
+}
+
+bool Debugger::instruction(const Bus& bus) {
+    uint16_t pc = bus.cpu.PC;
+    instructionPC = pc;
+    if (skipOnce && pc == skipPC) {
+        return false;
+    }
+    skipOnce = false;
+    if (has(EXECUTE, pc)) {
+        return halt(Reason::BREAKPOINT, bus);
+    }
+    if ((untilFlags & UNTIL_PC_FLAG) && pc == untilPc) {
+        return halt(Reason::UNTIL_PC, bus);
+    }
+    if ((untilFlags & UNTIL_VALUE_FLAG) && bus.peek(untilAddress) == untilData) {
+        halt(Reason::UNTIL_VALUE, bus);
+        current.address = untilAddress;
+        current.value = untilData;
+        return true;
+    }
+    return false;
+}
+
+bool Debugger::dot(const Bus& bus) {
+    // The instruction a resume let through has started (or an interrupt came first)
+    if (skipOnce && bus.cpu.cycles != 0) {
+        skipOnce = false;
+    }
+    if (stopped()) {
+        return true;
+    }
+    if (ppuPoints == 0) {
+        return false;
+    }
+    size_t index = static_cast<size_t>(bus.ppu.scanline + 1) * DOTS + bus.ppu.cycle;
+    return (ppuDots[index >> 6] >> (index & 63) & 1) && halt(Reason::PPU_DOT, bus);
+}
+
+bool Debugger::frameDone(const Bus& bus) {
+    return (untilFlags & UNTIL_FRAME_FLAG) && bus.ppu.total_frames >= untilFrameNumber && halt(Reason::UNTIL_FRAME, bus);
+}
@@ -0,0 +1,117 @@
+#ifndef DEBUGGER_H
+#define DEBUGGER_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class Bus;
+
+// Breakpoints, watchpoints and run-until conditions for one machine (NES::debugger).
+//
+// Execute, read and write points live in one 64 K-bit map per kind, with a byte per 256-byte page
+// saying which kinds have any point on that page. A CPU access checks the page byte and only looks
+// at the bit map when the page is watched. The maps (24 KB) are allocated by the first add() and
+// freed by clear(), so a machine nobody debugs carries only the page bytes. With nothing set the
+// machine does not look at all:
+// NES::run_frame only takes the checked loop while armed() and the CPU only sees the debugger while
+// memory is watched, so an unarmed machine runs the same loop it always did.
+//
+// Execute points and run-until conditions stop before the instruction at PC runs; read and write
+// watchpoints stop after the instruction that made the access (every CPU access counts, opcode and
+// operand fetches included); PPU points stop after the PPU reaches the scanline and dot. A stop
+// ends run_frame() early, mid-frame; the next run_frame() carries on from there, after resume().
+class Debugger {
+public:
+    enum Access : uint8_t { EXECUTE = 1, READ = 2, WRITE = 4 };
+
+    enum class Reason : uint8_t {
+        NONE,
+        BREAKPOINT,     // Execute point at `pc`
+        READ,           // `address` read, `value` is what the CPU got
+        WRITE,          // `address` written with `value`
+        PPU_DOT,        // PPU at `scanline`, `dot`
+        UNTIL_PC,
+        UNTIL_VALUE,    // `address` holds `value`
+        UNTIL_FRAME,    // PPU frame counter reached `frame`
+        FRAME_LIMIT     // NES::runUntil ran out of frames
+    };
+
+    struct Stop {
+        Reason reason = Reason::NONE;
+        uint16_t pc = 0;        // Start of the instruction that stopped (or is about to run)
+        uint16_t address = 0;
+        uint8_t value = 0;
+        int16_t scanline = 0;
+        int16_t dot = 0;
+        uint32_t frame = 0;
+    };
+
+    // `kinds` is a mask of Access; points are added to / removed from whatever is already set
+    void add(uint8_t kinds, uint16_t first, uint16_t last);
+    void add(uint8_t kinds, uint16_t address) { add(kinds, address, address); }
+    void remove(uint8_t kinds, uint16_t first, uint16_t last);
+    void remove(uint8_t kinds, uint16_t address) { remove(kinds, address, address); }
+    void addPpuDot(int scanline, int dot);
+    void clear();
+
+    bool has(Access kind, uint16_t address) const {
+        return (pages[address >> 8] & kind) && (maps->bits[kind >> 1][address >> 6] >> (address & 63) & 1);
+    }
+
+    // Heap held by the point maps, for NES::reportFootprint
+    size_t mapBytes() const;
+
+    // Conditions for a single run, dropped once they stop the machine or by clear()
+    void untilPC(uint16_t pc);
+    void untilValue(uint16_t address, uint8_t value);
+    void untilFrame(uint32_t frame);
+
+    // Whether run_frame() has to check anything, and whether the CPU has to report accesses
+    bool armed() const { return points > 0 || ppuPoints > 0 || untilFlags != 0; }
+    bool watchesMemory() const { return memoryPoints > 0; }
+
+    bool stopped() const { return current.reason != Reason::NONE; }
+    const Stop& stop() const { return current; }
+    // Clears the stop; an execute point or PC condition at the current PC lets its instruction run
+    void resume();
+
+    // CPU hook, called for watched addresses only
+    void access(Access kind, uint16_t address, uint8_t value, const Bus& bus);
+    // The checked loop calls these before a CPU cycle that starts the instruction at PC, after
+    // every PPU dot and at the end of every frame. They return true when the machine has to stop.
+    bool instruction(const Bus& bus);
+    bool dot(const Bus& bus);
+    bool frameDone(const Bus& bus);
+
+private:
+    enum Until : uint8_t { UNTIL_PC_FLAG = 1, UNTIL_VALUE_FLAG = 2, UNTIL_FRAME_FLAG = 4 };
+    static constexpr int DOTS = 341;
+    static constexpr int SCANLINES = 262;
+
+    struct Maps {
+        uint64_t bits[3][1024]{};           // EXECUTE, READ, WRITE: one bit per address
+    };
+    std::unique_ptr<Maps> maps;             // Null until the first add()
+    uint8_t pages[256]{};                   // Kinds with at least one point on the page, 0 without maps
+    int points = 0;                         // Bits set, over all three kinds
+    int memoryPoints = 0;                   // Read and write bits set
+    std::vector<uint64_t> ppuDots;          // One bit per scanline (pre-render first) and dot
+    int ppuPoints = 0;
+
+    uint8_t untilFlags = 0;
+    uint16_t untilPc = 0;
+    uint16_t untilAddress = 0;
+    uint8_t untilData = 0;
+    uint32_t untilFrameNumber = 0;
+
+    Stop current;
+    uint16_t instructionPC = 0;
+    bool skipOnce = false;                  // Let the instruction at skipPC run once after resume()
+    uint16_t skipPC = 0;
+
+    void updatePage(uint8_t page);
+    bool halt(Reason reason, const Bus& bus);
+};
+
+#endif // DEBUGGER_H
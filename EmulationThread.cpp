@@ -0,0 +1,351 @@
+#include "EmulationThread.h"
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+
+// NTSC NES: 341 * 262 - 0.5 PPU dots per frame at 5.369318 MHz
+static const double FRAME_RATE = 60.0988;
+
+// Take a rewind snapshot every this many emulated frames (1 = every frame, smoothest rewind)
+static const int REWIND_INTERVAL = 1;
+
+EmulationThread::EmulationThread(NES& nes) : nes(nes), buffers(new Frame[3]) {
+}
+
+EmulationThread::~EmulationThread() {
+    stop();
+}
+
+void EmulationThread::start() {
+    if (!thread.joinable()) {
+        thread = std::thread(&EmulationThread::threadMain, this);
+    }
+}
+
+void EmulationThread::stop() {
+    if (thread.joinable()) {
+        post({CommandType::QUIT, ""});
+        thread.join();
+    }
+}
+
+void EmulationThread::post(const Command& command) {
+    {
+        std::lock_guard<std::mutex> lock(commandMutex);
+        commands.push_back(command);
+    }
+    commandReady.notify_one();
+}
+
+const EmulationThread::Frame& EmulationThread::latestFrame() {
+    // Take the middle buffer only if the producer published into it since our last swap
+    if (middle.load() & 4) {
+        front = middle.exchange(front) & 3;
+    }
+    return buffers[front];
+}
+
+void EmulationThread::threadMain() {
+    using clock = std::chrono::steady_clock;
+    const auto framePeriod = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / FRAME_RATE));
+
+    auto nextFrame = clock::now();
+    auto fpsWindowStart = nextFrame;
+    int fpsFrames = 0;
+    int emulatedFrames = 0;
+    clock::duration busy{};
+
+    while (true) {
+        // Block on the queue while there is nothing to emulate
+        bool idle = paused.load() || !nes.rom_loaded;
+        if (!applyCommands(idle)) {
+            break;
+        }
+        if (paused.load() || !nes.rom_loaded) {
+            nextFrame = clock::now();
+            fps.store(0.0, std::memory_order_relaxed);
+            continue;
+        }
+
+        // Turbo: run uncapped and only compose the frame that is going to be presented
+        auto workStart = clock::now();
+        int presentEvery = turbo.load();
+        int ahead = runAhead.load();
+        if (rewinding.load(std::memory_order_relaxed)) {
+            presentEvery = 0;
+            if (rewindFrame()) {
+                publishFrame();
+                emulatedFrames++;
+            }
+        } else if (presentEvery > 0) {
+            for (int i = 1; i < presentEvery; i++) {
+                emulateFrame(false);
+                recordRewind();
+            }
+            emulateFrame();
+            recordRewind();
+            publishFrame();
+            emulatedFrames += presentEvery;
+        } else {
+            // Run-ahead only makes sense at real time, turbo already hides the latency
+            latchInput();
+            nes.run_ahead(ahead);
+            recordRewind();
+            publishFrame();
+            emulatedFrames += 1 + ahead;
+        }
+        if (nes.debugger.stopped()) {
+            paused.store(true);
+            running.store(false);
+        }
+
+        // Measure the achieved rate and the time spent emulating over half second windows
+        auto now = clock::now();
+        busy += now - workStart;
+        fpsFrames += presentEvery > 0 ? presentEvery : 1;
+        std::chrono::duration<double> window = now - fpsWindowStart;
+        if (window.count() >= 0.5) {
+            fps.store(fpsFrames / window.count(), std::memory_order_relaxed);
+            double busySeconds = std::chrono::duration<double>(busy).count();
+            if (busySeconds > 0.0) {
+                coreSpeed.store(emulatedFrames / busySeconds / FRAME_RATE, std::memory_order_relaxed);
+            }
+            fpsFrames = 0;
+            emulatedFrames = 0;
+            busy = clock::duration::zero();
+            fpsWindowStart = now;
+        }
+
+        // Pace to real time; after a long stall resynchronize instead of running a burst of frames
+        nextFrame += framePeriod;
+        if (presentEvery > 0 || now - nextFrame > 4 * framePeriod) {
+            nextFrame = now;
+        } else {
+            std::this_thread::sleep_until(nextFrame);
+        }
+    }
+    running.store(false);
+}
+
+// Apply every queued command, optionally waiting for one to arrive. Returns false on QUIT.
+bool EmulationThread::applyCommands(bool wait) {
+    std::deque<Command> pending;
+    {
+        std::unique_lock<std::mutex> lock(commandMutex);
+        if (wait) {
+            commandReady.wait(lock, [this] { return !commands.empty(); });
+        }
+        pending.swap(commands);
+    }
+
+    for (const Command& command : pending) {
+        switch (command.type) {
+            case CommandType::LOAD:
+                endMovie();
+                nes.stopProfile("", "");
+                nes.on = false;
+                nes.load_rom(command.path.c_str());
+                nes.initNES();
+                rewind.clear();
+                paused.store(false);
+                break;
+            case CommandType::PAUSE:
+                paused.store(true);
+                nes.rom.flushSaveRAM();
+                break;
+            case CommandType::RESUME:
+                nes.debugger.resume();
+                paused.store(false);
+                break;
+            case CommandType::STEP:
+                nes.debugger.resume();
+                if (nes.rom_loaded) {
+                    emulateFrame();
+                    recordRewind();
+                    publishFrame();
+                }
+                break;
+            case CommandType::RESET:
+                nes.bus.reset();
+                break;
+            case CommandType::AUDIO_QUALITY:
+                nes.apu.setAudioQuality(static_cast<Resampler::Quality>(command.value));
+                break;
+            case CommandType::TURBO:
+                turbo.store(command.value < 0 ? 0 : command.value);
+                break;
+            case CommandType::RUN_AHEAD:
+                runAhead.store(command.value < 0 ? 0 : command.value);
+                break;
+            case CommandType::TRACE:
+                if (command.path.empty()) {
+                    nes.stopTrace();
+                } else {
+                    nes.startTrace(command.path);
+                }
+                break;
+            case CommandType::MOVIE_RECORD:
+            case CommandType::MOVIE_PLAY:
+                beginMovie(command.path, command.type == CommandType::MOVIE_RECORD);
+                break;
+            case CommandType::MOVIE_STOP:
+                endMovie();
+                break;
+            case CommandType::PROFILE:
+                if (command.path.empty()) {
+                    nes.startProfile();
+                } else {
+                    nes.stopProfile(command.path, std::filesystem::path(command.path).replace_extension(".folded").string());
+                }
+                break;
+            case CommandType::BREAKPOINT: {
+                uint16_t address = command.value & 0xFFFF;
+                uint8_t kinds = command.value >> 16;
+                nes.debugger.remove(~kinds & 7, address);
+                nes.debugger.add(kinds, address);
+                break;
+            }
+            case CommandType::PPU_BREAKPOINT:
+                nes.debugger.addPpuDot((command.value >> 16) - 1, command.value & 0xFFFF);
+                break;
+            case CommandType::CLEAR_BREAKPOINTS:
+                nes.debugger.clear();
+                break;
+            case CommandType::RUN_UNTIL_PC:
+                nes.debugger.untilPC(command.value);
+                nes.debugger.resume();
+                paused.store(false);
+                break;
+            case CommandType::RUN_UNTIL_VALUE:
+                nes.debugger.untilValue(command.value & 0xFFFF, command.value >> 16);
+                nes.debugger.resume();
+                paused.store(false);
+                break;
+            case CommandType::RUN_FRAMES:
+                nes.debugger.untilFrame(nes.bus.ppu.total_frames + command.value);
+                nes.debugger.resume();
+                paused.store(false);
+                break;
+            case CommandType::QUIT:
+                endMovie();
+                nes.rom.flushSaveRAM();
+                return false;
+        }
+    }
+    running.store(nes.rom_loaded && !paused.load());
+    return true;
+}
+
+void EmulationThread::latchInput() {
+    nes.bus.controller1.reg = input.load(std::memory_order_relaxed);
+}
+
+void EmulationThread::emulateFrame(bool render) {
+    latchInput();
+    if (render) {
+        nes.run_frame();
+    } else {
+        nes.skip_frame();
+    }
+}
+
+// Recordings start from a snapshot of the current state, stored in the movie, so they replay exactly.
+// Movies without one (nesbatch, FM2) start at power on; here that is approximated with a reset.
+// The rewind history is dropped either way: it reaches back before the movie's first frame.
+void EmulationThread::beginMovie(const std::string& path, bool record) {
+    endMovie();
+    if (!nes.rom_loaded) {
+        return;
+    }
+    if (record) {
+        movie.clear();
+        nes.saveState(movie.startState);
+        movie.startRecording(nes.bus.ppu.total_frames);
+    } else {
+        if (!movie.load(path)) {
+            return;
+        }
+        if (movie.startState.empty()) {
+            nes.bus.reset();
+        } else if (!nes.loadState(movie.startState)) {
+            std::cerr << "Movie was recorded with a different build: " << path << std::endl;
+            return;
+        }
+        movie.startPlayback(nes.bus.ppu.total_frames);
+    }
+    moviePath = path;
+    nes.bus.movie = &movie;
+    rewind.clear();
+    framesSinceSnapshot = 0;
+}
+
+void EmulationThread::endMovie() {
+    if (nes.bus.movie == nullptr) {
+        return;
+    }
+    if (movie.isRecording()) {
+        movie.stop(nes.bus.ppu.total_frames);
+        movie.save(moviePath);
+    }
+    movie.stop(nes.bus.ppu.total_frames);
+    nes.bus.movie = nullptr;
+}
+
+void EmulationThread::recordRewind() {
+    if (++framesSinceSnapshot >= REWIND_INTERVAL) {
+        framesSinceSnapshot = 0;
+        nes.saveState(rewindState);
+        rewind.push(rewindState);
+    }
+}
+
+// Go back one snapshot and run a frame from it to get its picture. That frame is not recorded,
+// the next forward frame continues the history from the restored snapshot.
+bool EmulationThread::rewindFrame() {
+    if (!rewind.pop(rewindState) || !nes.loadState(rewindState)) {
+        return false;
+    }
+    emulateFrame();
+    framesSinceSnapshot = 1;
+    return true;
+}
+
+double EmulationThread::speedMultiplier() const {
+    return emulatedFps() / FRAME_RATE;
+}
+
+int EmulationThread::maxRunAhead() const {
+    int frames = static_cast<int>(headroom()) - 1;
+    return frames < 0 ? 0 : frames;
+}
+
+void EmulationThread::publishFrame() {
+    Frame& frame = buffers[back];
+    nes.bus.ppu.convertFrame(frame.pixels);
+    frame.number = nes.bus.ppu.total_frames;
+    frame.A = nes.cpu.A;
+    frame.X = nes.cpu.X;
+    frame.Y = nes.cpu.Y;
+    frame.S = nes.cpu.S;
+    frame.P = nes.cpu.P;
+    frame.PC = nes.cpu.PC;
+    frame.controller = nes.bus.controller1.reg;
+
+    // Playback hands control back to the keyboard at the end of the movie
+    if (movie.isPlaying() && movie.position(nes.bus.ppu.total_frames) >= movie.length()) {
+        endMovie();
+    }
+    frame.moviePlaying = movie.isPlaying();
+    frame.movieRecording = movie.isRecording();
+    frame.movieFrame = nes.bus.movie ? movie.position(nes.bus.ppu.total_frames) : 0;
+    frame.movieLength = movie.length();
+    frame.rewinding = rewinding.load(std::memory_order_relaxed);
+    frame.rewindSeconds = rewind.size() * REWIND_INTERVAL / FRAME_RATE;
+    frame.rewindBytes = rewind.memoryUsed();
+    frame.rewindRawBytes = rewind.rawSize();
+    frame.counters = nes.frameCounters;
+    frame.stop = nes.debugger.stop();
+
+    // Hand the finished buffer over and continue in whatever the consumer left behind
+    back = middle.exchange(back | 4) & 3;
+}
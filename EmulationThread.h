@@ -0,0 +1,178 @@
+#ifndef EMULATION_THREAD_H
+#define EMULATION_THREAD_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Movie.h"
+#include "NES.h"
+#include "RewindBuffer.h"
+
+// Runs the NES on its own thread, paced to the NTSC frame rate, so the UI frame rate
+// (vsync, slow ImGui frames) and the emulation rate no longer hold each other up.
+//
+// The UI talks to it through three channels only:
+//   - a command queue (load / pause / step / reset ...), applied between frames
+//   - a lock-free controller snapshot, latched into the Bus at the start of each frame,
+//     and a rewind flag that runs the game backwards through the rewind history while held
+//   - a triple buffered frame, published after each emulated frame
+// Once started, the NES object belongs to the emulation thread and must not be touched from outside.
+class EmulationThread {
+public:
+    enum class CommandType {
+        LOAD,           // Load the ROM at `path` and power on
+        PAUSE,
+        RESUME,
+        STEP,           // Run a single frame while paused
+        RESET,
+        AUDIO_QUALITY,  // `value` is a Resampler::Quality
+        TURBO,          // Uncapped speed presenting every `value`-th frame, 0 returns to real time
+        RUN_AHEAD,      // Show the game `value` frames ahead of its real state, 0 disables
+        TRACE,          // Trace the CPU to `path`, an empty path stops
+        MOVIE_RECORD,   // Record input from the current state, saved to `path` when the movie stops
+        MOVIE_PLAY,     // Replay the movie at `path` from its start state
+        MOVIE_STOP,
+        PROFILE,        // Profile the game code; a `path` stops and writes the report there (stacks next to it)
+        BREAKPOINT,     // `value` is Debugger::Access kinds << 16 | address; no kinds removes the address
+        PPU_BREAKPOINT, // `value` is (scanline + 1) << 16 | dot
+        CLEAR_BREAKPOINTS,
+        RUN_UNTIL_PC,   // Run until the CPU is about to execute `value`
+        RUN_UNTIL_VALUE,// `value` is byte << 16 | address: run until the address holds the byte
+        RUN_FRAMES,     // Run `value` frames, then pause
+        QUIT
+    };
+
+    struct Command {
+        CommandType type;
+        std::string path;
+        int value = 0;
+    };
+
+    // Everything the UI displays about one emulated frame
+    struct Frame {
+        uint32_t pixels[256 * 240]{};
+        uint64_t number = 0;
+        uint8_t A = 0, X = 0, Y = 0, S = 0, P = 0;
+        uint16_t PC = 0;
+        uint8_t controller = 0;
+
+        // Input movie
+        bool moviePlaying = false;
+        bool movieRecording = false;
+        size_t movieFrame = 0;
+        size_t movieLength = 0;
+
+        // Rewind history
+        bool rewinding = false;
+        double rewindSeconds = 0.0;
+        size_t rewindBytes = 0;
+        size_t rewindRawBytes = 0;
+
+        // Bus activity of the last emulated frame
+        PerfCounters counters;
+
+        // Why the debugger paused the machine (reason NONE while running)
+        Debugger::Stop stop;
+    };
+
+    explicit EmulationThread(NES& nes);
+    ~EmulationThread();
+
+    void start();
+    void stop();
+
+    // Queue a command for the emulation thread
+    void post(const Command& command);
+    void load(const std::string& path) { post({CommandType::LOAD, path}); }
+    void pause() { post({CommandType::PAUSE, ""}); }
+    void resume() { post({CommandType::RESUME, ""}); }
+    void step() { post({CommandType::STEP, ""}); }
+    void reset() { post({CommandType::RESET, ""}); }
+    void setTurbo(int presentEvery) { post({CommandType::TURBO, "", presentEvery}); }
+    void setRunAhead(int frames) { post({CommandType::RUN_AHEAD, "", frames}); }
+    void startTrace(const std::string& path) { post({CommandType::TRACE, path}); }
+    void stopTrace() { post({CommandType::TRACE, ""}); }
+    void recordMovie(const std::string& path) { post({CommandType::MOVIE_RECORD, path}); }
+    void playMovie(const std::string& path) { post({CommandType::MOVIE_PLAY, path}); }
+    void stopMovie() { post({CommandType::MOVIE_STOP, ""}); }
+    void startProfile() { post({CommandType::PROFILE, ""}); }
+    void stopProfile(const std::string& reportPath) { post({CommandType::PROFILE, reportPath}); }
+    // Breakpoints pause the machine where they hit (see Debugger.h); resume() or step() carries on
+    void setBreakpoint(uint16_t address, uint8_t kinds) { post({CommandType::BREAKPOINT, "", kinds << 16 | address}); }
+    void addPpuBreakpoint(int scanline, int dot) { post({CommandType::PPU_BREAKPOINT, "", (scanline + 1) << 16 | dot}); }
+    void clearBreakpoints() { post({CommandType::CLEAR_BREAKPOINTS, ""}); }
+    void runUntilPC(uint16_t pc) { post({CommandType::RUN_UNTIL_PC, "", pc}); }
+    void runUntilValue(uint16_t address, uint8_t value) { post({CommandType::RUN_UNTIL_VALUE, "", value << 16 | address}); }
+    void runFrames(int frames) { post({CommandType::RUN_FRAMES, "", frames}); }
+
+    // Controller 1 state in Bus::controller bit order (A, B, Select, Start, Up, Down, Left, Right)
+    void setInput(uint8_t controller) { input.store(controller, std::memory_order_relaxed); }
+    // While set, every frame steps one state back through the rewind history instead of forward
+    void setRewind(bool held) { rewinding.store(held, std::memory_order_relaxed); }
+
+    // Most recently published frame. The returned pointer stays valid and unchanged until the next call.
+    const Frame& latestFrame();
+
+    bool isPaused() const { return paused.load(std::memory_order_relaxed); }
+    bool isRunning() const { return running.load(std::memory_order_relaxed); }
+    double emulatedFps() const { return fps.load(std::memory_order_relaxed); }
+    // Emulated frames per second relative to the NTSC frame rate (1.0 = real time)
+    double speedMultiplier() const;
+    bool isTurbo() const { return turbo.load(std::memory_order_relaxed) > 0; }
+    int runAheadFrames() const { return runAhead.load(std::memory_order_relaxed); }
+    // How many times real time the core could run flat out, measured from the time spent emulating
+    double headroom() const { return coreSpeed.load(std::memory_order_relaxed); }
+    // Deepest run-ahead the measured headroom sustains at full speed (each level costs one more frame)
+    int maxRunAhead() const;
+
+private:
+    NES& nes;
+    std::thread thread;
+
+    std::mutex commandMutex;
+    std::condition_variable commandReady;
+    std::deque<Command> commands;
+
+    std::atomic<uint8_t> input{0};
+    std::atomic<bool> paused{true};
+    std::atomic<bool> running{false};
+    std::atomic<double> fps{0.0};
+    std::atomic<int> turbo{0};
+    std::atomic<bool> rewinding{false};
+    std::atomic<int> runAhead{0};
+    std::atomic<double> coreSpeed{0.0};
+
+    // Attached to the Bus while playing or recording
+    Movie movie;
+    std::string moviePath;
+
+    RewindBuffer rewind;
+    std::vector<uint8_t> rewindState;
+    int framesSinceSnapshot = 0;
+
+    // Triple buffer: the producer owns `back`, the consumer owns `front`, `middle` is handed over.
+    // `middle` carries a fresh flag in bit 2 so the consumer only swaps when something new was published.
+    std::unique_ptr<Frame[]> buffers;
+    int back = 0;
+    int front = 1;
+    std::atomic<int> middle{2};
+
+    void threadMain();
+    bool applyCommands(bool wait);
+    void latchInput();
+    void emulateFrame(bool render = true);
+    void recordRewind();
+    bool rewindFrame();
+    void publishFrame();
+    void beginMovie(const std::string& path, bool record);
+    void endMovie();
+};
+
+#endif // EMULATION_THREAD_H
@@ -0,0 +1,244 @@
+#include "GuestProfiler.h"
+#include "CPU.h"
+#include "ROM.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <map>
+
+static const char* const CONTEXT_NAMES[GuestProfiler::CONTEXTS] = {"main", "nmi", "irq"};
+
+bool GuestProfiler::compiledIn() {
+#ifdef NES_PROFILE
+    return true;
+#else
+    return false;
+#endif
+}
+
+void GuestProfiler::reset(const NESROM* cartridge) {
+    rom = cartridge != nullptr && cartridge->prgRom != nullptr ? cartridge : nullptr;
+    sites.assign(0x8000 + (rom != nullptr ? rom->info.prgRomBytes : 0x8000), Site());
+    std::fill(std::begin(opcodes), std::end(opcodes), Site());
+    std::fill(std::begin(contextCycles), std::end(contextCycles), 0);
+    instructionCount = 0;
+
+    nodes.clear();
+    children.clear();
+    for (int context = 0; context < CONTEXTS; context++) {
+        nodes.push_back({0, 0, -1});
+    }
+    stack.assign(1, {MAIN, 0xFF, false, MAIN});
+
+    idle = 0;
+    loopCycles = 0;
+    inLoop = false;
+}
+
+int GuestProfiler::bankAt(uint16_t pc) const {
+    if (pc < 0x8000 || rom == nullptr) {
+        return -1;
+    }
+    return static_cast<int>((siteIndex(pc) - 0x8000) / 0x2000);
+}
+
+// ROM sites are keyed by file offset, so a routine keeps one entry whichever window its bank is in
+size_t GuestProfiler::siteIndex(uint16_t pc) const {
+    if (pc < 0x8000 || rom == nullptr) {
+        return pc;
+    }
+    const uint8_t* window = rom->prgBanks[(pc >> 13) & 0x03];
+    size_t offset = static_cast<size_t>(window - rom->prgRom) + (pc & 0x1FFF);
+    return window >= rom->prgRom && offset < rom->info.prgRomBytes ? 0x8000 + offset : pc & 0x7FFF;
+}
+
+uint32_t GuestProfiler::child(uint32_t parent, uint16_t address) {
+    int bank = bankAt(address);
+    uint64_t key = static_cast<uint64_t>(parent) << 32 | static_cast<uint64_t>(bank + 1) << 16 | address;
+    auto found = children.find(key);
+    if (found != children.end()) {
+        return found->second;
+    }
+    uint32_t node = static_cast<uint32_t>(nodes.size());
+    nodes.push_back({parent, address, static_cast<int16_t>(bank)});
+    children.emplace(key, node);
+    return node;
+}
+
+void GuestProfiler::instruction(uint16_t pc, uint8_t opcode, uint32_t cycles, const CPU& cpu) {
+    instructionCount++;
+    Site& site = sites[siteIndex(pc)];
+    site.executions++;
+    site.cycles += cycles;
+    site.pc = pc;
+    site.opcode = opcode;
+    opcodes[opcode].executions++;
+    opcodes[opcode].cycles += cycles;
+
+    // The instruction's own cycles belong to the routine it is in, before any call or return
+    Frame current = stack.back();
+    contextCycles[current.context] += cycles;
+    nodes[current.node].cycles += cycles;
+
+    switch (opcode) {
+    case 0x20:  // JSR: S now points below the return address
+        stack.push_back({child(current.node, cpu.PC), cpu.S, false, current.context});
+        break;
+    case 0x60: {  // RTS: returns from every call made at or below the stack pointer it started with
+        uint8_t s = static_cast<uint8_t>(cpu.S - 2);
+        while (stack.size() > 1 && !stack.back().interrupt && stack.back().s <= s) {
+            stack.pop_back();
+        }
+        break;
+    }
+    case 0x40:  // RTI: leaves the innermost handler, including calls it never returned from
+        for (size_t i = stack.size(); i-- > 1;) {
+            if (stack[i].interrupt) {
+                stack.resize(i);
+                break;
+            }
+        }
+        break;
+    case 0x00:  // BRK: enters the IRQ handler
+        stack.push_back({child(IRQ, cpu.PC), cpu.S, true, IRQ});
+        break;
+    }
+
+    // A short backward jump that finds the registers as it left them last time went round a loop
+    // that only waits
+    if (current.context == MAIN) {
+        loopCycles += cycles;
+        bool jumpBack = (opcode == 0x4C || (opcode & 0x1F) == 0x10) && cpu.PC <= pc && pc - cpu.PC <= 16;
+        if (jumpBack) {
+            uint8_t registers[4] = {cpu.A, cpu.X, cpu.Y, cpu.P};
+            if (inLoop && cpu.PC == loopTarget && std::memcmp(registers, loopRegisters, sizeof(registers)) == 0) {
+                idle += loopCycles;
+            }
+            inLoop = true;
+            loopTarget = cpu.PC;
+            std::memcpy(loopRegisters, registers, sizeof(registers));
+            loopCycles = 0;
+        }
+    }
+}
+
+void GuestProfiler::interrupt(Context context, uint32_t cycles, const CPU& cpu) {
+    Frame handler{child(context, cpu.PC), cpu.S, true, context};
+    contextCycles[context] += cycles;
+    nodes[handler.node].cycles += cycles;
+    stack.push_back(handler);
+}
+
+std::string GuestProfiler::nodeName(uint32_t node) const {
+    if (node < CONTEXTS) {
+        return CONTEXT_NAMES[node];
+    }
+    char name[16];
+    if (nodes[node].bank >= 0) {
+        std::snprintf(name, sizeof(name), "%02X:%04X", nodes[node].bank, nodes[node].address);
+    } else {
+        std::snprintf(name, sizeof(name), "%04X", nodes[node].address);
+    }
+    return name;
+}
+
+void GuestProfiler::writeCollapsed(std::ostream& out) const {
+    std::vector<std::string> path;
+    for (uint32_t node = 0; node < nodes.size(); node++) {
+        if (nodes[node].cycles == 0) {
+            continue;
+        }
+        path.clear();
+        for (uint32_t at = node; at >= CONTEXTS; at = nodes[at].parent) {
+            path.push_back(nodeName(at));
+        }
+        uint32_t root = node;
+        while (root >= CONTEXTS) {
+            root = nodes[root].parent;
+        }
+        out << CONTEXT_NAMES[root];
+        for (auto name = path.rbegin(); name != path.rend(); ++name) {
+            out << ';' << *name;
+        }
+        out << ' ' << nodes[node].cycles << '\n';
+    }
+}
+
+void GuestProfiler::writeReport(std::ostream& out, size_t top) const {
+    uint64_t total = cycles();
+    auto percent = [total](uint64_t part) { return total ? 100.0 * part / total : 0.0; };
+    char line[160];
+
+    std::snprintf(line, sizeof(line), "Guest profile: %llu instructions, %llu cycles\n\n",
+                  static_cast<unsigned long long>(instructionCount), static_cast<unsigned long long>(total));
+    out << line;
+    for (int context = 0; context < CONTEXTS; context++) {
+        std::snprintf(line, sizeof(line), "  %-6s %12llu cycles  %5.1f%%\n", CONTEXT_NAMES[context],
+                      static_cast<unsigned long long>(contextCycles[context]), percent(contextCycles[context]));
+        out << line;
+    }
+    std::snprintf(line, sizeof(line), "  idle   %12llu cycles  %5.1f%%  (%.1f%% of the main loop)\n",
+                  static_cast<unsigned long long>(idle), percent(idle),
+                  contextCycles[MAIN] ? 100.0 * idle / contextCycles[MAIN] : 0.0);
+    out << line;
+
+    // Hottest instruction addresses
+    std::vector<size_t> hot;
+    for (size_t i = 0; i < sites.size(); i++) {
+        if (sites[i].executions > 0) {
+            hot.push_back(i);
+        }
+    }
+    size_t rows = std::min(top, hot.size());
+    std::partial_sort(hot.begin(), hot.begin() + rows, hot.end(),
+                      [this](size_t a, size_t b) { return sites[a].cycles > sites[b].cycles; });
+    out << "\nInstructions by cycles (bank:address, PRG banks are 8 KB):\n";
+    for (size_t i = 0; i < rows; i++) {
+        const Site& site = sites[hot[i]];
+        char where[16];
+        if (hot[i] >= 0x8000) {
+            std::snprintf(where, sizeof(where), "%02X:%04X", static_cast<int>((hot[i] - 0x8000) / 0x2000), site.pc);
+        } else {
+            std::snprintf(where, sizeof(where), "   %04X", site.pc);
+        }
+        std::snprintf(line, sizeof(line), "  %s  %s  %12llu x  %12llu cycles  %5.1f%%\n", where,
+                      opcodeMnemonic(site.opcode), static_cast<unsigned long long>(site.executions),
+                      static_cast<unsigned long long>(site.cycles), percent(site.cycles));
+        out << line;
+    }
+
+    // Routines by self cycles, every call path into them merged
+    std::map<std::string, uint64_t> routines;
+    for (uint32_t node = CONTEXTS; node < nodes.size(); node++) {
+        routines[nodeName(node)] += nodes[node].cycles;
+    }
+    for (int context = 0; context < CONTEXTS; context++) {
+        routines[std::string("(") + CONTEXT_NAMES[context] + " top level)"] += nodes[context].cycles;
+    }
+    std::vector<std::pair<std::string, uint64_t>> sorted(routines.begin(), routines.end());
+    rows = std::min(top, sorted.size());
+    std::partial_sort(sorted.begin(), sorted.begin() + rows, sorted.end(),
+                      [](const auto& a, const auto& b) { return a.second > b.second; });
+    out << "\nRoutines by self cycles (JSR targets and interrupt handlers):\n";
+    for (size_t i = 0; i < rows && sorted[i].second > 0; i++) {
+        std::snprintf(line, sizeof(line), "  %-20s %12llu cycles  %5.1f%%\n", sorted[i].first.c_str(),
+                      static_cast<unsigned long long>(sorted[i].second), percent(sorted[i].second));
+        out << line;
+    }
+
+    std::vector<int> byOpcode;
+    for (int op = 0; op < 256; op++) {
+        if (opcodes[op].executions > 0) {
+            byOpcode.push_back(op);
+        }
+    }
+    std::sort(byOpcode.begin(), byOpcode.end(), [this](int a, int b) { return opcodes[a].cycles > opcodes[b].cycles; });
+    out << "\nOpcodes by cycles:\n";
+    for (int op : byOpcode) {
+        std::snprintf(line, sizeof(line), "  %02X %s  %12llu x  %12llu cycles  %5.1f%%\n", op, opcodeMnemonic(static_cast<uint8_t>(op)),
+                      static_cast<unsigned long long>(opcodes[op].executions),
+                      static_cast<unsigned long long>(opcodes[op].cycles), percent(opcodes[op].cycles));
+        out << line;
+    }
+}
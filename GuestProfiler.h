@@ -0,0 +1,101 @@
+#ifndef GUEST_PROFILER_H
+#define GUEST_PROFILER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class CPU;
+class NESROM;
+
+// Profiler for the game's code, as opposed to the emulator's.
+//
+// Built with NES_PROFILE (make PROFILE=1), the CPU reports every instruction it completes and every
+// interrupt it takes to the GuestProfiler attached to it. Without the flag the hooks are not
+// compiled in and cost nothing. The profile answers which parts of a game drive emulator load:
+//   - executions and cycles per instruction address, with the PRG bank it was fetched from
+//   - executions and cycles per opcode
+//   - cycles spent in the main loop, the NMI handler and the IRQ handler (BRK counts as IRQ)
+//   - idle cycles: main loop iterations of a short backward loop that leave the registers
+//     unchanged, i.e. the game polling for vblank or for a flag its NMI handler sets
+//   - a call tree built from JSR / RTS / RTI, written as collapsed stacks for flame graphs
+//
+// Call tracking follows the stack pointer rather than pairing JSR with RTS, so the RTS jump-table
+// trick (push an address, RTS to it) and games that reset S do not leave stale frames behind.
+class GuestProfiler {
+public:
+    enum Context : uint8_t { MAIN, NMI, IRQ, CONTEXTS };
+
+    struct Site {
+        uint64_t executions = 0;
+        uint64_t cycles = 0;
+        uint16_t pc = 0;        // CPU address it last ran at
+        uint8_t opcode = 0;
+    };
+
+    // Clears the profile and sizes the per-address table for the cartridge's PRG ROM (may be null)
+    void reset(const NESROM* rom);
+
+    // CPU hooks. `cpu` already holds the state after the instruction / interrupt entry.
+    void instruction(uint16_t pc, uint8_t opcode, uint32_t cycles, const CPU& cpu);
+    void interrupt(Context context, uint32_t cycles, const CPU& cpu);
+
+    uint64_t instructions() const { return instructionCount; }
+    uint64_t cycles() const { return contextCycles[MAIN] + contextCycles[NMI] + contextCycles[IRQ]; }
+    uint64_t cycles(Context context) const { return contextCycles[context]; }
+    uint64_t idleCycles() const { return idle; }
+    const Site& opcode(uint8_t opcode) const { return opcodes[opcode]; }
+    // PRG bank (8 KB, -1 outside PRG ROM) and profile of the instruction at `pc` as currently mapped
+    int bankAt(uint16_t pc) const;
+    const Site& site(uint16_t pc) const { return sites[siteIndex(pc)]; }
+
+    // Sorted text report: contexts, hottest addresses, functions and opcodes (`top` rows each)
+    void writeReport(std::ostream& out, size_t top = 40) const;
+    // One line per call stack, "nmi;03:C85F;03:C9A0 1234" with self cycles, the input format of
+    // flamegraph.pl, speedscope and inferno
+    void writeCollapsed(std::ostream& out) const;
+
+    // Whether the CPU hooks were compiled in (NES_PROFILE)
+    static bool compiledIn();
+
+private:
+    struct Node {
+        uint32_t parent;
+        uint16_t address;
+        int16_t bank;
+        uint64_t cycles = 0;        // Self cycles
+    };
+    struct Frame {
+        uint32_t node;
+        uint8_t s;                  // Stack pointer inside the call, frames at or below it return with RTS
+        bool interrupt;
+        Context context;
+    };
+
+    const NESROM* rom = nullptr;
+    std::vector<Site> sites;        // $0000-$7FFF by address, then PRG ROM by file offset
+    Site opcodes[256];
+    uint64_t contextCycles[CONTEXTS]{};
+    uint64_t instructionCount = 0;
+
+    // Call tree; nodes 0-2 are the roots of the three contexts
+    std::vector<Node> nodes;
+    std::unordered_map<uint64_t, uint32_t> children;
+    std::vector<Frame> stack;
+
+    // Idle loop detection (main context only)
+    uint64_t idle = 0;
+    uint64_t loopCycles = 0;
+    uint16_t loopTarget = 0;
+    uint8_t loopRegisters[4]{};     // A, X, Y, P at the last jump back to loopTarget
+    bool inLoop = false;
+
+    size_t siteIndex(uint16_t pc) const;
+    uint32_t child(uint32_t parent, uint16_t address);
+    std::string nodeName(uint32_t node) const;
+};
+
+#endif // GUEST_PROFILER_H
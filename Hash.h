@@ -0,0 +1,19 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Hashes for frames, states and files
+
+// xxHash64 (XXH64), matches the reference implementation for the same seed
+uint64_t xxhash64(const void* data, size_t size, uint64_t seed = 0);
+
+// CRC-32 (IEEE 802.3, as used by zip / PNG / No-Intro). Pass the previous result to continue a running CRC.
+uint32_t crc32(const void* data, size_t size, uint32_t crc = 0);
+
+// SHA-1 (FIPS 180-1) as 40 lowercase hex digits, the form ROM databases list it in
+std::string sha1Hex(const void* data, size_t size);
+
+#endif // HASH_H
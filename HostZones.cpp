@@ -0,0 +1,160 @@
+#include "HostZones.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HOST_ZONES_RDTSC
+#endif
+
+thread_local HostZones::Sample HostZones::current;
+
+static const char* const ZONE_NAMES[HostZones::ZONES] = {"CPU", "PPU", "APU", "Upload", "Render", "Present"};
+static const char* const COUNTER_NAMES[HostZones::COUNTERS] = {"cpuCycles", "dmaCycles", "uploadBytes"};
+static const char* const TRACK_NAMES[HostZones::TRACKS] = {"Emulation", "UI"};
+
+namespace {
+    // Written once per frame by whichever thread ran it (nesbatch runs several machines at once),
+    // so a plain lock is cheap enough
+    struct Ring {
+        std::mutex lock;
+        HostZones::Sample samples[HostZones::HISTORY];
+        size_t written = 0;
+    };
+    Ring rings[HostZones::TRACKS];
+}
+
+bool HostZones::compiledIn() {
+#ifdef NES_ZONES
+    return true;
+#else
+    return false;
+#endif
+}
+
+uint64_t HostZones::now() {
+#ifdef HOST_ZONES_RDTSC
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+double HostZones::ticksPerSecond() {
+#ifdef HOST_ZONES_RDTSC
+    // Invariant TSC on anything recent, so one measurement holds for the whole run
+    static const double rate = [] {
+        auto wallStart = std::chrono::steady_clock::now();
+        uint64_t tickStart = __rdtsc();
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        uint64_t ticks = __rdtsc() - tickStart;
+        std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - wallStart;
+        return ticks / seconds.count();
+    }();
+    return rate;
+#else
+    return 1e9;
+#endif
+}
+
+void HostZones::beginFrame() {
+    current = Sample();
+    current.start = now();
+}
+
+void HostZones::endFrame(Track track) {
+    current.duration = now() - current.start;
+    Ring& ring = rings[track];
+    std::lock_guard<std::mutex> guard(ring.lock);
+    ring.samples[ring.written % HISTORY] = current;
+    ring.written++;
+}
+
+std::vector<HostZones::Sample> HostZones::history(Track track, size_t max) {
+    Ring& ring = rings[track];
+    std::lock_guard<std::mutex> guard(ring.lock);
+    size_t count = std::min({max, HISTORY, ring.written});
+    std::vector<Sample> samples;
+    samples.reserve(count);
+    for (size_t i = ring.written - count; i < ring.written; i++) {
+        samples.push_back(ring.samples[i % HISTORY]);
+    }
+    return samples;
+}
+
+void HostZones::clear() {
+    for (Ring& ring : rings) {
+        std::lock_guard<std::mutex> guard(ring.lock);
+        ring.written = 0;
+    }
+}
+
+const char* HostZones::zoneName(Zone zone) {
+    return ZONE_NAMES[zone];
+}
+
+const char* HostZones::counterName(Counter counter) {
+    return COUNTER_NAMES[counter];
+}
+
+const char* HostZones::trackName(Track track) {
+    return TRACK_NAMES[track];
+}
+
+// One "X" (complete) event per frame and per zone that ran in it, microseconds from the oldest
+// frame in either ring. Tracks become threads of a single process.
+void HostZones::writeChromeTrace(std::ostream& out) {
+    std::vector<Sample> tracks[TRACKS];
+    uint64_t origin = UINT64_MAX;
+    for (int track = 0; track < TRACKS; track++) {
+        tracks[track] = history(static_cast<Track>(track));
+        if (!tracks[track].empty()) {
+            origin = std::min(origin, tracks[track].front().start);
+        }
+    }
+    double usPerTick = 1e6 / ticksPerSecond();
+    char line[256];
+    bool first = true;
+    auto event = [&](const char* text) {
+        out << (first ? "[\n" : ",\n") << text;
+        first = false;
+    };
+
+    for (int track = 0; track < TRACKS; track++) {
+        std::snprintf(line, sizeof(line), R"({"name":"thread_name","ph":"M","pid":1,"tid":%d,"args":{"name":"%s"}})",
+                      track + 1, TRACK_NAMES[track]);
+        event(line);
+    }
+    for (int track = 0; track < TRACKS; track++) {
+        for (const Sample& sample : tracks[track]) {
+            double start = (sample.start - origin) * usPerTick;
+            int length = std::snprintf(line, sizeof(line), R"({"name":"%s frame","ph":"X","pid":1,"tid":%d,"ts":%.3f,"dur":%.3f,"args":{)",
+                                       TRACK_NAMES[track], track + 1, start, sample.duration * usPerTick);
+            const char* separator = "";
+            for (int counter = 0; counter < COUNTERS; counter++) {
+                if (sample.counts[counter] != 0) {
+                    length += std::snprintf(line + length, sizeof(line) - length, R"(%s"%s":%llu)", separator,
+                                            COUNTER_NAMES[counter], static_cast<unsigned long long>(sample.counts[counter]));
+                    separator = ",";
+                }
+            }
+            std::snprintf(line + length, sizeof(line) - length, "}}");
+            event(line);
+
+            double at = start;
+            for (int zone = 0; zone < ZONES; zone++) {
+                if (sample.ticks[zone] == 0) {
+                    continue;
+                }
+                double duration = sample.ticks[zone] * usPerTick;
+                std::snprintf(line, sizeof(line), R"({"name":"%s","ph":"X","pid":1,"tid":%d,"ts":%.3f,"dur":%.3f,"args":{"aggregated":true}})",
+                              ZONE_NAMES[zone], track + 1, at, duration);
+                event(line);
+                at += duration;
+            }
+        }
+    }
+    out << "\n]\n";
+}
@@ -0,0 +1,100 @@
+#ifndef HOST_ZONES_H
+#define HOST_ZONES_H
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+// Where the emulator's own time goes, as opposed to the game's (GuestProfiler).
+//
+// Built with NES_ZONES (make ZONES=1), the core and the UI loop time themselves with scoped zones
+// read from the CPU time stamp counter (RDTSC, steady_clock on hosts without one). Zones add their
+// ticks to per-thread totals; a frame scope around each emulated frame and each UI frame publishes
+// the totals, with a few event counters, into a 256 frame ring per track. The Debug window draws
+// the rings as a stacked frame-time graph and can export them as Chrome trace-event JSON
+// (chrome://tracing, Perfetto). Without the flag NES_ZONE / NES_FRAME_ZONE / NES_COUNT expand to
+// nothing and cost nothing.
+//
+// The CPU, PPU and APU zones are entered millions of times a second, so the trace holds one event
+// per zone per frame rather than one per call: a frame's zones are laid back to back from its start,
+// each as long as its total. Timing every PPU dot costs time itself, mostly outside the zones, so
+// compare zones with each other rather than with a build without NES_ZONES.
+class HostZones {
+public:
+    enum Zone : uint8_t { CPU, PPU, APU, UI_UPLOAD, UI_RENDER, UI_PRESENT, ZONES };
+    enum Counter : uint8_t { CPU_CYCLES, DMA_CYCLES, UPLOAD_BYTES, COUNTERS };
+    enum Track : uint8_t { EMULATION, UI, TRACKS };
+    static constexpr size_t HISTORY = 256;
+
+    struct Sample {
+        uint64_t start = 0;             // Tick the frame began at
+        uint64_t duration = 0;          // Ticks from begin to end of the frame
+        uint64_t ticks[ZONES]{};        // Time inside each zone during the frame
+        uint64_t counts[COUNTERS]{};
+    };
+
+    static uint64_t now();
+    // Tick rate, measured against steady_clock the first time it is asked for (takes ~20 ms)
+    static double ticksPerSecond();
+
+    static void add(Zone zone, uint64_t ticks) { current.ticks[zone] += ticks; }
+    static void count(Counter counter, uint64_t n) { current.counts[counter] += n; }
+
+    // Starts a frame on the calling thread, dropping anything counted outside a frame
+    static void beginFrame();
+    // Publishes the calling thread's frame to `track`
+    static void endFrame(Track track);
+
+    // Up to `max` most recent frames of `track`, oldest first
+    static std::vector<Sample> history(Track track, size_t max = HISTORY);
+    static void clear();
+
+    // Both tracks as a Chrome trace-event JSON array
+    static void writeChromeTrace(std::ostream& out);
+
+    static const char* zoneName(Zone zone);
+    static const char* counterName(Counter counter);
+    static const char* trackName(Track track);
+
+    // Whether the zones were compiled in (NES_ZONES)
+    static bool compiledIn();
+
+    class Scope {
+    public:
+        explicit Scope(Zone zone) : zone(zone), start(now()) {}
+        ~Scope() { add(zone, now() - start); }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    private:
+        Zone zone;
+        uint64_t start;
+    };
+
+    class FrameScope {
+    public:
+        explicit FrameScope(Track track) : track(track) { beginFrame(); }
+        ~FrameScope() { endFrame(track); }
+        FrameScope(const FrameScope&) = delete;
+        FrameScope& operator=(const FrameScope&) = delete;
+    private:
+        Track track;
+    };
+
+private:
+    static thread_local Sample current;
+};
+
+#ifdef NES_ZONES
+#define NES_ZONE_NAME2(line) hostZone##line
+#define NES_ZONE_NAME(line) NES_ZONE_NAME2(line)
+#define NES_ZONE(zone) HostZones::Scope NES_ZONE_NAME(__LINE__)(HostZones::zone)
+#define NES_FRAME_ZONE(track) HostZones::FrameScope NES_ZONE_NAME(__LINE__)(HostZones::track)
+#define NES_COUNT(counter, n) HostZones::count(HostZones::counter, (n))
+#else
+#define NES_ZONE(zone) static_cast<void>(0)
+#define NES_FRAME_ZONE(track) static_cast<void>(0)
+#define NES_COUNT(counter, n) static_cast<void>(0)
+#endif
+
+#endif // HOST_ZONES_H
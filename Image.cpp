@@ -0,0 +1,84 @@
+#include "Image.h"
+#include "Hash.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+static void putBigEndian32(std::vector<uint8_t>& out, uint32_t value) {
+    out.push_back(static_cast<uint8_t>(value >> 24));
+    out.push_back(static_cast<uint8_t>(value >> 16));
+    out.push_back(static_cast<uint8_t>(value >> 8));
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+// Chunk layout: length | type | data | CRC-32 of type and data
+static void putChunk(std::vector<uint8_t>& out, const char type[4], const std::vector<uint8_t>& data) {
+    putBigEndian32(out, static_cast<uint32_t>(data.size()));
+    size_t typeAt = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data.begin(), data.end());
+    putBigEndian32(out, crc32(out.data() + typeAt, data.size() + 4));
+}
+
+static uint32_t adler32(const std::vector<uint8_t>& data) {
+    uint32_t a = 1, b = 0;
+    for (size_t i = 0; i < data.size(); i++) {
+        a = (a + data[i]) % 65521;
+        b = (b + a) % 65521;
+    }
+    return (b << 16) | a;
+}
+
+bool writePNG(const std::string& path, const uint32_t* pixels, int width, int height) {
+    // Filter type 0 (none) in front of every row
+    std::vector<uint8_t> raw;
+    raw.reserve(static_cast<size_t>(height) * (1 + width * 3));
+    for (int y = 0; y < height; y++) {
+        raw.push_back(0);
+        for (int x = 0; x < width; x++) {
+            uint32_t pixel = pixels[y * width + x];
+            raw.push_back(static_cast<uint8_t>(pixel));
+            raw.push_back(static_cast<uint8_t>(pixel >> 8));
+            raw.push_back(static_cast<uint8_t>(pixel >> 16));
+        }
+    }
+
+    // zlib stream made of stored deflate blocks of at most 65535 bytes
+    std::vector<uint8_t> zlib = {0x78, 0x01};
+    size_t offset = 0;
+    do {
+        size_t length = std::min<size_t>(raw.size() - offset, 65535);
+        bool last = offset + length == raw.size();
+        zlib.push_back(last ? 1 : 0);
+        zlib.push_back(static_cast<uint8_t>(length));
+        zlib.push_back(static_cast<uint8_t>(length >> 8));
+        zlib.push_back(static_cast<uint8_t>(~length));
+        zlib.push_back(static_cast<uint8_t>(~length >> 8));
+        zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + length);
+        offset += length;
+    } while (offset < raw.size());
+    putBigEndian32(zlib, adler32(raw));
+
+    std::vector<uint8_t> header;
+    putBigEndian32(header, static_cast<uint32_t>(width));
+    putBigEndian32(header, static_cast<uint32_t>(height));
+    header.push_back(8);    // bit depth
+    header.push_back(2);    // color type: RGB
+    header.push_back(0);    // compression
+    header.push_back(0);    // filter
+    header.push_back(0);    // interlace
+
+    std::vector<uint8_t> png = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    putChunk(png, "IHDR", header);
+    putChunk(png, "IDAT", zlib);
+    putChunk(png, "IEND", {});
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Failed to write image: " << path << std::endl;
+        return false;
+    }
+    file.write(reinterpret_cast<const char*>(png.data()), static_cast<std::streamsize>(png.size()));
+    return file.good();
+}
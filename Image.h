@@ -0,0 +1,12 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include <cstdint>
+#include <string>
+
+// Write a frame as an 8-bit RGB PNG. `pixels` are in framebuffer layout: one uint32_t per pixel
+// with red in the low byte (0xAABBGGRR), rows top to bottom. The image data is stored uncompressed
+// (deflate "stored" blocks), which every decoder reads and needs no zlib.
+bool writePNG(const std::string& path, const uint32_t* pixels, int width, int height);
+
+#endif // IMAGE_H
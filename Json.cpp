@@ -0,0 +1,308 @@
+#include "Json.h"
+#include <charconv>
+#include <cstring>
+
+// ---------------------------------------------------------------------------- //
+// ----------------------------------- VALUES --------------------------------- //
+// ---------------------------------------------------------------------------- //
+
+JsonValue::Type JsonValue::type() const {
+    return document ? document->nodes[node].type : Type::INVALID;
+}
+
+double JsonValue::number(double fallback) const {
+    return type() == Type::NUMBER ? document->nodes[node].number : fallback;
+}
+
+bool JsonValue::boolean(bool fallback) const {
+    return type() == Type::BOOL ? document->nodes[node].number != 0.0 : fallback;
+}
+
+std::string_view JsonValue::string() const {
+    return type() == Type::STRING ? document->nodes[node].text : std::string_view();
+}
+
+std::string_view JsonValue::key() const {
+    return document ? document->nodes[node].key : std::string_view();
+}
+
+size_t JsonValue::size() const {
+    return isArray() || isObject() ? document->nodes[node].count : 0;
+}
+
+JsonValue JsonValue::operator[](std::string_view name) const {
+    if (!isObject()) {
+        return JsonValue();
+    }
+    for (JsonValue member : *this) {
+        if (member.key() == name) {
+            return member;
+        }
+    }
+    return JsonValue();
+}
+
+JsonValue JsonValue::at(size_t index) const {
+    for (JsonValue element : *this) {
+        if (index-- == 0) {
+            return element;
+        }
+    }
+    return JsonValue();
+}
+
+JsonValue::Iterator JsonValue::begin() const {
+    return Iterator(document, isArray() || isObject() ? document->nodes[node].firstChild : NONE);
+}
+
+JsonValue::Iterator& JsonValue::Iterator::operator++() {
+    node = document->nodes[node].nextSibling;
+    return *this;
+}
+
+// ---------------------------------------------------------------------------- //
+// ---------------------------------- PARSING --------------------------------- //
+// ---------------------------------------------------------------------------- //
+
+bool JsonDocument::parse(std::string_view text) {
+    nodes.clear();
+    unescaped.clear();
+    message.clear();
+    begin = text.data();
+    cursor = text.data();
+    end = text.data() + text.size();
+
+    nodes.emplace_back();
+    if (!parseValue(0, 0)) {
+        nodes.clear();
+        return false;
+    }
+    skipSpace();
+    if (cursor != end) {
+        nodes.clear();
+        return fail("trailing characters");
+    }
+    return true;
+}
+
+bool JsonDocument::fail(const char* what) {
+    message = std::string(what) + " at offset " + std::to_string(cursor - begin);
+    return false;
+}
+
+void JsonDocument::skipSpace() {
+    while (cursor != end && (*cursor == ' ' || *cursor == '\n' || *cursor == '\r' || *cursor == '\t')) {
+        cursor++;
+    }
+}
+
+// `index` is re-read after every nested parse: the node array may have moved
+bool JsonDocument::parseValue(uint32_t index, int depth) {
+    if (depth > 256) {
+        return fail("nesting too deep");
+    }
+    skipSpace();
+    if (cursor == end) {
+        return fail("unexpected end");
+    }
+
+    char c = *cursor;
+    if (c == '{' || c == '[') {
+        bool object = c == '{';
+        char close = object ? '}' : ']';
+        nodes[index].type = object ? JsonValue::Type::OBJECT : JsonValue::Type::ARRAY;
+        cursor++;
+        skipSpace();
+        if (cursor != end && *cursor == close) {
+            cursor++;
+            return true;
+        }
+        uint32_t last = JsonValue::NONE;
+        for (;;) {
+            std::string_view key;
+            if (object) {
+                skipSpace();
+                if (cursor == end || *cursor != '"') {
+                    return fail("expected member name");
+                }
+                if (!parseString(key)) {
+                    return false;
+                }
+                skipSpace();
+                if (cursor == end || *cursor != ':') {
+                    return fail("expected ':'");
+                }
+                cursor++;
+            }
+            uint32_t child = static_cast<uint32_t>(nodes.size());
+            nodes.emplace_back();
+            nodes[child].key = key;
+            if (!parseValue(child, depth + 1)) {
+                return false;
+            }
+            if (last == JsonValue::NONE) {
+                nodes[index].firstChild = child;
+            } else {
+                nodes[last].nextSibling = child;
+            }
+            last = child;
+            nodes[index].count++;
+
+            skipSpace();
+            if (cursor != end && *cursor == ',') {
+                cursor++;
+                continue;
+            }
+            if (cursor != end && *cursor == close) {
+                cursor++;
+                return true;
+            }
+            return fail(object ? "expected ',' or '}'" : "expected ',' or ']'");
+        }
+    }
+    if (c == '"') {
+        nodes[index].type = JsonValue::Type::STRING;
+        return parseString(nodes[index].text);
+    }
+    if (c == 't' || c == 'f') {
+        nodes[index].type = JsonValue::Type::BOOL;
+        nodes[index].number = c == 't' ? 1.0 : 0.0;
+        return parseLiteral(c == 't' ? "true" : "false");
+    }
+    if (c == 'n') {
+        nodes[index].type = JsonValue::Type::NUL;
+        return parseLiteral("null");
+    }
+    nodes[index].type = JsonValue::Type::NUMBER;
+    return parseNumber(nodes[index].number);
+}
+
+bool JsonDocument::parseLiteral(const char* literal) {
+    size_t length = std::strlen(literal);
+    if (static_cast<size_t>(end - cursor) < length || std::memcmp(cursor, literal, length) != 0) {
+        return fail("invalid literal");
+    }
+    cursor += length;
+    return true;
+}
+
+bool JsonDocument::parseNumber(double& out) {
+    // from_chars takes neither a leading '+' nor JSON's restrictions, so check the shape first
+    const char* start = cursor;
+    const char* p = cursor;
+    if (p != end && *p == '-') p++;
+    if (p == end || *p < '0' || *p > '9') {
+        return fail("invalid value");
+    }
+
+    // Plain integers, which is nearly every number in test vectors, skip the float parser
+    int64_t whole = 0;
+    while (p != end && *p >= '0' && *p <= '9' && whole < (INT64_MAX - 9) / 10) {
+        whole = whole * 10 + (*p++ - '0');
+    }
+    if (p == end || (*p != '.' && *p != 'e' && *p != 'E' && (*p < '0' || *p > '9'))) {
+        out = static_cast<double>(*start == '-' ? -whole : whole);
+        cursor = p;
+        return true;
+    }
+
+    auto result = std::from_chars(start, end, out);
+    if (result.ec != std::errc()) {
+        return fail("invalid number");
+    }
+    cursor = result.ptr;
+    return true;
+}
+
+static void appendUtf8(std::string& out, uint32_t code) {
+    if (code < 0x80) {
+        out.push_back(static_cast<char>(code));
+    } else if (code < 0x800) {
+        out.push_back(static_cast<char>(0xC0 | (code >> 6)));
+        out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+    } else if (code < 0x10000) {
+        out.push_back(static_cast<char>(0xE0 | (code >> 12)));
+        out.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+    } else {
+        out.push_back(static_cast<char>(0xF0 | (code >> 18)));
+        out.push_back(static_cast<char>(0x80 | ((code >> 12) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+    }
+}
+
+// Strings without escapes stay views into the source; the rest are decoded into `unescaped`
+bool JsonDocument::parseString(std::string_view& out) {
+    const char* start = ++cursor;
+    while (cursor != end && *cursor != '"' && *cursor != '\\') {
+        cursor++;
+    }
+    if (cursor == end) {
+        return fail("unterminated string");
+    }
+    if (*cursor == '"') {
+        out = std::string_view(start, static_cast<size_t>(cursor - start));
+        cursor++;
+        return true;
+    }
+
+    std::string decoded(start, static_cast<size_t>(cursor - start));
+    auto hex4 = [&](uint32_t& value) {
+        if (end - cursor < 4) {
+            return false;
+        }
+        auto result = std::from_chars(cursor, cursor + 4, value, 16);
+        if (result.ptr != cursor + 4) {
+            return false;
+        }
+        cursor += 4;
+        return true;
+    };
+    while (cursor != end && *cursor != '"') {
+        if (*cursor != '\\') {
+            decoded.push_back(*cursor++);
+            continue;
+        }
+        if (++cursor == end) {
+            break;
+        }
+        char escape = *cursor++;
+        switch (escape) {
+        case '"': decoded.push_back('"'); break;
+        case '\\': decoded.push_back('\\'); break;
+        case '/': decoded.push_back('/'); break;
+        case 'b': decoded.push_back('\b'); break;
+        case 'f': decoded.push_back('\f'); break;
+        case 'n': decoded.push_back('\n'); break;
+        case 'r': decoded.push_back('\r'); break;
+        case 't': decoded.push_back('\t'); break;
+        case 'u': {
+            uint32_t code = 0;
+            if (!hex4(code)) {
+                return fail("invalid \\u escape");
+            }
+            // A high surrogate followed by a low one is a single code point
+            if (code >= 0xD800 && code < 0xDC00 && end - cursor >= 6 && cursor[0] == '\\' && cursor[1] == 'u') {
+                cursor += 2;
+                uint32_t low = 0;
+                if (!hex4(low) || low < 0xDC00 || low >= 0xE000) {
+                    return fail("invalid surrogate pair");
+                }
+                code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+            }
+            appendUtf8(decoded, code);
+            break;
+        }
+        default:
+            return fail("invalid escape");
+        }
+    }
+    if (cursor == end) {
+        return fail("unterminated string");
+    }
+    cursor++;
+    unescaped.push_back(std::move(decoded));
+    out = unescaped.back();
+    return true;
+}
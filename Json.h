@@ -0,0 +1,108 @@
+#ifndef JSON_H
+#define JSON_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class JsonDocument;
+
+// Handle to one value of a JsonDocument; cheap to copy, valid as long as the document.
+// Looking up a missing member or index gives an invalid handle whose accessors return defaults.
+class JsonValue {
+public:
+    enum class Type : uint8_t { INVALID, NUL, BOOL, NUMBER, STRING, ARRAY, OBJECT };
+
+    JsonValue() = default;
+
+    Type type() const;
+    bool valid() const { return type() != Type::INVALID; }
+    bool isNumber() const { return type() == Type::NUMBER; }
+    bool isString() const { return type() == Type::STRING; }
+    bool isArray() const { return type() == Type::ARRAY; }
+    bool isObject() const { return type() == Type::OBJECT; }
+
+    double number(double fallback = 0.0) const;
+    int64_t integer(int64_t fallback = 0) const { return isNumber() ? static_cast<int64_t>(number()) : fallback; }
+    bool boolean(bool fallback = false) const;
+    std::string_view string() const;
+    // Member name when this value sits in an object
+    std::string_view key() const;
+
+    // Elements of an array or members of an object
+    size_t size() const;
+    // Member lookup, linear in the member count
+    JsonValue operator[](std::string_view name) const;
+    // Element lookup, linear in the index; iterate to walk a whole array
+    JsonValue at(size_t index) const;
+
+    class Iterator {
+    public:
+        Iterator(const JsonDocument* document, uint32_t node) : document(document), node(node) {}
+        JsonValue operator*() const { return JsonValue(document, node); }
+        Iterator& operator++();
+        bool operator!=(const Iterator& other) const { return node != other.node; }
+
+    private:
+        const JsonDocument* document;
+        uint32_t node;
+    };
+    Iterator begin() const;
+    Iterator end() const { return Iterator(document, NONE); }
+
+private:
+    friend class JsonDocument;
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    JsonValue(const JsonDocument* document, uint32_t node) : document(document), node(node) {}
+
+    const JsonDocument* document = nullptr;
+    uint32_t node = NONE;
+};
+
+// Read-only JSON document.
+//
+// One pass over the text fills a single array of nodes: nothing is allocated per value, and
+// strings point into the source text unless they contain escapes. That makes multi-megabyte test
+// vector files parse at memory speed. The source text must outlive the document.
+class JsonDocument {
+public:
+    // Replaces the previous contents. Returns false (see error()) if `text` is not valid JSON.
+    bool parse(std::string_view text);
+    const std::string& error() const { return message; }
+
+    JsonValue root() const { return nodes.empty() ? JsonValue() : JsonValue(this, 0); }
+
+private:
+    friend class JsonValue;
+
+    struct Node {
+        std::string_view key;
+        std::string_view text;          // STRING
+        double number = 0.0;            // NUMBER, and BOOL as 0 / 1
+        uint32_t firstChild = JsonValue::NONE;
+        uint32_t nextSibling = JsonValue::NONE;
+        uint32_t count = 0;             // ARRAY / OBJECT
+        JsonValue::Type type = JsonValue::Type::INVALID;
+    };
+
+    std::vector<Node> nodes;
+    std::deque<std::string> unescaped;  // Strings that had escapes; a deque keeps them in place
+    std::string message;
+
+    const char* cursor = nullptr;
+    const char* end = nullptr;
+    const char* begin = nullptr;
+
+    bool parseValue(uint32_t index, int depth);
+    bool parseString(std::string_view& out);
+    bool parseNumber(double& out);
+    bool parseLiteral(const char* literal);
+    void skipSpace();
+    bool fail(const char* what);
+};
+
+#endif // JSON_H
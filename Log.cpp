@@ -0,0 +1,180 @@
+#include "Log.h"
+#include <algorithm>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+std::atomic<Log::Level> Log::threshold{Log::LEVEL_TRACE};
+
+static const char* const LEVEL_NAMES[] = {"trace", "debug", "info", "warn", "error", "off"};
+static std::atomic<Log::Site*> sites{nullptr};
+
+namespace {
+    // Messages in flight between the threads that log and the one that writes
+    class Writer {
+    public:
+        static constexpr size_t CAPACITY = 1024;
+        static constexpr size_t MESSAGE_SIZE = 256;
+
+        Writer() : slots(CAPACITY), thread(&Writer::run, this) {}
+
+        ~Writer() {
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                stopping = true;
+            }
+            wake.notify_one();
+            thread.join();
+        }
+
+        void push(const char* text) {
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                if (queued - written == CAPACITY) {
+                    lost++;
+                    return;
+                }
+                size_t length = strnlen(text, MESSAGE_SIZE - 1);
+                std::memcpy(slots[queued % CAPACITY].text, text, length);
+                slots[queued % CAPACITY].text[length] = '\0';
+                queued++;
+            }
+            wake.notify_one();
+        }
+
+        void flush() {
+            std::unique_lock<std::mutex> guard(lock);
+            uint64_t target = queued;
+            drained.wait(guard, [&] { return written >= target; });
+        }
+
+        void setFile(std::FILE* output) {
+            std::lock_guard<std::mutex> guard(lock);
+            file = output;
+        }
+
+        uint64_t dropped() {
+            std::lock_guard<std::mutex> guard(lock);
+            return lost;
+        }
+
+    private:
+        struct Slot {
+            char text[MESSAGE_SIZE];
+        };
+
+        std::mutex lock;
+        std::condition_variable wake;
+        std::condition_variable drained;
+        std::vector<Slot> slots;
+        uint64_t queued = 0;
+        uint64_t written = 0;
+        uint64_t lost = 0;
+        uint64_t lostReported = 0;
+        std::FILE* file = stderr;
+        bool stopping = false;
+        std::thread thread;
+
+        // Copies a batch out under the lock, writes it without
+        void run() {
+            std::vector<Slot> batch;
+            std::unique_lock<std::mutex> guard(lock);
+            while (true) {
+                wake.wait(guard, [&] { return stopping || queued != written; });
+                if (queued == written && stopping) {
+                    return;
+                }
+                batch.clear();
+                for (uint64_t i = written; i < queued; i++) {
+                    batch.push_back(slots[i % CAPACITY]);
+                }
+                uint64_t end = queued;
+                uint64_t newlyLost = lost - lostReported;
+                lostReported = lost;
+                std::FILE* output = file;
+
+                guard.unlock();
+                for (const Slot& slot : batch) {
+                    std::fputs(slot.text, output);
+                }
+                if (newlyLost > 0) {
+                    std::fprintf(output, "[log] %llu messages dropped, the queue was full\n", static_cast<unsigned long long>(newlyLost));
+                }
+                std::fflush(output);
+                guard.lock();
+
+                written = end;
+                drained.notify_all();
+            }
+        }
+    };
+
+    Writer& writer() {
+        static Writer instance;
+        return instance;
+    }
+}
+
+void Log::write(const Site& site, uint64_t occurrence, const char* format, ...) {
+    char text[Writer::MESSAGE_SIZE];
+    const char* file = std::strrchr(site.file, '/');
+    file = file != nullptr ? file + 1 : site.file;
+    int length = std::snprintf(text, sizeof(text), "[%s] %s:%d: ", LEVEL_NAMES[site.level], file, site.line);
+
+    va_list args;
+    va_start(args, format);
+    int message = std::vsnprintf(text + length, sizeof(text) - length, format, args);
+    va_end(args);
+    length = std::min<int>(length + std::max(message, 0), sizeof(text) - 1);
+
+    if (occurrence > BURST) {
+        length += std::snprintf(text + length, sizeof(text) - length, " [%llu times]", static_cast<unsigned long long>(occurrence));
+        length = std::min<int>(length, sizeof(text) - 1);
+    }
+    // Truncated messages still end their line
+    if (length == static_cast<int>(sizeof(text)) - 1) {
+        length--;
+    }
+    text[length] = '\n';
+    text[length + 1] = '\0';
+    writer().push(text);
+}
+
+void Log::setFile(std::FILE* file) {
+    writer().setFile(file);
+}
+
+void Log::flush() {
+    writer().flush();
+}
+
+uint64_t Log::dropped() {
+    return writer().dropped();
+}
+
+void Log::enlist(Site* site) {
+    Site* head = sites.load(std::memory_order_relaxed);
+    do {
+        site->next = head;
+    } while (!sites.compare_exchange_weak(head, site, std::memory_order_release, std::memory_order_relaxed));
+}
+
+void Log::writeSites(std::ostream& out) {
+    std::vector<const Site*> fired;
+    for (const Site* site = sites.load(std::memory_order_acquire); site != nullptr; site = site->next) {
+        fired.push_back(site);
+    }
+    std::sort(fired.begin(), fired.end(), [](const Site* a, const Site* b) { return a->count.load() > b->count.load(); });
+    for (const Site* site : fired) {
+        const char* file = std::strrchr(site->file, '/');
+        out << (file != nullptr ? file + 1 : site->file) << ':' << site->line << ' ' << LEVEL_NAMES[site->level]
+            << ' ' << site->count.load() << '\n';
+    }
+}
+
+const char* Log::levelName(Level level) {
+    return LEVEL_NAMES[level];
+}
@@ -0,0 +1,105 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <ostream>
+
+// Diagnostics from the core.
+//
+// NES_LOG_DEBUG("...", ...) and friends take a printf format. Levels below NES_LOG_LEVEL (make
+// LOG_LEVEL=n, 0 trace .. 5 off, default 2 info) are discarded at compile time: the call site,
+// its arguments and its counter do not exist in the binary. Levels that remain cost one relaxed
+// atomic increment per call and are then filtered by Log::setLevel().
+//
+// Every call site is rate limited on its own: its first BURST messages are written, after that
+// only the 2^n-th ones, tagged with how often the site has fired. A diagnostic that fires on
+// every bus access therefore writes a few dozen lines per run instead of millions. Log::
+// writeSites() lists every site that fired, with its count, including the silenced ones.
+//
+// Messages are formatted on the calling thread into a fixed size slot and handed to a writer
+// thread, which owns the output file (stderr unless setFile() says otherwise). The caller never
+// waits for I/O; if the queue is full the message is dropped and counted instead.
+class Log {
+public:
+    enum Level : int { LEVEL_TRACE, LEVEL_DEBUG, LEVEL_INFO, LEVEL_WARN, LEVEL_ERROR, LEVEL_OFF };
+
+    static constexpr uint64_t BURST = 10;
+
+    // One per call site, constant initialised so the hot path has no guard check
+    struct Site {
+        const char* file;
+        int line;
+        Level level;
+        std::atomic<uint64_t> count{0};
+        Site* next = nullptr;
+
+        constexpr Site(const char* file, int line, Level level) : file(file), line(line), level(level) {}
+
+        // Counts the call; returns the occurrence number if it is to be written, 0 if not
+        uint64_t admit() {
+            uint64_t n = count.fetch_add(1, std::memory_order_relaxed) + 1;
+            if (n == 1) {
+                enlist(this);
+            }
+            if (level < threshold.load(std::memory_order_relaxed)) {
+                return 0;
+            }
+            return n <= BURST || (n & (n - 1)) == 0 ? n : 0;
+        }
+    };
+
+#if defined(__GNUC__)
+    __attribute__((format(printf, 3, 4)))
+#endif
+    static void write(const Site& site, uint64_t occurrence, const char* format, ...);
+
+    // Runtime threshold on top of the compile time one
+    static void setLevel(Level level) { threshold.store(level, std::memory_order_relaxed); }
+    static Level level() { return threshold.load(std::memory_order_relaxed); }
+
+    // Where the writer thread puts messages from now on (stderr by default); the caller keeps it open
+    static void setFile(std::FILE* file);
+    // Waits until every queued message is written
+    static void flush();
+    static uint64_t dropped();
+
+    // Every site that fired, most frequent first: "Bus.cpp:102 warn 1234567"
+    static void writeSites(std::ostream& out);
+
+    static const char* levelName(Level level);
+
+private:
+    static std::atomic<Level> threshold;
+    static void enlist(Site* site);
+};
+
+#define NES_LOG_LEVEL_TRACE 0
+#define NES_LOG_LEVEL_DEBUG 1
+#define NES_LOG_LEVEL_INFO 2
+#define NES_LOG_LEVEL_WARN 3
+#define NES_LOG_LEVEL_ERROR 4
+#define NES_LOG_LEVEL_OFF 5
+
+#ifndef NES_LOG_LEVEL
+#define NES_LOG_LEVEL NES_LOG_LEVEL_INFO
+#endif
+
+#define NES_LOG(level, ...)                                                        \
+    do {                                                                           \
+        if constexpr (static_cast<int>(level) >= NES_LOG_LEVEL) {                  \
+            static Log::Site nesLogSite(__FILE__, __LINE__, level);                \
+            if (uint64_t nesLogOccurrence = nesLogSite.admit()) {                  \
+                Log::write(nesLogSite, nesLogOccurrence, __VA_ARGS__);             \
+            }                                                                      \
+        }                                                                          \
+    } while (0)
+
+#define NES_LOG_TRACE(...) NES_LOG(Log::LEVEL_TRACE, __VA_ARGS__)
+#define NES_LOG_DEBUG(...) NES_LOG(Log::LEVEL_DEBUG, __VA_ARGS__)
+#define NES_LOG_INFO(...) NES_LOG(Log::LEVEL_INFO, __VA_ARGS__)
+#define NES_LOG_WARN(...) NES_LOG(Log::LEVEL_WARN, __VA_ARGS__)
+#define NES_LOG_ERROR(...) NES_LOG(Log::LEVEL_ERROR, __VA_ARGS__)
+
+#endif // LOG_H
@@ -0,0 +1,88 @@
+#include "MMC1.h"
+#include "SaveState.h"
+
+void MMC1::reset() {
+    shift = 0x10;
+    control = 0x0C;
+    chrBank0 = 0;
+    chrBank1 = 0;
+    prgBank = 0;
+    updateBanks();
+}
+
+void MMC1::writeRegister(uint16_t address, uint8_t data) {
+    if (data & 0x80) {
+        shift = 0x10;
+        control |= 0x0C;
+        updateBanks();
+        return;
+    }
+
+    bool complete = shift & 0x01;
+    shift = (shift >> 1) | ((data & 0x01) << 4);
+    if (!complete) {
+        return;
+    }
+
+    switch ((address >> 13) & 0x03) {
+    case 0: control = shift; break;
+    case 1: chrBank0 = shift; break;
+    case 2: chrBank1 = shift; break;
+    case 3: prgBank = shift; break;
+    }
+    shift = 0x10;
+    updateBanks();
+}
+
+void MMC1::updateBanks() {
+    static constexpr Mirroring mirroring[4] = {
+        Mirroring::SINGLE_LOWER, Mirroring::SINGLE_UPPER, Mirroring::VERTICAL, Mirroring::HORIZONTAL,
+    };
+    setMirroring(mirroring[control & 0x03]);
+
+    // 512 KB boards (SUROM) take the 256 KB half from bit 4 of the CHR register
+    int banks16K = prgBanks8K() / 2;
+    int outer = banks16K > 16 && (chrBank0 & 0x10) ? 16 : 0;
+    int last = (banks16K > 16 ? 16 : banks16K) - 1;
+    int bank = prgBank & 0x0F;
+    switch ((control >> 2) & 0x03) {
+    case 0:
+    case 1:     // 32 KB, low bit ignored
+        mapPRG16K(0, outer + (bank & 0x0E));
+        mapPRG16K(1, outer + (bank & 0x0E) + 1);
+        break;
+    case 2:     // First bank fixed at $8000
+        mapPRG16K(0, outer);
+        mapPRG16K(1, outer + bank);
+        break;
+    case 3:     // Last bank fixed at $C000
+        mapPRG16K(0, outer + bank);
+        mapPRG16K(1, outer + last);
+        break;
+    }
+
+    if (control & 0x10) {
+        mapCHR4K(0, chrBank0);
+        mapCHR4K(1, chrBank1);
+    } else {
+        mapCHR4K(0, chrBank0 & 0x1E);
+        mapCHR4K(1, (chrBank0 & 0x1E) | 1);
+    }
+}
+
+void MMC1::saveState(StateWriter& state) const {
+    state.put(shift);
+    state.put(control);
+    state.put(chrBank0);
+    state.put(chrBank1);
+    state.put(prgBank);
+}
+
+bool MMC1::loadState(StateReader& state) {
+    state.get(shift);
+    state.get(control);
+    state.get(chrBank0);
+    state.get(chrBank1);
+    state.get(prgBank);
+    return Mapper::loadState(state);
+}
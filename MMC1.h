@@ -0,0 +1,33 @@
+#ifndef MMC1_H
+#define MMC1_H
+
+#include "Mapper.h"
+
+// Mapper 1 (SxROM). The CPU loads registers one bit at a time: five writes, low bit first, fill
+// a shift register and the fifth write's address picks the register ($8000 control, $A000 CHR 0,
+// $C000 CHR 1, $E000 PRG). A write with bit 7 set clears the shift register and locks the last
+// PRG bank at $C000.
+//
+// Not emulated: ignoring the second of two writes on consecutive CPU cycles (only matters for
+// read-modify-write instructions on the registers, which few games do).
+class MMC1 : public Mapper {
+public:
+    using Mapper::Mapper;
+    void reset() override;
+    void writeRegister(uint16_t address, uint8_t data) override;
+    void saveState(StateWriter& state) const override;
+    bool loadState(StateReader& state) override;
+    const char* name() const override { return "MMC1"; }
+
+protected:
+    void updateBanks() override;
+
+private:
+    uint8_t shift = 0x10;       // The 1 marks how far the register is filled: it reaches bit 0 on the fifth write
+    uint8_t control = 0x0C;     // Mirroring (bits 0-1), PRG mode (2-3), CHR mode (4)
+    uint8_t chrBank0 = 0;
+    uint8_t chrBank1 = 0;
+    uint8_t prgBank = 0;
+};
+
+#endif // MMC1_H
@@ -0,0 +1,121 @@
+#include "MMC3.h"
+#include <cstring>
+#include "ROM.h"
+#include "SaveState.h"
+
+void MMC3::reset() {
+    static constexpr uint8_t powerOn[8] = {0, 2, 4, 5, 6, 7, 0, 1};
+    bankSelect = 0;
+    std::memcpy(banks, powerOn, sizeof(banks));
+    mirroring = rom.info.verticalMirroring ? 0 : 1;
+    irqLatch = 0;
+    irqCounter = 0;
+    irqReload = false;
+    irqEnabled = false;
+    irqPending = false;
+    setIrq(false);
+    updateBanks();
+    if (ppu != nullptr) {
+        ppu->watchA12(true);
+    }
+}
+
+void MMC3::writeRegister(uint16_t address, uint8_t data) {
+    bool odd = address & 0x0001;
+    switch (address & 0xE000) {
+    case 0x8000:
+        if (odd) {
+            banks[bankSelect & 0x07] = data;
+        } else {
+            bankSelect = data;
+        }
+        updateBanks();
+        break;
+    case 0xA000:
+        if (!odd) {
+            mirroring = data & 0x01;
+            updateBanks();
+        }
+        break;
+    case 0xC000:
+        if (odd) {
+            irqCounter = 0;
+            irqReload = true;
+        } else {
+            irqLatch = data;
+        }
+        break;
+    case 0xE000:
+        irqEnabled = odd;
+        if (!odd) {
+            irqPending = false;
+            setIrq(false);
+        }
+        break;
+    }
+}
+
+void MMC3::clockScanline() {
+    if (irqCounter == 0 || irqReload) {
+        irqCounter = irqLatch;
+        irqReload = false;
+    } else {
+        irqCounter--;
+    }
+    if (irqCounter == 0 && irqEnabled) {
+        irqPending = true;
+        setIrq(true);
+    }
+}
+
+void MMC3::updateBanks() {
+    int secondLast = prgBanks8K() - 2;
+    if (bankSelect & 0x40) {
+        mapPRG8K(0, secondLast);
+        mapPRG8K(2, banks[6]);
+    } else {
+        mapPRG8K(0, banks[6]);
+        mapPRG8K(2, secondLast);
+    }
+    mapPRG8K(1, banks[7]);
+    mapPRG8K(3, secondLast + 1);
+
+    // The 2 KB banks ignore their low bit; with the CHR mode bit they move to $1000
+    int twoK = (bankSelect & 0x80) ? 4 : 0;
+    int oneK = twoK ^ 4;
+    mapCHR1K(twoK + 0, banks[0] & 0xFE);
+    mapCHR1K(twoK + 1, banks[0] | 0x01);
+    mapCHR1K(twoK + 2, banks[1] & 0xFE);
+    mapCHR1K(twoK + 3, banks[1] | 0x01);
+    for (int i = 0; i < 4; i++) {
+        mapCHR1K(oneK + i, banks[2 + i]);
+    }
+
+    if (!rom.info.fourScreen) {
+        setMirroring(mirroring ? Mirroring::HORIZONTAL : Mirroring::VERTICAL);
+    }
+}
+
+void MMC3::saveState(StateWriter& state) const {
+    state.put(bankSelect);
+    state.put(banks);
+    state.put(mirroring);
+    state.put(irqLatch);
+    state.put(irqCounter);
+    state.put(irqReload);
+    state.put(irqEnabled);
+    state.put(irqPending);
+}
+
+bool MMC3::loadState(StateReader& state) {
+    state.get(bankSelect);
+    state.get(banks);
+    state.get(mirroring);
+    state.get(irqLatch);
+    state.get(irqCounter);
+    state.get(irqReload);
+    state.get(irqEnabled);
+    state.get(irqPending);
+    setIrq(irqPending);
+    return Mapper::loadState(state);
+}
@@ -0,0 +1,40 @@
+#ifndef MMC3_H
+#define MMC3_H
+
+#include "Mapper.h"
+
+// Mapper 4 (TxROM). Eight bank registers R0-R7 written through $8000 (select) / $8001 (data):
+// R0-R1 are 2 KB and R2-R5 1 KB CHR banks, R6-R7 8 KB PRG banks; the second to last PRG bank
+// swaps between $8000 and $C000 with the PRG mode bit, and the CHR mode bit swaps the 2 KB and
+// 1 KB halves of the pattern tables.
+//
+// The scanline counter counts PPU A12 rising edges (PPU::watchA12 schedules them). On each edge a
+// zero counter, or one marked by a $C001 write, is reloaded from the latch, otherwise it counts
+// down; reaching zero with IRQs enabled pulls /IRQ low until $E000 is written.
+//
+// Not emulated: A12 edges from CPU accesses through $2006/$2007, and PRG RAM protection ($A001).
+class MMC3 : public Mapper {
+public:
+    using Mapper::Mapper;
+    void reset() override;
+    void writeRegister(uint16_t address, uint8_t data) override;
+    void clockScanline() override;
+    void saveState(StateWriter& state) const override;
+    bool loadState(StateReader& state) override;
+    const char* name() const override { return "MMC3"; }
+
+protected:
+    void updateBanks() override;
+
+private:
+    uint8_t bankSelect = 0;
+    uint8_t banks[8] = {};
+    uint8_t mirroring = 0;
+    uint8_t irqLatch = 0;
+    uint8_t irqCounter = 0;
+    bool irqReload = false;
+    bool irqEnabled = false;
+    bool irqPending = false;
+};
+
+#endif // MMC3_H
@@ -0,0 +1,84 @@
+#include "MappedFile.h"
+#include <fstream>
+#include <iostream>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define MAPPED_FILE_MMAP 1
+#endif
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+bool MappedFile::open(const std::string& path) {
+    close();
+
+#ifdef MAPPED_FILE_MMAP
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Failed to open file: " << path << std::endl;
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+        void* view = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (view != MAP_FAILED) {
+            ::close(fd);
+            bytes = static_cast<const uint8_t*>(view);
+            length = static_cast<size_t>(info.st_size);
+            mapped = true;
+            return true;
+        }
+    }
+    ::close(fd);
+#endif
+
+    return readIntoHeap(path);
+}
+
+bool MappedFile::readIntoHeap(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open file: " << path << std::endl;
+        return false;
+    }
+    std::vector<uint8_t> contents;
+    char chunk[64 * 1024];
+    while (file.read(chunk, sizeof(chunk)) || file.gcount() > 0) {
+        contents.insert(contents.end(), chunk, chunk + file.gcount());
+    }
+    assign(std::move(contents));
+    return true;
+}
+
+void MappedFile::assign(std::vector<uint8_t> contents) {
+    close();
+    heap = std::move(contents);
+    bytes = heap.data();
+    length = heap.size();
+}
+
+void MappedFile::swap(MappedFile& other) {
+    std::swap(bytes, other.bytes);
+    std::swap(length, other.length);
+    std::swap(mapped, other.mapped);
+    heap.swap(other.heap);
+}
+
+void MappedFile::close() {
+#ifdef MAPPED_FILE_MMAP
+    if (mapped) {
+        munmap(const_cast<uint8_t*>(bytes), length);
+    }
+#endif
+    heap.clear();
+    heap.shrink_to_fit();
+    bytes = nullptr;
+    length = 0;
+    mapped = false;
+}
@@ -0,0 +1,43 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Read-only view of a whole file.
+//
+// Regular files are mmap'd, so opening is instant and every process / NES instance that opens the
+// same file shares its pages. Anything that cannot be mapped (pipes, empty files, hosts without
+// mmap) is read into memory instead; that heap path is also where decompressed images belong.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Replaces whatever was open before. Returns false (and stays empty) if the file cannot be read.
+    bool open(const std::string& path);
+    void close();
+    void swap(MappedFile& other);
+
+    // Takes ownership of bytes produced elsewhere (e.g. by a decompressor)
+    void assign(std::vector<uint8_t> bytes);
+
+    const uint8_t* data() const { return bytes; }
+    size_t size() const { return length; }
+    bool isMapped() const { return mapped; }
+
+private:
+    const uint8_t* bytes = nullptr;
+    size_t length = 0;
+    bool mapped = false;
+    std::vector<uint8_t> heap;
+
+    bool readIntoHeap(const std::string& path);
+};
+
+#endif // MAPPED_FILE_H
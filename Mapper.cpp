@@ -0,0 +1,97 @@
+#include "Mapper.h"
+#include "MMC1.h"
+#include "MMC3.h"
+#include "Mappers.h"
+#include "ROM.h"
+#include "SaveState.h"
+
+Mapper::Mapper(NESROM& rom) : rom(rom) {}
+
+std::unique_ptr<Mapper> Mapper::create(uint16_t number, NESROM& rom) {
+    switch (number) {
+    case 0:  return std::make_unique<NROM>(rom);
+    case 1:  return std::make_unique<MMC1>(rom);
+    case 2:  return std::make_unique<UNROM>(rom);
+    case 3:  return std::make_unique<CNROM>(rom);
+    case 4:  return std::make_unique<MMC3>(rom);
+    case 7:  return std::make_unique<AxROM>(rom);
+    case 66: return std::make_unique<GxROM>(rom);
+    default: return nullptr;
+    }
+}
+
+void Mapper::attach(PPU* ppu, bool* irqLine, uint64_t* bankSwitches) {
+    this->ppu = ppu;
+    this->irqLine = irqLine;
+    this->bankSwitches = bankSwitches != nullptr ? bankSwitches : &unattached;
+    prgCount = static_cast<int>(rom.info.prgRomBytes / 0x2000);
+    if (prgCount == 0) {
+        prgCount = 1;
+    }
+    chrCount = rom.chrRom ? static_cast<int>(rom.info.chrRomBytes / 0x0400) : 8;
+    if (chrCount == 0) {
+        chrCount = 1;
+    }
+    reset();
+}
+
+void Mapper::saveState(StateWriter&) const {}
+
+bool Mapper::loadState(StateReader& state) {
+    // Restoring the windows is not a bank switch the game made
+    uint64_t switches = *bankSwitches;
+    updateBanks();
+    *bankSwitches = switches;
+    return state.good();
+}
+
+// ---------------------------------------------------------------------------- //
+// ---------------------------------- WINDOWS --------------------------------- //
+// ---------------------------------------------------------------------------- //
+
+void Mapper::mapPRG8K(int slot, int bank) {
+    const uint8_t* window = rom.prgRom + static_cast<size_t>(bank % prgCount) * 0x2000;
+    if (rom.prgBanks[slot] != window) {
+        rom.prgBanks[slot] = window;
+        ++*bankSwitches;
+    }
+}
+
+void Mapper::mapPRG16K(int slot, int bank) {
+    mapPRG8K(slot * 2, bank * 2);
+    mapPRG8K(slot * 2 + 1, bank * 2 + 1);
+}
+
+void Mapper::mapPRG32K(int bank) {
+    mapPRG16K(0, bank * 2);
+    mapPRG16K(1, bank * 2 + 1);
+}
+
+void Mapper::mapCHR1K(int slot, int bank) {
+    if (ppu == nullptr) {
+        return;
+    }
+    const uint8_t* chr = rom.chrRom ? rom.chrRom : ppu->chrRam.data();
+    const uint8_t* window = chr + static_cast<size_t>(bank % chrCount) * 0x0400;
+    if (ppu->chrBanks[slot] != window) {
+        ppu->mapCHR(slot, window);
+        ++*bankSwitches;
+    }
+}
+
+void Mapper::mapCHR4K(int slot, int bank) {
+    for (int i = 0; i < 4; i++) {
+        mapCHR1K(slot * 4 + i, bank * 4 + i);
+    }
+}
+
+void Mapper::mapCHR8K(int bank) {
+    mapCHR4K(0, bank * 2);
+    mapCHR4K(1, bank * 2 + 1);
+}
+
+void Mapper::setMirroring(Mirroring mode) {
+    if (ppu != nullptr) {
+        ppu->setMirroring(mode);
+    }
+}
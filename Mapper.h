@@ -0,0 +1,85 @@
+#ifndef MAPPER_H
+#define MAPPER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include "PPU.h"
+
+class NESROM;
+class StateWriter;
+class StateReader;
+
+// Cartridge board logic.
+//
+// A mapper never sits on the read path. It turns register writes into pointer updates: the four
+// 8 KB CPU windows in NESROM::prgBanks, the eight 1 KB PPU windows (PPU::mapCHR) and the name table
+// mirroring. Reads then index those windows directly, so a bank switch costs a few stores and a
+// read costs nothing beyond the indexing it always did. Bank numbers wrap to the ROM size when they
+// are mapped, which is what the unconnected high bank lines do on real boards.
+class Mapper {
+public:
+    explicit Mapper(NESROM& rom);
+    virtual ~Mapper() = default;
+
+    Mapper(const Mapper&) = delete;
+    Mapper& operator=(const Mapper&) = delete;
+
+    // Builds the mapper for an iNES mapper number, or returns nullptr if it is not supported
+    static std::unique_ptr<Mapper> create(uint16_t number, NESROM& rom);
+
+    // Sizes the bank counts from the loaded ROM and powers on. Without a PPU only the PRG
+    // windows are set; CHR and mirroring follow when the bus attaches one, along with the
+    // cartridge /IRQ line it samples and the counter of windows the game repoints.
+    void attach(PPU* ppu, bool* irqLine = nullptr, uint64_t* bankSwitches = nullptr);
+
+    // Power-on register values
+    virtual void reset() = 0;
+
+    // CPU writes to $8000-$FFFF
+    virtual void writeRegister(uint16_t address, uint8_t data) = 0;
+
+    // A rising edge on PPU A12, only delivered to mappers that asked with PPU::watchA12()
+    virtual void clockScanline() {}
+
+    // Registers only; the windows are rebuilt from them on load
+    virtual void saveState(StateWriter& state) const;
+    virtual bool loadState(StateReader& state);
+
+    virtual const char* name() const = 0;
+
+protected:
+    NESROM& rom;
+    PPU* ppu = nullptr;
+
+    void setIrq(bool active) {
+        if (irqLine != nullptr) {
+            *irqLine = active;
+        }
+    }
+
+    // Points every window at the banks the registers select
+    virtual void updateBanks() = 0;
+
+    // `slot` counts windows of the given size from $8000 (PRG) or $0000 (CHR)
+    void mapPRG8K(int slot, int bank);
+    void mapPRG16K(int slot, int bank);
+    void mapPRG32K(int bank);
+    void mapCHR1K(int slot, int bank);
+    void mapCHR4K(int slot, int bank);
+    void mapCHR8K(int bank);
+    void setMirroring(Mirroring mode);
+
+    int prgBanks8K() const { return prgCount; }
+    int chrBanks1K() const { return chrCount; }
+
+private:
+    bool* irqLine = nullptr;
+    // Bumped for every window that ends up on a different bank; counts into `unattached` without a bus
+    uint64_t unattached = 0;
+    uint64_t* bankSwitches = &unattached;
+    int prgCount = 1;   // 8 KB PRG banks in the ROM
+    int chrCount = 8;   // 1 KB CHR banks in the ROM, or in CHR RAM
+};
+
+#endif // MAPPER_H
@@ -0,0 +1,131 @@
+#include "Mappers.h"
+#include "ROM.h"
+#include "SaveState.h"
+
+// ---------------------------------------------------------------------------- //
+// ----------------------------------- NROM ----------------------------------- //
+// ---------------------------------------------------------------------------- //
+
+void NROM::reset() {
+    updateBanks();
+}
+
+void NROM::updateBanks() {
+    // NROM-128 wraps, so $C000 sees the same 16 KB as $8000
+    mapPRG32K(0);
+    mapCHR8K(0);
+}
+
+// ---------------------------------------------------------------------------- //
+// ----------------------------------- UNROM ---------------------------------- //
+// ---------------------------------------------------------------------------- //
+
+void UNROM::reset() {
+    prgBank = 0;
+    updateBanks();
+}
+
+void UNROM::writeRegister(uint16_t, uint8_t data) {
+    prgBank = data;
+    mapPRG16K(0, prgBank);
+}
+
+void UNROM::updateBanks() {
+    mapPRG16K(0, prgBank);
+    mapPRG16K(1, prgBanks8K() / 2 - 1);
+    mapCHR8K(0);
+}
+
+void UNROM::saveState(StateWriter& state) const {
+    state.put(prgBank);
+}
+
+bool UNROM::loadState(StateReader& state) {
+    state.get(prgBank);
+    return Mapper::loadState(state);
+}
+
+// ---------------------------------------------------------------------------- //
+// ----------------------------------- CNROM ---------------------------------- //
+// ---------------------------------------------------------------------------- //
+
+void CNROM::reset() {
+    chrBank = 0;
+    updateBanks();
+}
+
+void CNROM::writeRegister(uint16_t, uint8_t data) {
+    chrBank = data;
+    mapCHR8K(chrBank);
+}
+
+void CNROM::updateBanks() {
+    mapPRG32K(0);
+    mapCHR8K(chrBank);
+}
+
+void CNROM::saveState(StateWriter& state) const {
+    state.put(chrBank);
+}
+
+bool CNROM::loadState(StateReader& state) {
+    state.get(chrBank);
+    return Mapper::loadState(state);
+}
+
+// ---------------------------------------------------------------------------- //
+// ----------------------------------- AxROM ---------------------------------- //
+// ---------------------------------------------------------------------------- //
+
+void AxROM::reset() {
+    bank = 0;
+    updateBanks();
+}
+
+void AxROM::writeRegister(uint16_t, uint8_t data) {
+    bank = data;
+    updateBanks();
+}
+
+void AxROM::updateBanks() {
+    mapPRG32K(bank & 0x0F);
+    mapCHR8K(0);
+    setMirroring(bank & 0x10 ? Mirroring::SINGLE_UPPER : Mirroring::SINGLE_LOWER);
+}
+
+void AxROM::saveState(StateWriter& state) const {
+    state.put(bank);
+}
+
+bool AxROM::loadState(StateReader& state) {
+    state.get(bank);
+    return Mapper::loadState(state);
+}
+
+// ---------------------------------------------------------------------------- //
+// ----------------------------------- GxROM ---------------------------------- //
+// ---------------------------------------------------------------------------- //
+
+void GxROM::reset() {
+    bank = 0;
+    updateBanks();
+}
+
+void GxROM::writeRegister(uint16_t, uint8_t data) {
+    bank = data;
+    updateBanks();
+}
+
+void GxROM::updateBanks() {
+    mapPRG32K((bank >> 4) & 0x03);
+    mapCHR8K(bank & 0x03);
+}
+
+void GxROM::saveState(StateWriter& state) const {
+    state.put(bank);
+}
+
+bool GxROM::loadState(StateReader& state) {
+    state.get(bank);
+    return Mapper::loadState(state);
+}
@@ -0,0 +1,90 @@
+#ifndef MAPPERS_H
+#define MAPPERS_H
+
+#include "Mapper.h"
+
+// Discrete logic boards: one latch, written anywhere in $8000-$FFFF. Bus conflicts (the ROM
+// driving the data bus during the write on some boards) are not emulated; games write values that
+// match the ROM byte anyway.
+
+// Mapper 0: 16 or 32 KB PRG (16 KB appears twice), 8 KB CHR, no registers
+class NROM : public Mapper {
+public:
+    using Mapper::Mapper;
+    void reset() override;
+    void writeRegister(uint16_t, uint8_t) override {}
+    const char* name() const override { return "NROM"; }
+
+protected:
+    void updateBanks() override;
+};
+
+// Mapper 2: switchable 16 KB at $8000, last 16 KB fixed at $C000, 8 KB CHR RAM
+class UNROM : public Mapper {
+public:
+    using Mapper::Mapper;
+    void reset() override;
+    void writeRegister(uint16_t address, uint8_t data) override;
+    void saveState(StateWriter& state) const override;
+    bool loadState(StateReader& state) override;
+    const char* name() const override { return "UNROM"; }
+
+protected:
+    void updateBanks() override;
+
+private:
+    uint8_t prgBank = 0;
+};
+
+// Mapper 3: NROM PRG, switchable 8 KB CHR ROM
+class CNROM : public Mapper {
+public:
+    using Mapper::Mapper;
+    void reset() override;
+    void writeRegister(uint16_t address, uint8_t data) override;
+    void saveState(StateWriter& state) const override;
+    bool loadState(StateReader& state) override;
+    const char* name() const override { return "CNROM"; }
+
+protected:
+    void updateBanks() override;
+
+private:
+    uint8_t chrBank = 0;
+};
+
+// Mapper 7: switchable 32 KB PRG, 8 KB CHR RAM, bit 4 picks the single-screen name table
+class AxROM : public Mapper {
+public:
+    using Mapper::Mapper;
+    void reset() override;
+    void writeRegister(uint16_t address, uint8_t data) override;
+    void saveState(StateWriter& state) const override;
+    bool loadState(StateReader& state) override;
+    const char* name() const override { return "AxROM"; }
+
+protected:
+    void updateBanks() override;
+
+private:
+    uint8_t bank = 0;
+};
+
+// Mapper 66: bits 4-5 select 32 KB PRG, bits 0-1 select 8 KB CHR ROM
+class GxROM : public Mapper {
+public:
+    using Mapper::Mapper;
+    void reset() override;
+    void writeRegister(uint16_t address, uint8_t data) override;
+    void saveState(StateWriter& state) const override;
+    bool loadState(StateReader& state) override;
+    const char* name() const override { return "GxROM"; }
+
+protected:
+    void updateBanks() override;
+
+private:
+    uint8_t bank = 0;
+};
+
+#endif // MAPPERS_H
@@ -0,0 +1,145 @@
+#include "Movie.h"
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+static const uint32_t MOVIE_VERSION = 2;
+
+bool Movie::load(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open movie: " << path << std::endl;
+        return false;
+    }
+
+    char magic[4] = {};
+    file.read(magic, 4);
+    if (std::memcmp(magic, "NESM", 4) != 0) {
+        // FCEUX movies are text and open with their version line
+        if (std::memcmp(magic, "vers", 4) == 0) {
+            return importFM2(path);
+        }
+        std::cerr << "Invalid movie file: " << path << std::endl;
+        return false;
+    }
+
+    uint32_t version = 0;
+    uint32_t count = 0;
+    uint32_t stateSize = 0;
+    file.read(reinterpret_cast<char*>(&version), sizeof(version));
+    file.read(reinterpret_cast<char*>(&count), sizeof(count));
+    if (version >= 2) {
+        file.read(reinterpret_cast<char*>(&stateSize), sizeof(stateSize));
+    }
+    if (!file || version < 1 || version > MOVIE_VERSION) {
+        std::cerr << "Invalid movie file: " << path << std::endl;
+        return false;
+    }
+
+    startState.assign(stateSize, 0);
+    frames.assign(count, 0);
+    file.read(reinterpret_cast<char*>(startState.data()), stateSize);
+    file.read(reinterpret_cast<char*>(frames.data()), count);
+    if (!file) {
+        std::cerr << "Truncated movie file: " << path << std::endl;
+        clear();
+        return false;
+    }
+    return true;
+}
+
+bool Movie::save(const std::string& path) const {
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Failed to write movie: " << path << std::endl;
+        return false;
+    }
+    uint32_t count = static_cast<uint32_t>(frames.size());
+    uint32_t stateSize = static_cast<uint32_t>(startState.size());
+    file.write("NESM", 4);
+    file.write(reinterpret_cast<const char*>(&MOVIE_VERSION), sizeof(MOVIE_VERSION));
+    file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    file.write(reinterpret_cast<const char*>(&stateSize), sizeof(stateSize));
+    file.write(reinterpret_cast<const char*>(startState.data()), stateSize);
+    file.write(reinterpret_cast<const char*>(frames.data()), count);
+    return file.good();
+}
+
+// FM2: "key value" header lines, then one line per frame like |0|R..U...A|........||
+// The first field holds commands (resets), then one field per port with the buttons in RLDUTSBA
+// order, where '.' or ' ' is released. Only port 0 is read. Movies that start from a savestate or
+// that reset the console partway cannot be replayed from power on here and are refused.
+bool Movie::importFM2(const std::string& path) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open movie: " << path << std::endl;
+        return false;
+    }
+
+    clear();
+    std::string line;
+    for (int number = 1; std::getline(file, line); number++) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (line.empty()) {
+            continue;
+        }
+        if (line[0] != '|') {
+            std::istringstream header(line);
+            std::string key;
+            std::string value;
+            header >> key >> value;
+            if ((key == "binary" && value != "0") || (key == "savestate" && !value.empty())) {
+                std::cerr << path << ": " << key << " FM2 movies are not supported" << std::endl;
+                clear();
+                return false;
+            }
+            continue;
+        }
+
+        // |commands|port0|port1|port2|
+        size_t port0 = line.find('|', 1);
+        if (port0 == std::string::npos || line.size() < port0 + 9) {
+            std::cerr << path << ":" << number << ": invalid FM2 input line" << std::endl;
+            clear();
+            return false;
+        }
+        int commands = std::atoi(line.c_str() + 1);
+        // 1 is a soft reset, 2 a power cycle; one on the first frame is where the movie starts anyway
+        if ((commands & 3) != 0 && !frames.empty()) {
+            std::cerr << path << ":" << number << ": FM2 movies that reset are not supported" << std::endl;
+            clear();
+            return false;
+        }
+        uint8_t controller = 0;
+        for (int i = 0; i < 8; i++) {
+            char c = line[port0 + 1 + i];
+            if (c != '.' && c != ' ') {
+                controller |= static_cast<uint8_t>(0x80 >> i);
+            }
+        }
+        frames.push_back(controller);
+    }
+    return true;
+}
+
+void Movie::startPlayback(uint32_t frame) {
+    mode = PLAYING;
+    startFrame = frame;
+}
+
+void Movie::startRecording(uint32_t frame) {
+    frames.clear();
+    mode = RECORDING;
+    startFrame = frame;
+}
+
+void Movie::stop(uint32_t frame) {
+    if (mode == RECORDING) {
+        frames.resize(position(frame), frames.empty() ? 0 : frames.back());
+    }
+    mode = STOPPED;
+}
@@ -0,0 +1,70 @@
+#ifndef MOVIE_H
+#define MOVIE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Recorded controller 1 input, one Bus::controller byte per frame.
+//
+// Attached to the Bus, a movie sees every controller latch (the $4016 strobe): while playing it
+// supplies the buttons the game latches, while recording it keeps them. Frames are counted with
+// the PPU frame counter from where playback or recording started, so a replay feeds the game
+// exactly the input it read, whatever drives the frames (UI thread, run-ahead, headless tools).
+// Frames in which the game never strobes (lag frames) keep the previous frame's input.
+//
+// A movie starts either at power on or from a save state stored in the file.
+//
+// File layout (host byte order):
+//   "NESM" | uint32 version | uint32 frame count | uint32 state size | state | frame count bytes of input
+// Version 1 files have no state fields and start at power on.
+class Movie {
+public:
+    // Reads a movie file, or imports an FCEUX .fm2 text movie (controller 1 of a standard pad)
+    bool load(const std::string& path);
+    bool save(const std::string& path) const;
+    bool importFM2(const std::string& path);
+
+    void clear() { frames.clear(); startState.clear(); }
+    void append(uint8_t controller) { frames.push_back(controller); }
+
+    // Input for a frame (0-based), no buttons pressed past the end of the movie
+    uint8_t input(size_t frame) const { return frame < frames.size() ? frames[frame] : 0; }
+    size_t length() const { return frames.size(); }
+
+    // Snapshot (NES::saveState) the movie starts from; empty for movies that start at power on
+    std::vector<uint8_t> startState;
+
+    // `frame` is the PPU frame counter at the first frame to play / record. Recording drops any
+    // input already in the movie.
+    void startPlayback(uint32_t frame);
+    void startRecording(uint32_t frame);
+    // Recording keeps the frames before `frame`, anything later was only run ahead
+    void stop(uint32_t frame);
+    bool isPlaying() const { return mode == PLAYING; }
+    bool isRecording() const { return mode == RECORDING; }
+    // Frames played or recorded up to `frame`
+    size_t position(uint32_t frame) const { return frame - startFrame; }
+
+    // Called by the Bus at every controller latch with the frame counter and controller 1
+    void latch(uint32_t frame, uint8_t& controller) {
+        size_t index = frame - startFrame;
+        if (mode == PLAYING) {
+            controller = input(index);
+        } else if (mode == RECORDING) {
+            // Going back (rewind, run-ahead) overwrites from there; skipped frames repeat the last input
+            frames.resize(index, frames.empty() ? 0 : frames.back());
+            frames.push_back(controller);
+        }
+    }
+
+private:
+    enum Mode { STOPPED, PLAYING, RECORDING };
+
+    std::vector<uint8_t> frames;
+    Mode mode = STOPPED;
+    uint32_t startFrame = 0;
+};
+
+#endif // MOVIE_H
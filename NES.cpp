@@ -1,51 +1,37 @@
 #include "NES.h"
+#include "HostZones.h"
+#include "Log.h"
+#include "SaveState.h"
+#include <fstream>
+#include <iomanip>
+#include <iostream>
 
 
-void NES::load_rom(const char *filename) {
+bool NES::load_rom(const char *filename) {
     if (on == false) {
-        rom.load(filename);
+        if (!rom.load(filename)) {
+            return false;
+        }
         rom_loaded = true;
+        // Nothing is copied: the CPU reads PRG and the PPU reads CHR straight from the cartridge
         bus.connectROM(rom);
-
-        // Write CHR ROM to PPU pattern table memory
-        for (int i = 0; i < 1024 * 8; i++) {
-            bus.ppu.writePatternTable(i, rom.chrRom[i]);
-        }
-        bus.ppu.decodePatternTable();
-
-        // Write PRG ROM to CPU memory via Bus
-        if (rom.mirrored) {
-            // NROM-128: 16KB mirrored at 0x8000–0xBFFF and 0xC000–0xFFFF
-            for (int i = 0; i < 1024 * 16; i++) {
-                uint8_t byte = rom.prgRom[i];
-                bus.write(0x8000 + i, byte);  // Primary bank
-                bus.write(0xC000 + i, byte);  // Mirrored bank
-            }
-        } else {
-            // NROM-256: 32KB mapped once from 0x8000–0xFFFF
-            for (int i = 0; i < 1024 * 32; i++) {
-                bus.write(0x8000 + i, rom.prgRom[i]);
-            }
-        }
     }
+    return rom_loaded;
 }
 
 void NES::initNES() {
-    std::cout << "initNES() started\n";
     if (on == true) {
-        std::cout << "NES already on, returning early\n";
+        NES_LOG_DEBUG("initNES() called while already on");
         return;
     }
 
-    std::cout << "Connecting CPU to Bus...\n";
-    bus.cpu = &cpu;
-    cpu.connectBus(&bus);
-
-    std::cout << "Calling cpu.reset()\n";
     cpu.reset();
+    bus.ppu.reset();
+    bus.perf.clear();
+    frameCounters.clear();
+    totalCounters.clear();
 
     on = true;
-    std::cout << "initNES() finished\n";
 }
 
 void NES::run() {
@@ -91,27 +77,236 @@ void NES::cycle() {
     }
 }
 
+// Clock the system until the PPU wraps around to the next frame
+void NES::run_frame() {
+    if (on == true) {
+        if (debugger.armed() || debugger.stopped()) {
+            run_frame_checked();
+            return;
+        }
+        NES_FRAME_ZONE(EMULATION);
+        uint32_t frame = bus.ppu.total_frames;
+        while (bus.ppu.total_frames == frame) {
+            bus.clock();
+        }
+        frameCounters = bus.perf;
+        totalCounters += bus.perf;
+        bus.perf.clear();
+    }
+}
+
+// run_frame() with the debugger armed: the same loop, asking it before every instruction and after
+// every dot. A stop leaves the machine mid-frame; the next call finishes that frame.
+void NES::run_frame_checked() {
+    if (debugger.stopped()) {
+        return;
+    }
+    NES_FRAME_ZONE(EMULATION);
+    cpu.debugger = debugger.watchesMemory() ? &debugger : nullptr;
+    uint32_t frame = bus.ppu.total_frames;
+    bool stopped = false;
+    while (bus.ppu.total_frames == frame && !stopped) {
+        if (bus.clockCounter % 3 == 0 && cpu.cycles == 0 && debugger.instruction(bus)) {
+            break;
+        }
+        bus.clock();
+        stopped = debugger.dot(bus);
+    }
+    cpu.debugger = nullptr;
+    if (bus.ppu.total_frames != frame) {
+        frameCounters = bus.perf;
+        totalCounters += bus.perf;
+        bus.perf.clear();
+        if (!debugger.stopped()) {
+            debugger.frameDone(bus);
+        }
+    }
+}
+
+Debugger::Reason NES::runUntil(uint32_t maxFrames) {
+    debugger.resume();
+    for (uint32_t i = 0; i < maxFrames && !debugger.stopped(); i++) {
+        run_frame();
+    }
+    return debugger.stopped() ? debugger.stop().reason : Debugger::Reason::FRAME_LIMIT;
+}
+
+// Run a frame without composing pixels. CPU-visible PPU state (vblank, sprite zero hit, overflow) is
+// still produced, so games behave exactly as in run_frame(); only the framebuffer is left stale.
+void NES::skip_frame() {
+    bus.ppu.renderPixels = false;
+    run_frame();
+    bus.ppu.renderPixels = true;
+}
+
+// Run-ahead: run the real frame with audio but no picture, then `frames` more frames with the same
+// input and no audio, keeping the picture of the last one, and roll back to the real frame. The
+// player sees the game `frames` frames in the future, hiding that much of the game's input lag.
+void NES::run_ahead(int frames) {
+    // Frames run ahead would hit breakpoints the player has not reached yet
+    if (frames <= 0 || debugger.armed()) {
+        run_frame();
+        return;
+    }
+    skip_frame();
+    saveState(runAheadState);
+
+    apu.outputEnabled = false;
+    for (int i = 1; i < frames; i++) {
+        skip_frame();
+    }
+    run_frame();
+    apu.outputEnabled = true;
+
+    loadState(runAheadState);
+}
+
+void NES::saveState(std::vector<uint8_t>& out) const {
+    StateWriter state(out);
+    state.write("NESS", 4);
+    state.put(SAVE_STATE_VERSION);
+    state.put(uint32_t(0));
+
+    cpu.saveState(state);
+    bus.saveState(state);
+    bus.ppu.saveState(state);
+    apu.saveState(state);
+    rom.saveState(state);
+
+    uint32_t total = static_cast<uint32_t>(state.size());
+    std::memcpy(state.data() + 8, &total, sizeof(total));
+}
+
+bool NES::loadState(const uint8_t* data, size_t size) {
+    StateReader header(data, size);
+    char magic[4];
+    uint32_t version = 0;
+    uint32_t total = 0;
+    header.read(magic, 4);
+    header.get(version);
+    header.get(total);
+    if (!header.good() || std::memcmp(magic, "NESS", 4) != 0) {
+        std::cerr << "Save state: not a save state\n";
+        return false;
+    }
+    if (version != SAVE_STATE_VERSION) {
+        std::cerr << "Save state: version " << version << " does not match this build (" << SAVE_STATE_VERSION << ")\n";
+        return false;
+    }
+    if (total != size) {
+        std::cerr << "Save state: truncated (" << size << " of " << total << " bytes)\n";
+        return false;
+    }
+
+    // Every payload has a fixed size, so a blob of the size this build writes cannot run out half way
+    // through restoring. Checking that up front keeps a bad blob from leaving the machine half loaded.
+    std::vector<uint8_t> current;
+    saveState(current);
+    if (current.size() != size) {
+        std::cerr << "Save state: size " << size << " does not match this build (" << current.size() << ")\n";
+        return false;
+    }
+
+    StateReader state(data + 12, size - 12);
+    cpu.loadState(state);
+    bus.loadState(state);
+    bus.ppu.loadState(state);
+    apu.loadState(state);
+    rom.loadState(state);
+    if (!state.good()) {
+        std::cerr << "Save state: chunk layout does not match this build\n";
+        return false;
+    }
+    return true;
+}
+
+bool NES::startTrace(const std::string& path) {
+    stopTrace();
+    auto log = std::make_unique<TraceLog>();
+    if (!log->start(path)) {
+        return false;
+    }
+    trace = std::move(log);
+    cpu.trace = trace.get();
+    return true;
+}
+
+void NES::stopTrace() {
+    cpu.trace = nullptr;
+    trace.reset();
+}
+
+void NES::startProfile() {
+    profiler = std::make_unique<GuestProfiler>();
+    profiler->reset(rom_loaded ? &rom : nullptr);
+    cpu.profiler = profiler.get();
+}
+
+bool NES::stopProfile(const std::string& reportPath, const std::string& stacksPath) {
+    cpu.profiler = nullptr;
+    if (!profiler) {
+        return false;
+    }
+    bool ok = true;
+    if (!reportPath.empty()) {
+        std::ofstream report(reportPath);
+        profiler->writeReport(report);
+        ok = ok && report.good();
+    }
+    if (!stacksPath.empty()) {
+        std::ofstream stacks(stacksPath);
+        profiler->writeCollapsed(stacks);
+        ok = ok && stacks.good();
+    }
+    if (!ok) {
+        std::cerr << "Failed to write the guest profile" << std::endl;
+    }
+    profiler.reset();
+    return ok;
+}
+
 void NES::end() {
     on = false;
 }
 
 
-uint32_t* NES::getFramebuffer() {
-    // for (int i = 0; i < 256 * 240; i++) {
-    //     rgbFramebuffer[i] = nesPalette[i % 64];
-    //     uint8_t colorIndex = framebuffer[i];  // Get NES color index
-    //     rgbFramebuffer[i] = 0xFF000000 | nesPalette[colorIndex % 64];  // Convert to 32-bit ARGB
-    // }
-    return bus.ppu.rgbFramebuffer;
+const uint32_t* NES::getFramebuffer() {
+    return bus.ppu.rgbFrame();
 }
 
-void NES::RandomizeFramebuffer() {
-    for (int i = 0; i < 256 * 240; i++) {
-        uint8_t r = rand() % 256;
-        uint8_t g = rand() % 256;
-        uint8_t b = rand() % 256;
+void NES::reportFootprint(std::ostream& out) const {
+    size_t prg = rom.prgRom ? rom.info.prgRomBytes : 0;
+    size_t chr = rom.chrRom ? rom.info.chrRomBytes : 0;
+    std::vector<uint8_t> state;
+    saveState(state);
 
-        // Set the pixel in framebuffer as a 32-bit ARGB value
-        framebuffer[i] = 0xFF000000 | (r << 16) | (g << 8) | b;
-    }
-}
\ No newline at end of file
+    // A mapped image is shared by every instance running the same file
+    size_t cartridge = rom.isMapped() ? 0 : prg + chr;
+    size_t prgRam = rom.isPrgRamMapped() ? 0 : rom.prgRamBytes();
+    size_t heap = cartridge + prgRam + apu.bufferBytes() + bus.ppu.optionalBufferBytes() + bus.fallbackRAMBytes()
+                + runAheadState.capacity() + debugger.mapBytes();
+    size_t total = sizeof(NES) + heap;
+
+    auto line = [&out](const char* name, size_t bytes) {
+        out << "  " << std::left << std::setw(26) << name << std::right << std::setw(9) << bytes << "\n";
+    };
+    out << std::dec << "Memory footprint per NES instance (bytes)\n";
+    line("NES object", sizeof(NES));
+    line("  CPU", sizeof(CPU));
+    line("  PPU", sizeof(PPU));
+    line("  Bus (without PPU)", sizeof(Bus) - sizeof(PPU));
+    line("  APU", sizeof(APU));
+    line("  Cartridge", sizeof(NESROM));
+    line("  Debugger", sizeof(Debugger));
+    line(rom.isMapped() ? "PRG ROM (shared mapping)" : "PRG ROM", prg);
+    line(rom.isMapped() ? "CHR ROM (shared mapping)" : "CHR ROM", chr);
+    line(rom.isPrgRamMapped() ? "PRG RAM (shared mapping)" : "PRG RAM", rom.prgRamBytes());
+    line("Audio buffers", apu.bufferBytes());
+    line("PPU RGB / decoded tiles", bus.ppu.optionalBufferBytes());
+    line("Fallback RAM", bus.fallbackRAMBytes());
+    line("Run-ahead snapshot", runAheadState.capacity());
+    line("Debugger point maps", debugger.mapBytes());
+    line("Total", total);
+    line("Hot state (save state)", state.size());
+    out << "  " << (size_t(1) << 30) / total << " instances per GiB\n";
+}
@@ -5,47 +5,89 @@
 #include <thread>
 #include <cstdlib>
 #include <ctime>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
 
 #include "Bus.h"
 #include "CPU.h"
+#include "Debugger.h"
+#include "GuestProfiler.h"
+#include "PerfCounters.h"
 #include "ROM.h"
+#include "Trace.h"
 
 class NES {
 public:
-    // Public member variables
-    Bus bus;
+    // Headless instances (`audio` false) never touch SDL and can run side by side on worker threads
+    // CPU, APU and Bus only store each other's references while being built. `*&` tells GCC that
+    // handing the not yet constructed bus to the CPU is not a read of it.
+    explicit NES(bool audio = true) : cpu(*&bus), apu(audio), bus(cpu, apu) {}
+
+    NES(const NES&) = delete;
+    NES& operator=(const NES&) = delete;
+
+    // The whole machine lives in this object. Devices reach each other through references fixed at
+    // construction, so the CPU -> Bus -> RAM / PPU fetch path never leaves this block.
     CPU cpu;
+    APU apu;
+    Bus bus;
     NESROM rom{};
     bool on = false;
     bool rom_loaded = false;
     bool A_changed = false;
     int count = 0;
     bool paused = false;
-
-    uint8_t framebuffer[256 * 240]{};  // 8-bit color indices
-    uint32_t rgbFramebuffer[256 * 240]{}; // 32-bit color for SDL
-
-    uint32_t nesPalette[64] = {
-        0x666666, 0x002A88, 0x1412A7, 0x3B00A4, 0x5C007E, 0x6E0040, 0x6C0600, 0x561D00,
-        0x333500, 0x0B4800, 0x005200, 0x004F08, 0x00404D, 0x000000, 0x000000, 0x000000,
-        0x6B6B6B, 0x0B3B95, 0x241CA7, 0x3B10A4, 0x631F84, 0x6D2061, 0x6F3011, 0x562C1A,
-        0x344000, 0x0F5500, 0x006100, 0x006148, 0x005459, 0x002B42, 0x2F2F2F, 0x111111,
-        0xA9A9A9, 0x023C9C, 0x2449CC, 0x3E40CF, 0x6B6C99, 0x7F77AA, 0x8B95C2, 0x8C8A7F,
-        0xFF00A0, 0xAA0D42, 0x8C1A4E, 0x801D53, 0x922C6F, 0x9E4A6E, 0x92515D, 0x774E53,
-        0x0F77BB, 0x0B9DE8, 0x2F67E0, 0x6A7FFF, 0xA2B9F1, 0x9CC6DB, 0x70A5E9, 0x5C82C7,
-        0x080F99, 0x13D1F6, 0x35C8FD, 0x7F8F9E, 0xC8E0F5, 0xF3FBFF, 0xC8EBFF, 0x7F9FF7
-    };
+    std::vector<uint8_t> runAheadState;
+    std::unique_ptr<TraceLog> trace;    // Set while tracing
+    std::unique_ptr<GuestProfiler> profiler;    // Set while profiling
+    // Bus activity of the last completed frame and of every frame since initNES() (PerfCounters.h)
+    PerfCounters frameCounters;
+    PerfCounters totalCounters;
+    // Breakpoints, watchpoints and run-until conditions (Debugger.h). While it is stopped,
+    // run_frame() does nothing until debugger.resume().
+    Debugger debugger;
 
     // Public member functions
-    void load_rom(const char *filename);
+    bool load_rom(const char *filename);
     void initNES();
     void run();
     void cycle();
+    void run_frame();
+    void skip_frame();
+    void run_ahead(int frames);
+    // For scripts and tests: resumes, then runs frames until the debugger stops the machine or
+    // `maxFrames` frames have run (FRAME_LIMIT). Set the points and conditions first.
+    Debugger::Reason runUntil(uint32_t maxFrames);
     void end();
 
-    uint32_t* getFramebuffer();
-    void RandomizeFramebuffer();
+    // Snapshot the whole machine into `out` (reusing its capacity) / restore one.
+    // loadState() leaves the machine untouched and returns false if the blob does not match this build.
+    void saveState(std::vector<uint8_t>& out) const;
+    bool loadState(const uint8_t* data, size_t size);
+    bool loadState(const std::vector<uint8_t>& state) { return loadState(state.data(), state.size()); }
+
+    // Records every instruction to `path` (see Trace.h) until stopTrace(). Without NES_TRACE the
+    // file gets a header and nothing else.
+    bool startTrace(const std::string& path);
+    void stopTrace();
+
+    // Profiles the game code (see GuestProfiler.h) until stopProfile(). Without NES_PROFILE the
+    // profile stays empty.
+    void startProfile();
+    // Writes the sorted report to `reportPath` and the collapsed call stacks to `stacksPath` (either
+    // may be empty) and stops. Returns false if a file cannot be written.
+    bool stopProfile(const std::string& reportPath, const std::string& stacksPath);
+
+    // RGBA view of the last frame, converted from the PPU's palette indices on each call
+    const uint32_t* getFramebuffer();
+
+    // Per-instance memory breakdown: fixed object sizes, heap buffers and the hot (snapshotted) state
+    void reportFootprint(std::ostream& out) const;
 
+private:
+    void run_frame_checked();
 };
 
 #endif // NES_H
\ No newline at end of file
@@ -10,6 +10,7 @@
 #include <unistd.h>
 
 #include "ROM.h"
+#include "SaveState.h"
 
 void PPU::cpuWrite(uint16_t addr, uint8_t data) {
     //printf("PPU::cpuWrite(%04x, %04x)\n", addr, data);
@@ -18,9 +19,15 @@ void PPU::cpuWrite(uint16_t addr, uint8_t data) {
             control.reg = data;
             t.nametable_x = control.nametable_x;
             t.nametable_y = control.nametable_y;
+            if (a12Watched) {
+                scheduleA12Edge();
+            }
             break;
         case 0x0001: // MASK
             mask.reg = data;
+            if (a12Watched) {
+                scheduleA12Edge();
+            }
             break;
         case 0x0002: // STATUS
             break;
@@ -106,41 +113,13 @@ void PPU::writePPU(uint16_t addr, uint8_t data) {
     //printf("PPU::writePPU: addr: %04x, data: %02x\n", addr, data);
     addr &= 0x3FFF;
     if (addr >= 0x000 && addr <= 0x1FFF) {
-        patternTables[addr] = data;
+        if (chrWritable) {
+            // Writable windows always point into chrRam
+            const_cast<uint8_t*>(chrBanks[addr >> 10])[addr & 0x03FF] = data;
+        }
     }
     else if (addr >= 0x2000 && addr <= 0x3EFF) {
-
-        addr &= 0x0FFF;
-        // Vertical mirror
-        if (ROM->ROMheader.flags6 == 1) {
-            if (addr >= 0x0000 && addr <= 0x03FF) {
-                nameTables[addr & 0x03FF] = data;
-            }
-            if (addr >= 0x0400 && addr <= 0x07FF) {
-                nameTables[(addr & 0x03FF) + 1024] = data;
-            }
-            if (addr >= 0x0800 && addr <= 0x0BFF) {
-                nameTables[addr & 0x03FF] = data;
-            }
-            if (addr >= 0x0C00 && addr <= 0x0FFF) {
-                nameTables[(addr & 0x03FF) + 1024] = data;
-            }
-        }
-        // Horizontal mirror
-        if (ROM->ROMheader.flags6 == 0) {
-            if (addr >= 0x0000 && addr <= 0x03FF) {
-                nameTables[addr & 0x03FF] = data;
-            }
-            if (addr >= 0x0400 && addr <= 0x07FF) {
-                nameTables[addr & 0x03FF] = data;
-            }
-            if (addr >= 0x0800 && addr <= 0x0BFF) {
-                nameTables[(addr & 0x03FF) + 1024] = data;
-            }
-            if (addr >= 0x0C00 && addr <= 0x0FFF) {
-                nameTables[(addr & 0x03FF) + 1024] = data;
-            }
-        }
+        nameTables[nameTableOffset[(addr >> 10) & 0x03] | (addr & 0x03FF)] = data;
     }
     else if (addr >= 0x3F00 && addr <= 0x3FFF) {
         addr &= 0x001F;
@@ -154,45 +133,12 @@ void PPU::writePPU(uint16_t addr, uint8_t data) {
 
 uint8_t PPU::readPPU(uint16_t addr) {
     //TODO: Read from ppu bus between 0x0000 and 0x3FFF
-    uint8_t data = 0x00;
     addr &= 0x3FFF;
     if (addr >= 0x0000 && addr <= 0x1FFF) {
-        data = patternTables[addr];
-        return data;
+        return chrBanks[addr >> 10][addr & 0x03FF];
     }
     else if (addr >= 0x2000 && addr <= 0x3EFF) {
-        addr &= 0x0FFF;
-        // Vertical mirror
-        if (ROM->ROMheader.flags6 == 1) {
-            if (addr >= 0x0000 && addr <= 0x03FF) {
-                data = nameTables[addr & 0x03FF];
-            }
-            if (addr >= 0x0400 && addr <= 0x07FF) {
-                data = nameTables[(addr & 0x03FF) + 0x0400];
-            }
-            if (addr >= 0x0800 && addr <= 0x0BFF) {
-                data = nameTables[addr & 0x03FF];
-            }
-            if (addr >= 0x0C00 && addr <= 0x0FFF) {
-                data = nameTables[(addr & 0x03FF) + 0x0400];
-            }
-        }
-        // Horizontal mirror
-        if (ROM->ROMheader.flags6 == 0) {
-            if (addr >= 0x0000 && addr <= 0x03FF) {
-                data = nameTables[addr & 0x03FF];
-            }
-            if (addr >= 0x0400 && addr <= 0x07FF) {
-                data = nameTables[addr & 0x03FF];
-            }
-            if (addr >= 0x0800 && addr <= 0x0BFF) {
-                data = nameTables[(addr & 0x03FF) + 0x0400];
-            }
-            if (addr >= 0x0C00 && addr <= 0x0FFF) {
-                data = nameTables[(addr & 0x03FF) + 0x0400];
-            }
-        }
-        return data;
+        return nameTables[nameTableOffset[(addr >> 10) & 0x03] | (addr & 0x03FF)];
     }
     else if (addr >= 0x3F00 && addr <= 0x3FFF) {
         addr &= 0x001F;
@@ -202,27 +148,63 @@ uint8_t PPU::readPPU(uint16_t addr) {
         if (addr == 0x001C) addr = 0x000C;
         return paletteMemory[addr] & (mask.grayscale ? 0x30: 0x3F);
     }
+    return 0x00;
+}
+
+PPU::PPU() {
+    for (int slot = 0; slot < 8; slot++) {
+        mapCHR(slot, chrRam.data() + slot * 0x0400);
+    }
+    setMirroring(Mirroring::HORIZONTAL);
 }
 
 void PPU::connectROM(NESROM& ROM) {
     this->ROM = &ROM;
+
+    // Boards without CHR ROM have 8 KB of CHR RAM instead. Start with the first 8 KB of either one
+    // and the header's mirroring; the cartridge's mapper takes over from there.
+    chrWritable = ROM.chrRom == nullptr;
+    const uint8_t* chr = chrWritable ? chrRam.data() : ROM.chrRom;
+    for (int slot = 0; slot < 8; slot++) {
+        mapCHR(slot, chr + slot * 0x0400);
+    }
+    setMirroring(ROM.info.verticalMirroring ? Mirroring::VERTICAL : Mirroring::HORIZONTAL);
+    watchA12(false);
+}
+
+void PPU::mapCHR(int slot, const uint8_t* bank) {
+    chrBanks[slot] = bank;
+    // New CHR, decode again when a debug view asks
+    patternTablesDecoded.reset();
+}
+
+void PPU::setMirroring(Mirroring mode) {
+    // Which 1 KB half of nameTables each of the four logical tables ($2000, $2400, $2800, $2C00) uses
+    static constexpr uint16_t layouts[4][4] = {
+        {0x0000, 0x0000, 0x0400, 0x0400},   // HORIZONTAL
+        {0x0000, 0x0400, 0x0000, 0x0400},   // VERTICAL
+        {0x0000, 0x0000, 0x0000, 0x0000},   // SINGLE_LOWER
+        {0x0400, 0x0400, 0x0400, 0x0400},   // SINGLE_UPPER
+    };
+    mirroring = mode;
+    std::memcpy(nameTableOffset, layouts[static_cast<int>(mode)], sizeof(nameTableOffset));
 }
 
 // Pattern tables ----------------------------------------------------------------------------------------------------
 
 // modify to allow specification of table, tile, plane?
 uint8_t PPU::readPatternTable(uint16_t addr) {
-    return patternTables[addr];
+    return readPPU(addr & 0x1FFF);
 }
 
 void PPU::writePatternTable(uint16_t addr, uint8_t data) {
-    patternTables[addr] = data;
+    writePPU(addr & 0x1FFF, data);
 }
 
 void PPU::printPatternTable() {
     size_t tableSize = 60;
     for(size_t i = 0; i < tableSize; i++) {
-        printf("%04lu: %02x\n", i, patternTables[i]);
+        printf("%04lu: %02x\n", i, readPatternTable(i));
     }
 }
 
@@ -242,15 +224,15 @@ void PPU::getTile(uint8_t tileIndex, uint8_t* tileData, bool table1) {
 
     /* Pretty sure this implementation is actually wrong, forgot to account for each individual bit
     for (int i = 0; i < 8; i++) {
-        tileData[i] = (patternTables[index + i] << 1) | (patternTables[index + i + 8] & 0x01); // Combine bit planes
+        tileData[i] = (readPatternTable(index + i) << 1) | (readPatternTable(index + i + 8) & 0x01); // Combine bit planes
     } */
 
     // let's try again:
     for (int i = 0; i < 8; ++i) {
         // Get the low and high bit planes for this row
         //printf("pattern Table location: %d \n", index+i);
-        uint8_t low = patternTables[index + i];           // plane 0 - lower bit of each pixel
-        uint8_t high = patternTables[index + i + 8];      // plane 1 - higher bit of each pixel
+        uint8_t low = readPatternTable(index + i);        // plane 0 - lower bit of each pixel
+        uint8_t high = readPatternTable(index + i + 8);   // plane 1 - higher bit of each pixel
         // extract bits for each pixel in a row
         for (int j = 0; j < 8; ++j) {
             // Extract the bits from both low and high bit planes
@@ -268,6 +250,9 @@ void PPU::getTile(uint8_t tileIndex, uint8_t* tileData, bool table1) {
 }
 
 void PPU::decodePatternTable() {
+    if (!patternTablesDecoded) {
+        patternTablesDecoded.reset(new uint8_t[512 * 64]);
+    }
     for (int i = 0; i < 256; i++) {
         uint8_t currentTile[64];
         getTile(i, currentTile, true);
@@ -286,7 +271,15 @@ void PPU::decodePatternTable() {
          }
      }
 }
+const uint8_t* PPU::decodedPatternTables() {
+    if (!patternTablesDecoded) {
+        decodePatternTable();
+    }
+    return patternTablesDecoded.get();
+}
+
 void PPU::printDecodedPatternTable() {
+    decodedPatternTables();
 
     for (int i = 0; i < 512; i++) {
         std::cout << "Tile " << i << ":" << std::endl;
@@ -314,24 +307,24 @@ void printPaletteMemory(uint8_t paletteMemory[32]) {
 void PPU::displayPatternTableOnScreen() {
     uint8_t current_tile;
     if (cycle < 128 && scanline < 240) {
-        current_tile = patternTablesDecoded[(int)((scanline) / 8) * 1024 +((scanline * 8) % 64) + (int)(cycle/ 8) * 64 + (cycle % 8)];
+        current_tile = decodedPatternTables()[(int)((scanline) / 8) * 1024 +((scanline * 8) % 64) + (int)(cycle/ 8) * 64 + (cycle % 8)];
     }
     else {
         current_tile = 0;
     }
     //u_int8_t current_palette = readPPU(0x3F00 + (4 << 2) + current_tile) & 0x3F;
-    uint32_t current_color;
+    uint8_t current_color;
     if (current_tile == 3) {
-        current_color = getColor(22);
+        current_color = 22;
     }
     else if (current_tile == 2) {
-        current_color = getColor(14);
+        current_color = 14;
     }
     else if (current_tile == 1) {
-        current_color = getColor(32);
+        current_color = 32;
     }
     else {
-        current_color = getColor(1);
+        current_color = 1;
     }
     //uint32_t current_color = getColor(current_palette);
     //printf("Current color %08x \n", current_palette);
@@ -341,32 +334,47 @@ void PPU::displayPatternTableOnScreen() {
 void PPU::displayNameTableOnScreen(uint8_t table) {
     uint8_t nameTableByte = nameTables[(table * 1024) + ((scanline / 8) * 32) + (cycle / 8)];
 
-    uint8_t current_tile = patternTablesDecoded[(nameTableByte * 64) + ((scanline * 8) % 64) + (cycle % 8) + (control.background_pattern * 16384)];
-    uint32_t current_color;
+    uint8_t current_tile = decodedPatternTables()[(nameTableByte * 64) + ((scanline * 8) % 64) + (cycle % 8) + (control.background_pattern * 16384)];
+    uint8_t current_color;
 
-    current_color = getColor(readPPU(0x3F00 + (0 << 2) + current_tile) % 64);
+    current_color = readPPU(0x3F00 + (0 << 2) + current_tile) % 64;
 
     setPixel(cycle, scanline, current_color);
 }
 
 
-void PPU::setPixel(uint8_t x, uint8_t y, uint32_t color) {
-    rgbFramebuffer[y * 256 + x] = 0xFF000000 | color;
-    if (complete_frame == true) {
-        std::memcpy(nextFrame, rgbFramebuffer, sizeof(nextFrame));
-        complete_frame = false;
+void PPU::setPixel(uint8_t x, uint8_t y, uint8_t paletteIndex) {
+    framebuffer[y * 256 + x] = paletteIndex;
+    complete_frame = false;
+}
+
+static const uint32_t NES_PALETTE[64] = {
+    0x545454, 0xB41D01, 0xA01008, 0x880030, 0x4C0044, 0x20005C, 0x000454, 0x00183C, 0x002A20, 0x003A08, 0x004000, 0x0A3C00, 0x383200, 0x000000, 0x000000, 0x000000,
+    0x969698, 0x644C07, 0xEC3230, 0xEC1E5C, 0xB01488, 0x6414A0, 0x0000FF, 0x0A3C78, 0x003C22, 0x00660A, 0x006400, 0x3A5800, 0x3B3900, 0x2A1B00, 0x1F1F1F, 0x111111,
+    0xA9A9A9, 0x9C3C02, 0xCC4924, 0xCF403E, 0x996C6B, 0xAA777F, 0xC2958B, 0x009EFA, 0xA000FF, 0x00EB74, 0x4E1A8C, 0x531D80, 0xF7D52B, 0x6E4A9E, 0x525192, 0x534E77,
+    0xFFFFFF, 0xE89D0B, 0xE0672F, 0xFF7F6A, 0xF2B9A2, 0xDBC69C, 0x70A5E9, 0xC7825C, 0x990F08, 0xF6D113, 0xFDC835, 0x9E8F7F, 0xF5E0C8, 0xFFFBF3, 0xFFEBC8, 0xF79F7F
+};
+
+uint32_t PPU::getColor(int index) {
+    return 0xFF000000 | NES_PALETTE[index & 0x3F];
+}
+
+void PPU::convertFrame(uint32_t* out) const {
+    for (int i = 0; i < 256 * 240; i++) {
+        out[i] = 0xFF000000 | NES_PALETTE[framebuffer[i] & 0x3F];
     }
 }
 
-unsigned PPU::getColor(int index) {
-    std::array<uint32_t, 64> nesPalette = {
-        0x545454, 0xB41D01, 0xA01008, 0x880030, 0x4C0044, 0x20005C, 0x000454, 0x00183C, 0x002A20, 0x003A08, 0x004000, 0x0A3C00, 0x383200, 0x000000, 0x000000, 0x000000,
-        0x969698, 0x644C07, 0xEC3230, 0xEC1E5C, 0xB01488, 0x6414A0, 0x0000FF, 0x0A3C78, 0x003C22, 0x00660A, 0x006400, 0x3A5800, 0x3B3900, 0x2A1B00, 0x1F1F1F, 0x111111,
-        0xA9A9A9, 0x9C3C02, 0xCC4924, 0xCF403E, 0x996C6B, 0xAA777F, 0xC2958B, 0x009EFA, 0xA000FF, 0x00EB74, 0x4E1A8C, 0x531D80, 0xF7D52B, 0x6E4A9E, 0x525192, 0x534E77,
-        0xFFFFFF, 0xE89D0B, 0xE0672F, 0xFF7F6A, 0xF2B9A2, 0xDBC69C, 0x70A5E9, 0xC7825C, 0x990F08, 0xF6D113, 0xFDC835, 0x9E8F7F, 0xF5E0C8, 0xFFFBF3, 0xFFEBC8, 0xF79F7F
-    };
+const uint32_t* PPU::rgbFrame() {
+    if (!rgbFramebuffer) {
+        rgbFramebuffer.reset(new uint32_t[256 * 240]);
+    }
+    convertFrame(rgbFramebuffer.get());
+    return rgbFramebuffer.get();
+}
 
-    return 0xFF000000 | nesPalette[index];
+size_t PPU::optionalBufferBytes() const {
+    return (patternTablesDecoded ? 512 * 64 : 0) + (rgbFramebuffer ? 256 * 240 * sizeof(uint32_t) : 0);
 }
 
 void PPU::shiftLeft(uint8_t arr[], int size) {
@@ -388,17 +396,8 @@ void PPU::printNameTable() {
     printf("\n");
 }
 uint16_t PPU::getMirroredNameTableAddress(uint16_t address) {
-
-    // flags6_mirror_bit will be 0 when horizontally mirroring, 1 when vertically mirroring
-    int flags6_mirror_bit = ROM->ROMheader.flags6 & 1;
-
-    uint16_t modified_address;
-    if (flags6_mirror_bit == 0) {
-        modified_address = address & 0x07FF;
-    } else {
-        modified_address = address & 0x03FF;
-    }
-    return modified_address;
+    // Offset into nameTables for a $2000-$2FFF address under the current mirroring
+    return nameTableOffset[(address >> 10) & 0x03] | (address & 0x03FF);
 }
 
 // Attribute tables ---------------------------------------------------------------------------------------------------
@@ -427,7 +426,9 @@ void PPU::reset() {
     control.reg = 0x00;
     v.vram_register = 0x0000;
     t.vram_register = 0x0000;
-
+    // Rendering is off after a reset, so an edge scheduled for the interrupted line never comes
+    nextA12Edge = NO_A12_EDGE;
+    a12EdgeDone = false;
 }
 
 void PPU::clock() {
@@ -688,78 +689,98 @@ void PPU::clock() {
     uint8_t bit1 = ((bg_shifter_tile_hi << x) & 0x8000) >>15;
     uint8_t combinedPixel = (bit1 << 1) | bit0;
 
-    // Foreground
-    uint8_t fg_pixel = 0x00;
-    uint8_t fg_palette = 0x00;
-    uint8_t fg_priority = 0x00;
-
-    if (mask.enable_sprite_rendering) {
-        bSpriteZeroBeingRendered = false;
-        for (uint8_t i = 0; i < numOfSprites; i++) {
-            if (spriteScanline[i].x == 0) {
-                uint8_t fg_pixel_lo = (sprite_shifter_pattern_lo[i] & 0x80) > 0;
-                uint8_t fg_pixel_hi = (sprite_shifter_pattern_hi[i] & 0x80) > 0;
-                fg_pixel = (fg_pixel_hi << 1) | fg_pixel_lo;
-
-                fg_palette = (spriteScanline[i].attribute & 0x03) + 0x04;
-                fg_priority = (spriteScanline[i].attribute & 0x20) == 0;
-
-                if (fg_pixel != 0) {
-                    if (i == 0 ) {
-                        bSpriteZeroBeingRendered = true;
-                    }
-                    break;
+    // Sets the sprite zero hit flag if the current dot is inside the region where hits are reported
+    auto checkSpriteZeroHit = [&]() {
+        if (mask.enable_background_rendering && mask.enable_sprite_rendering) {
+            if (~(mask.render_background_left | mask.render_sprites_left)) {
+                if (cycle >= 9 && cycle < 258) {
+                    status.sprite_zerohit = 1;
+                }
+            }
+            else {
+                if (cycle >= 1 && cycle < 258) {
+                    status.sprite_zerohit = 1;
                 }
             }
         }
+    };
+
+    // Skipped frames never reach the screen. Sprite zero hit is the only result of pixel composition
+    // the CPU can observe, so test just that and leave out priority, palette lookup and colour conversion.
+    // The sprite zero flag is part of the saved state and is set as the full path sets it, so a state
+    // does not depend on which frames were skipped.
+    if (!renderPixels) {
+        if (mask.enable_sprite_rendering) {
+            bSpriteZeroBeingRendered = numOfSprites > 0 && spriteScanline[0].x == 0 &&
+                                       ((sprite_shifter_pattern_lo[0] | sprite_shifter_pattern_hi[0]) & 0x80);
+            if (bSpriteZeroBeingRendered && bSpriteZeroHitPossible && combinedPixel > 0) {
+                checkSpriteZeroHit();
+            }
+        }
     }
+    else {
+        // Foreground
+        uint8_t fg_pixel = 0x00;
+        uint8_t fg_palette = 0x00;
+        uint8_t fg_priority = 0x00;
+
+        if (mask.enable_sprite_rendering) {
+            bSpriteZeroBeingRendered = false;
+            for (uint8_t i = 0; i < numOfSprites; i++) {
+                if (spriteScanline[i].x == 0) {
+                    uint8_t fg_pixel_lo = (sprite_shifter_pattern_lo[i] & 0x80) > 0;
+                    uint8_t fg_pixel_hi = (sprite_shifter_pattern_hi[i] & 0x80) > 0;
+                    fg_pixel = (fg_pixel_hi << 1) | fg_pixel_lo;
+
+                    fg_palette = (spriteScanline[i].attribute & 0x03) + 0x04;
+                    fg_priority = (spriteScanline[i].attribute & 0x20) == 0;
+
+                    if (fg_pixel != 0) {
+                        if (i == 0 ) {
+                            bSpriteZeroBeingRendered = true;
+                        }
+                        break;
+                    }
+                }
+            }
+        }
 
-    uint8_t pixel = 0x00;
-    uint8_t palette = 0x00;
+        uint8_t pixel = 0x00;
+        uint8_t palette = 0x00;
 
-    // If both are zero, both are transparent
-    if (combinedPixel == 0 && fg_pixel == 0) {
-        pixel = 0x00;
-        palette = 0x00;
-    }
-    // The foreground is visible and the background is transparent
-    else if (combinedPixel == 0 && fg_pixel > 0 ) {
-        pixel = fg_pixel;
-        palette = fg_palette;
-    }
-    else if (combinedPixel > 0 && fg_pixel == 0) {
-        pixel = combinedPixel;
-        palette = arr[0+x];
-    }
-    else if (combinedPixel > 0 && fg_pixel > 0 ) {
-        if (fg_priority) {
+        // If both are zero, both are transparent
+        if (combinedPixel == 0 && fg_pixel == 0) {
+            pixel = 0x00;
+            palette = 0x00;
+        }
+        // The foreground is visible and the background is transparent
+        else if (combinedPixel == 0 && fg_pixel > 0 ) {
             pixel = fg_pixel;
             palette = fg_palette;
         }
-        else {
+        else if (combinedPixel > 0 && fg_pixel == 0) {
             pixel = combinedPixel;
             palette = arr[0+x];
         }
+        else if (combinedPixel > 0 && fg_pixel > 0 ) {
+            if (fg_priority) {
+                pixel = fg_pixel;
+                palette = fg_palette;
+            }
+            else {
+                pixel = combinedPixel;
+                palette = arr[0+x];
+            }
 
-        if (bSpriteZeroBeingRendered && bSpriteZeroHitPossible) {
-            if (mask.enable_background_rendering && mask.enable_sprite_rendering) {
-                if (~(mask.render_background_left | mask.render_sprites_left)) {
-                    if (cycle >= 9 && cycle < 258) {
-                        status.sprite_zerohit = 1;
-                    }
-                }
-                else {
-                    if (cycle >= 1 && cycle < 258) {
-                        status.sprite_zerohit = 1;
-                    }
-                }
+            if (bSpriteZeroBeingRendered && bSpriteZeroHitPossible) {
+                checkSpriteZeroHit();
             }
         }
-    }
 
-    // Set pixel to screen
-    if (scanline < 241 && cycle < 256) {
-        setPixel(cycle, scanline, getColor(readPPU(0x3F00 + (palette<< 2) + pixel) % 64));
+        // Set pixel to screen
+        if (scanline >= 0 && scanline < 240 && cycle < 256) {
+            setPixel(cycle, scanline, readPPU(0x3F00 + (palette<< 2) + pixel) % 64);
+        }
     }
 
     // Advance cycle and scanline
@@ -773,5 +794,134 @@ void PPU::clock() {
             scanline = -1;
             complete_frame = true;
         }
+
+        if (a12Watched) {
+            a12EdgeDone = false;
+            scheduleA12Edge();
+        }
+    }
+}
+
+void PPU::watchA12(bool enable) {
+    a12Watched = enable;
+    a12EdgeDone = false;
+    nextA12Edge = NO_A12_EDGE;
+    if (enable) {
+        scheduleA12Edge();
     }
-}
\ No newline at end of file
+}
+
+void PPU::scheduleA12Edge() {
+    nextA12Edge = NO_A12_EDGE;
+    if (a12EdgeDone || scanline >= 240 || !(mask.enable_background_rendering || mask.enable_sprite_rendering)) {
+        return;
+    }
+
+    // 8x16 sprites pick the table per tile; the dummy fetches for empty slots use tile $FF, i.e. $1000
+    int16_t edge = NO_A12_EDGE;
+    if (control.sprite_pattern || control.sprite_size) {
+        edge = 260;
+    } else if (control.background_pattern) {
+        edge = 324;
+    }
+
+    // An edge that has already gone by on this line is not replayed
+    if (edge != NO_A12_EDGE && cycle <= edge) {
+        nextA12Edge = edge;
+    }
+}
+
+// ---------------------------------------------------------------------------- //
+// -------------------------------- SAVE STATE -------------------------------- //
+// ---------------------------------------------------------------------------- //
+void PPU::saveState(StateWriter& state) const {
+    size_t chunk = state.beginChunk(stateTag("PPU "));
+    state.put(v.vram_register);
+    state.put(t.vram_register);
+    state.put(x);
+    state.put(w);
+    state.put(status.reg);
+    state.put(control.reg);
+    state.put(mask.reg);
+    state.put(OAMADDR);
+    state.put(PPUSCROLL);
+    state.put(PPUADDR);
+    state.put(PPUDATA);
+    state.put(OAMDMA);
+    state.put(OAM);
+    state.put(spriteScanline);
+    state.put(numOfSprites);
+    state.put(paletteMemory);
+    state.put(dataBuffer);
+    state.write(chrRam.data(), chrRam.size());
+    state.put(nameTables);
+
+    state.put(cycle);
+    state.put(scanline);
+    state.put(total_frames);
+    state.put(complete_frame);
+    state.put(nmi);
+    state.put(nextA12Edge);
+    state.put(a12EdgeDone);
+
+    state.put(next_bg_tile_id);
+    state.put(next_bg_tile_attribute);
+    state.put(next_bg_tile_lsb);
+    state.put(next_bg_tile_msb);
+    state.put(bg_shifter_tile_lo);
+    state.put(bg_shifter_tile_hi);
+    state.put(bg_shifter_attribute_lo);
+    state.put(bg_shifter_attribute_hi);
+    state.put(arr);
+    state.put(sprite_shifter_pattern_lo);
+    state.put(sprite_shifter_pattern_hi);
+    state.put(bSpriteZeroHitPossible);
+    state.put(bSpriteZeroBeingRendered);
+    state.endChunk(chunk);
+}
+
+bool PPU::loadState(StateReader& state) {
+    state.enterChunk(stateTag("PPU "));
+    state.get(v.vram_register);
+    state.get(t.vram_register);
+    state.get(x);
+    state.get(w);
+    state.get(status.reg);
+    state.get(control.reg);
+    state.get(mask.reg);
+    state.get(OAMADDR);
+    state.get(PPUSCROLL);
+    state.get(PPUADDR);
+    state.get(PPUDATA);
+    state.get(OAMDMA);
+    state.get(OAM);
+    state.get(spriteScanline);
+    state.get(numOfSprites);
+    state.get(paletteMemory);
+    state.get(dataBuffer);
+    state.read(chrRam.data(), chrRam.size());
+    state.get(nameTables);
+
+    state.get(cycle);
+    state.get(scanline);
+    state.get(total_frames);
+    state.get(complete_frame);
+    state.get(nmi);
+    state.get(nextA12Edge);
+    state.get(a12EdgeDone);
+
+    state.get(next_bg_tile_id);
+    state.get(next_bg_tile_attribute);
+    state.get(next_bg_tile_lsb);
+    state.get(next_bg_tile_msb);
+    state.get(bg_shifter_tile_lo);
+    state.get(bg_shifter_tile_hi);
+    state.get(bg_shifter_attribute_lo);
+    state.get(bg_shifter_attribute_hi);
+    state.get(arr);
+    state.get(sprite_shifter_pattern_lo);
+    state.get(sprite_shifter_pattern_hi);
+    state.get(bSpriteZeroHitPossible);
+    state.get(bSpriteZeroBeingRendered);
+    return state.leaveChunk();
+}
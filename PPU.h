@@ -2,10 +2,23 @@
 #define PPU_H
 
 #include <cstdint>  // For uint8_t and uint16_t
-#include <map>
 #include "ROM.h"
 #include <array>
 #include <cstring>
+#include <memory>
+
+class StateWriter;
+class StateReader;
+
+// How the 2 KB of VRAM appear as the four name tables. Four-screen boards bring their own extra
+// VRAM, which is not emulated; they run as vertical.
+enum class Mirroring : uint8_t {
+    HORIZONTAL,
+    VERTICAL,
+    SINGLE_LOWER,   // All four tables are the first 1 KB
+    SINGLE_UPPER,   // All four tables are the second 1 KB
+};
+
 class PPU {
 public:
     // Internal Registers
@@ -37,7 +50,7 @@ public:
             uint8_t vblank: 1;
         };
         uint8_t reg;
-    } status;
+    } status{};
 
     union PPUCTRL {
         struct {
@@ -50,7 +63,7 @@ public:
             uint8_t ppu_master: 1;
             uint8_t vblank_nmi_enable: 1;
         }; uint8_t reg;
-    } control;
+    } control{};
 
     union PPUMASK {
         struct {
@@ -64,7 +77,7 @@ public:
             uint8_t emphasize_blue: 1;
         };
         uint8_t reg;
-    } mask;
+    } mask{};
 
     //uint8_t PPUCTRL = 0x00;         // Controller
     //uint8_t PPUMASK = 0x00;         // Mask
@@ -82,8 +95,8 @@ public:
         uint8_t x;          // X position of a sprite
     } OAM[64]{};
 
-    ObjectAttributeMemory spriteScanline[8];
-    uint8_t numOfSprites;
+    ObjectAttributeMemory spriteScanline[8]{};
+    uint8_t numOfSprites = 0;
 
     uint8_t* OAMDATA = reinterpret_cast<uint8_t *>(OAM);
     uint8_t OAMDMA = 0x00;          // Sprite DMA
@@ -102,12 +115,19 @@ public:
     // Init ROM
     NESROM* ROM{};
 
+    PPU();
+
     // Pattern tables------------------------------------------------------------------------------------
-    std::array<uint8_t, 4096 * 4> patternTables; // two pattern tables of 256 tiles each (4096 / 16)
-    std::array<uint8_t, 4096 * 16> patternTablesDecoded; // two pattern tables of 256 tiles each (4096 / 16) with combined bits
+    // $0000-$1FFF is seen through eight 1 KB windows. They point straight into the cartridge's CHR ROM,
+    // or into chrRam on boards without one, so a mapper switches CHR banks with a pointer write.
+    const uint8_t* chrBanks[8];
+    bool chrWritable = true;    // Only CHR RAM takes writes
+    void mapCHR(int slot, const uint8_t* bank);
+
+    std::array<uint8_t, 4096 * 2> chrRam{}; // two pattern tables of 256 tiles each (4096 / 16)
 
     // Palette
-    uint8_t paletteMemory[32];
+    uint8_t paletteMemory[32]{};
 
     // Data buffer
     uint8_t dataBuffer = 0x00;
@@ -123,6 +143,9 @@ public:
     void printPaletteMemory();
 
     void decodePatternTable();
+    // Pattern tables with both bit planes combined into one byte per pixel, for the debug views.
+    // Allocated and decoded on first use; call decodePatternTable() again after CHR changes.
+    const uint8_t* decodedPatternTables();
 
     void printDecodedPatternTable();
 
@@ -134,33 +157,54 @@ public:
     // method to get a tile, returned as an 8-byte array of pixel info (0-3)
     void getTile(uint8_t tileIndex, uint8_t* tileData, bool table1);
 
-    void setPixel(uint8_t x, uint8_t y, uint32_t color);
+    void setPixel(uint8_t x, uint8_t y, uint8_t paletteIndex);
 
     void clock();
 
+    // When false, pixels are not composed or written to the framebuffer (turbo / run-ahead frame skipping).
+    // Everything the CPU can observe (vblank, sprite zero hit, sprite overflow, NMI) still happens.
+    bool renderPixels = true;
+
     int16_t cycle = 0;
     int16_t scanline = 0;
-    uint16_t total_frames = 1;
+    uint32_t total_frames = 1;      // Frames since power on, counting the current one
     bool complete_frame = false;
     bool nmi = false;
 
-    uint8_t framebuffer[256 * 240]{};  // 8-bit color indices
-    uint32_t rgbFramebuffer[256 * 240]{}; // 32-bit color for SDL
-    uint32_t nextFrame[256 * 240]{};
+    // Scanline counters (MMC3) count rising edges of PPU address line A12. With one pattern table
+    // at $0000 and the other at $1000 that is one edge per rendered line, at the first fetch from
+    // $1000: dot 260 when sprites use it (sprite fetches), dot 324 when the background does (next
+    // line's prefetch). Rather than test A12 on every fetch, the PPU works out at the start of each
+    // line (and again when PPUCTRL / PPUMASK change mid line) at which dot the edge falls; the bus
+    // compares `cycle` against nextA12Edge once per CPU cycle and clocks the mapper when it is reached.
+    static constexpr int16_t NO_A12_EDGE = 0x7FFF;
+    int16_t nextA12Edge = NO_A12_EDGE;
+    void watchA12(bool enable);
+    void a12EdgeTaken() { nextA12Edge = NO_A12_EDGE; a12EdgeDone = true; }
+
+    // The PPU outputs 6-bit palette indices, like the hardware. RGB is only produced when asked for.
+    uint8_t framebuffer[256 * 240]{};
+
+    // Convert the frame to 0xAABBGGRR pixels (red in the low byte, as uploaded to the UI texture)
+    void convertFrame(uint32_t* out) const;
+    // The converted frame in a buffer the PPU allocates on first use
+    const uint32_t* rgbFrame();
 
-    unsigned getColor(int);
+    static uint32_t getColor(int index);
+
+    // Bytes allocated on demand by decodedPatternTables() / rgbFrame() (for footprint reports)
+    size_t optionalBufferBytes() const;
 
     void printNameTable();
 
     // Name tables
-    std::array<uint8_t, 2048> nameTables;
+    std::array<uint8_t, 2048> nameTables{};
 
-    std::map<uint8_t, uint16_t> nameTableBaseAddresses = {
-        {0b00000000, 0x23C0},
-        {0b00000001, 0x27C0},
-        {0b00000010, 0x2BC0},
-        {0b00000011, 0x2FC0}
-    };
+    // Set by the cartridge: from the header at connectROM(), by mapper registers afterwards
+    void setMirroring(Mirroring mode);
+    Mirroring getMirroring() const { return mirroring; }
+
+    static constexpr uint16_t nameTableBaseAddresses[4] = {0x23C0, 0x27C0, 0x2BC0, 0x2FC0};
 
     // Background
     uint8_t next_bg_tile_id = 0x00;
@@ -176,8 +220,8 @@ public:
     uint8_t arr[16] = {0};
 
     // Foreground
-    uint8_t sprite_shifter_pattern_lo[8];
-    uint8_t sprite_shifter_pattern_hi[8];
+    uint8_t sprite_shifter_pattern_lo[8]{};
+    uint8_t sprite_shifter_pattern_hi[8]{};
 
     bool bSpriteZeroHitPossible = false;
     bool bSpriteZeroBeingRendered = false;
@@ -189,6 +233,22 @@ public:
     uint16_t getAttributeTableAddress();
 
     void reset();
+
+    // Save state. CHR RAM is included because writePPU() can change it; the bank windows are the
+    // mapper's business (it restores its registers and remaps), the decoded tables and the framebuffers are derived output and are left out.
+    void saveState(StateWriter& state) const;
+    bool loadState(StateReader& state);
+
+private:
+    bool a12Watched = false;
+    bool a12EdgeDone = false;     // This line's edge has reached the mapper
+    void scheduleA12Edge();
+
+    Mirroring mirroring = Mirroring::HORIZONTAL;
+    uint16_t nameTableOffset[4]{};
+
+    std::unique_ptr<uint8_t[]> patternTablesDecoded;
+    std::unique_ptr<uint32_t[]> rgbFramebuffer;
 };
 
 #endif // PPU_H
@@ -0,0 +1,59 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <cstdint>
+
+// What the game made the machine do, counted by the Bus as it happens.
+//
+// The counters are always on: each is one increment on a path that already does far more work.
+// Bus::perf collects the frame in progress; NES::run_frame moves it into NES::frameCounters at
+// every frame boundary (the start of the pre-render line) and adds it to NES::totalCounters. The
+// numbers depend on nothing but the game and its input, so they fingerprint a workload: two runs of
+// the same ROM and movie give the same counters, and a core change that alters them alters timing
+// the game can see.
+struct PerfCounters {
+    static constexpr int SCANLINES = 262;
+
+    uint64_t cpuCycles = 0;         // Including the ones the CPU sat out for OAM DMA
+    uint64_t instructions = 0;
+    uint64_t dmaTransfers = 0;      // $4014 writes
+    uint64_t dmaStallCycles = 0;    // CPU cycles spent waiting for OAM DMA
+    uint64_t nmis = 0;
+    uint64_t irqs = 0;              // Cartridge IRQs the CPU took
+    uint64_t bankSwitches = 0;      // PRG (8 KB) and CHR (1 KB) windows a mapper moved to another bank
+    uint64_t ppuWrites = 0;         // $2000-$3FFF writes
+    uint64_t statusPolls = 0;       // $2002 reads
+    // PPU register writes by scanline, the pre-render line first. During rendering, writes on the
+    // visible lines are raster effects (split scrolling, mid-frame bank or palette changes).
+    uint32_t ppuWritesByScanline[SCANLINES]{};
+
+    void clear() { *this = PerfCounters(); }
+
+    PerfCounters& operator+=(const PerfCounters& other) {
+        cpuCycles += other.cpuCycles;
+        instructions += other.instructions;
+        dmaTransfers += other.dmaTransfers;
+        dmaStallCycles += other.dmaStallCycles;
+        nmis += other.nmis;
+        irqs += other.irqs;
+        bankSwitches += other.bankSwitches;
+        ppuWrites += other.ppuWrites;
+        statusPolls += other.statusPolls;
+        for (int line = 0; line < SCANLINES; line++) {
+            ppuWritesByScanline[line] += other.ppuWritesByScanline[line];
+        }
+        return *this;
+    }
+
+    // Visible scanlines (0-239) with at least one PPU register write: raster effects while
+    // rendering, or VRAM updates with rendering off
+    int scanlinesWithWrites() const {
+        int lines = 0;
+        for (int line = 1; line <= 240; line++) {
+            lines += ppuWritesByScanline[line] != 0;
+        }
+        return lines;
+    }
+};
+
+#endif // PERF_COUNTERS_H
@@ -1,92 +1,161 @@
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 #include <cstdint>
+#include <cstring>
+#include <filesystem>
 #include "ROM.h"
+#include "Log.h"
+#include "Mapper.h"
+#include "SaveState.h"
 
     
-// determine the type of mapper
-void NESROM::detect_mapper(const NESHeader& header, std::ifstream &file) {
-    if (isValidHeader(header)) {
-    	switch (header.flags6) {
-    	case 00:					// Mapper 0 (NROM)
-    	case 01: {
-    		// Calculate sizes based on the header
-       		size_t prgRomSize = header.prgRomSize * 16 * 1024;		// 2 = NROM-256, mapped into $8000-$FFFF
-       																// 1 = NROM-128, mapped into $8000-$BFFF AND $C000-$FFFF
-        	size_t chrRomSize = header.chrRomSize * 8 * 1024;
+// NES 2.0 sizes: a 12 bit unit count, or 2^E * (M*2+1) bytes when the high nibble is 0xF
+static size_t nes2RomSize(uint8_t lsb, uint8_t msbNibble, size_t unit) {
+    if (msbNibble == 0x0F) {
+        return (size_t(1) << (lsb >> 2)) * ((lsb & 0x03) * 2 + 1);
+    }
+    return ((size_t(msbNibble) << 8) | lsb) * unit;
+}
 
-        	if (header.prgRomSize == 1) mirrored = true;			// let the calling program know to mirror the memory
+// NES 2.0 RAM sizes: 64 << shift bytes, 0 means none
+static size_t nes2RamSize(uint8_t shift) {
+    return shift == 0 ? 0 : size_t(64) << shift;
+}
 
-        	// Dynamically allocate memory for PRG ROM and CHR ROM
-        	prgRom = new uint8_t[prgRomSize];
-        	file.read(reinterpret_cast<char*>(prgRom), prgRomSize);
+bool parseCartridgeInfo(const NESHeader& header, CartridgeInfo& info) {
+    info = CartridgeInfo{};
+    if (header.header[0] != 'N' || header.header[1] != 'E' || header.header[2] != 'S' || header.header[3] != 0x1A) {
+        return false;
+    }
 
+    info.nes2 = (header.flags7 & 0x0C) == 0x08;
+    info.battery = (header.flags6 & 0x02) != 0;
+    info.trainer = (header.flags6 & 0x04) != 0;
+    info.verticalMirroring = (header.flags6 & 0x01) != 0;
+    info.fourScreen = (header.flags6 & 0x08) != 0;
+    info.dataOffset = NES_HEADER_SIZE + (info.trainer ? 512 : 0);
+
+    if (info.nes2) {
+        info.mapper = (header.flags6 >> 4) | (header.flags7 & 0xF0) | ((header.prgRamSize & 0x0F) << 8);
+        info.submapper = header.prgRamSize >> 4;
+        info.prgRomBytes = nes2RomSize(header.prgRomSize, header.flags9 & 0x0F, 16 * 1024);
+        info.chrRomBytes = nes2RomSize(header.chrRomSize, header.flags9 >> 4, 8 * 1024);
+        info.prgRamBytes = nes2RamSize(header.flags10 & 0x0F) + nes2RamSize(header.flags10 >> 4);
+        info.chrRamBytes = nes2RamSize(header.padding[0] & 0x0F) + nes2RamSize(header.padding[0] >> 4);
+        return true;
+    }
 
-        	chrRom = new uint8_t[chrRomSize];
-            file.read(reinterpret_cast<char*>(chrRom), chrRomSize);
+    // Old dumps carry "DiskDude!" or similar junk in bytes 7-15; their flags7 is garbage too
+    bool junkTail = header.padding[1] != 0 || header.padding[2] != 0 || header.padding[3] != 0 || header.padding[4] != 0;
+    uint8_t flags7 = junkTail ? 0 : header.flags7;
 
-            break;
-        }
+    info.mapper = (header.flags6 >> 4) | (flags7 & 0xF0);
+    info.prgRomBytes = header.prgRomSize * 16 * 1024;
+    info.chrRomBytes = header.chrRomSize * 8 * 1024;
+    info.prgRamBytes = junkTail || header.prgRamSize == 0 ? 8 * 1024 : header.prgRamSize * 8 * 1024;
+    info.chrRamBytes = info.chrRomBytes == 0 ? 8 * 1024 : 0;
+    return true;
+}
 
-        case 20:					// Mapper 2 (UNROM)
-        case 21: {
-         	// UNROM specific stuff goes here (requires bank switching)
-        	break;
-        }
+// Nothing is mapped until a ROM is loaded; reads see this instead of a null pointer
+static const uint8_t unmappedPRG[0x2000] = {};
 
-        // more mapper cases to follow
-        }
+NESROM::NESROM() {
+    for (const uint8_t*& bank : prgBanks) {
+        bank = unmappedPRG;
     }
 }
 
+NESROM::~NESROM() = default;
+
 // function to load ROM
 bool NESROM::load(const std::string& filepath) {
-    std::ifstream file(filepath, std::ios::binary);
-    if (!file.is_open()) {
-        std::cerr << "Failed to open file: " << filepath << std::endl;
+    MappedFile file;
+    if (!file.open(filepath)) {
         return false;
     }
 
     // Read the header
     NESHeader header{};
-    file.read(reinterpret_cast<char*>(&header), NES_HEADER_SIZE);
-    if (!isValidHeader(header)) {
+    if (file.size() >= NES_HEADER_SIZE) {
+        std::memcpy(&header, file.data(), NES_HEADER_SIZE);
+    }
+    CartridgeInfo parsed;
+    if (!parseCartridgeInfo(header, parsed)) {
         std::cerr << "Invalid NES file: " << filepath << std::endl;
         return false;
     }
+    size_t expected = parsed.fileSize();
+    if (parsed.prgRomBytes == 0 || file.size() < expected) {
+        std::cerr << "Truncated NES file (" << file.size() << " of " << expected << " bytes): " << filepath << std::endl;
+        return false;
+    }
+    std::unique_ptr<Mapper> board = Mapper::create(parsed.mapper, *this);
+    if (!board) {
+        std::cerr << "Unsupported mapper " << parsed.mapper << ": " << filepath << std::endl;
+        return false;
+    }
+
+    // Work RAM at $6000. An iNES header cannot say a board has none, so those all get 8 KB.
+    SaveRAM ram;
+    if (parsed.battery && useSaveFiles) {
+        std::filesystem::path save(filepath);
+        save.replace_extension(".sav");
+        if (!ram.open(save.string(), parsed.prgRamBytes)) {
+            std::cerr << "Battery RAM will not be saved for: " << filepath << std::endl;
+            ram.allocate(parsed.prgRamBytes);
+        }
+    } else {
+        ram.allocate(parsed.prgRamBytes);
+    }
+
+    // Drop the previous cartridge when a ROM is loaded into the same object again; its battery
+    // RAM is flushed as the swapped out mapping goes away
     ROMheader = header;
+    info = parsed;
+    image.swap(file);
+    prgRam.swap(ram);
+    prgRamMask = static_cast<uint16_t>(prgRam.size() == 0 ? 0 : std::min<size_t>(prgRam.size(), 0x2000) - 1);
+    mapper = std::move(board);
+
+    // PRG and CHR ROM are used where they sit in the file image, nothing is copied.
+    // No CHR ROM means the board carries CHR RAM, which the PPU provides.
+    prgRom = image.data() + info.dataOffset;
+    chrRom = info.chrRomBytes > 0 ? prgRom + info.prgRomBytes : nullptr;
 
-	detect_mapper(header, file);
+    // PRG windows now; CHR and mirroring once the bus hands the mapper the PPU
+    mapper->attach(nullptr);
 
-    // Close the file
-    file.close();
-    std::cout << "Successfully loaded NES ROM: " << filepath << std::endl;
+    NES_LOG_INFO("Loaded %s (%s)", filepath.c_str(), mapper->name());
     return true;
 }
 
-uint8_t NESROM::readMemoryPRG(const uint16_t address) {
-    if (ROMheader.prgRomSize == 0 || prgRom == nullptr)
-        return 0;
-
-    uint16_t mappedAddress = 0;
-
-    if (mirrored) {
-        // NROM-128 (16KB mirrored at both $8000–$BFFF and $C000–$FFFF)
-        mappedAddress = address & 0x3FFF;  // mask to 16KB range
-    } else {
-        // NROM-256 (32KB)
-        mappedAddress = address - 0x8000;
+void NESROM::writeMemoryPRG(uint16_t address, uint8_t data) {
+    if (mapper) {
+        mapper->writeRegister(address, data);
     }
+}
 
-    if (mappedAddress < (ROMheader.prgRomSize * 16 * 1024)) {
-        return prgRom[mappedAddress];
-    } else {
-        std::cerr << "Invalid PRG ROM read at address: 0x" << std::hex << address << std::dec << "\n";
-        return 0;
+bool NESROM::readTestStatus(uint8_t& status, std::string& message) const {
+    if (prgRamMask < 0x0004) {
+        return false;
+    }
+    const uint8_t* ram = prgRam.data();
+    if (ram[1] != 0xDE || ram[2] != 0xB0 || ram[3] != 0x61) {
+        return false;
+    }
+    status = ram[0];
+    message.clear();
+    for (size_t i = 4; i <= prgRamMask && ram[i] != 0; i++) {
+        message.push_back(static_cast<char>(ram[i]));
     }
+    return true;
 }
 
 uint8_t NESROM::readMemoryCHR(uint16_t address) {
+    if (chrRom == nullptr)
+        return 0;
     return chrRom[address];
 }
 
@@ -104,4 +173,34 @@ void NESROM::printHeaderInfo(const NESHeader& header) {
     std::cout << "  CHR ROM Size: " << static_cast<int>(header.chrRomSize) << " x 8KB" << std::endl;
     std::cout << "  Flags6: " << std::hex << static_cast<int>(header.flags6) << std::dec << std::endl;
     std::cout << "  Flags7: " << std::hex << static_cast<int>(header.flags7) << std::dec << std::endl;
+    CartridgeInfo decoded;
+    if (parseCartridgeInfo(header, decoded)) {
+        std::cout << "  Format: " << (decoded.nes2 ? "NES 2.0" : "iNES") << ", mapper " << decoded.mapper;
+        if (decoded.nes2) {
+            std::cout << "." << static_cast<int>(decoded.submapper);
+        }
+        std::cout << std::endl;
+    }
+}
+
+void NESROM::saveState(StateWriter& state) const {
+    size_t chunk = state.beginChunk(stateTag("CART"));
+    if (prgRam.size() > 0) {
+        state.write(prgRam.data(), prgRam.size());
+    }
+    if (mapper) {
+        mapper->saveState(state);
+    }
+    state.endChunk(chunk);
+}
+
+bool NESROM::loadState(StateReader& state) {
+    state.enterChunk(stateTag("CART"));
+    if (prgRam.size() > 0 && state.read(prgRam.data(), prgRam.size())) {
+        prgRam.markDirty();
+    }
+    if (mapper) {
+        mapper->loadState(state);
+    }
+    return state.leaveChunk();
 }
@@ -4,7 +4,14 @@
 #include <iostream>
 #include <fstream>
 #include <cstdint>
+#include <memory>
 #include <string>
+#include "MappedFile.h"
+#include "SaveRAM.h"
+
+class Mapper;
+class StateWriter;
+class StateReader;
 
 // NES ROM header size
 const size_t NES_HEADER_SIZE = 16;
@@ -22,21 +29,77 @@ struct NESHeader {
     uint8_t padding[5];    // Padding, should be zero
 };
 
+// What the header says about the board, decoded from either iNES or NES 2.0 layout
+struct CartridgeInfo {
+    bool nes2 = false;            // NES 2.0 header (flags7 bits 2-3 == 2)
+    uint16_t mapper = 0;          // flags6 high nibble | flags7 high nibble (| byte 8 low nibble on NES 2.0)
+    uint8_t submapper = 0;        // NES 2.0 only
+    size_t prgRomBytes = 0;
+    size_t chrRomBytes = 0;       // 0: the board has CHR RAM
+    size_t prgRamBytes = 0;       // Volatile + battery backed
+    size_t chrRamBytes = 0;
+    bool battery = false;
+    bool trainer = false;         // 512 byte trainer between header and PRG ROM
+    bool verticalMirroring = false;
+    bool fourScreen = false;
+    size_t dataOffset = 0;        // File offset of PRG ROM
+
+    // Header plus everything the header says follows it
+    size_t fileSize() const { return dataOffset + prgRomBytes + chrRomBytes; }
+};
+
+// Fills `info` from a header. Returns false if the magic is wrong.
+bool parseCartridgeInfo(const NESHeader& header, CartridgeInfo& info);
+
 class NESROM {
 public:
-    uint8_t* prgRom;          // Pointer to PRG ROM data
-    uint8_t* chrRom;          // Pointer to CHR ROM data
+    NESROM();
+    ~NESROM();
+
+    const uint8_t* prgRom = nullptr;  // PRG ROM, inside the file image
+    const uint8_t* chrRom = nullptr;  // CHR ROM, inside the file image (nullptr: the board has CHR RAM)
     NESHeader ROMheader;
-    bool mirrored = false;    // Flag for NROM-128 mirroring
+    CartridgeInfo info;       // Decoded ROMheader
+
+    // What the CPU sees at $8000-$FFFF, four 8 KB windows into prgRom. Only the mapper moves them.
+    const uint8_t* prgBanks[4]{};
+    std::unique_ptr<Mapper> mapper;
 
-    // Function to detect and initialize the mapper based on header and file data
-    void detect_mapper(const NESHeader& header, std::ifstream& file);
+    // Battery backed PRG RAM persists in a .sav file next to the ROM. Batch runs turn this off so
+    // they neither depend on nor change what a player has saved.
+    bool useSaveFiles = true;
 
     // Function to load the ROM from a file
     bool load(const std::string& filepath);
 
-    // Function to read PRG memory
-    uint8_t readMemoryPRG(const uint16_t address);
+    // Function to read PRG memory ($8000-$FFFF)
+    uint8_t readMemoryPRG(uint16_t address) const {
+        return prgBanks[(address >> 13) & 0x03][address & 0x1FFF];
+    }
+
+    // Function to write PRG memory ($8000-$FFFF): ROM is read-only, the write goes to the mapper
+    void writeMemoryPRG(uint16_t address, uint8_t data);
+
+    // Function to read PRG RAM ($6000-$7FFF); boards without any read back 0
+    uint8_t readMemoryPRGRAM(uint16_t address) const {
+        return prgRamMask ? prgRam.data()[address & prgRamMask] : 0;
+    }
+
+    void writeMemoryPRGRAM(uint16_t address, uint8_t data) {
+        if (prgRamMask) {
+            prgRam.data()[address & prgRamMask] = data;
+            prgRam.markDirty();
+        }
+    }
+
+    // Pushes battery RAM changes to the save file; cheap when nothing was written
+    bool flushSaveRAM() { return prgRam.flush(); }
+    bool hasSaveFile() const { return prgRam.isPersistent(); }
+
+    // blargg's test ROM protocol: $6001-$6003 hold DE B0 61 once the test has started, $6000 is
+    // 0x80 while it runs, 0x81 when it wants a reset and the result code after that, with a
+    // NUL terminated message from $6004. Returns false if the signature is not there.
+    bool readTestStatus(uint8_t& status, std::string& message) const;
 
     // Function to read CHR memory
     uint8_t readMemoryCHR(uint16_t address);
@@ -47,7 +110,20 @@ public:
     // Function to print ROM header information
     void printHeaderInfo(const NESHeader& header);
 
+    // True when the image is a shared read-only mapping of the file rather than a private copy
+    bool isMapped() const { return image.isMapped(); }
+    // Work RAM: heap per instance, or a shared writable mapping of the .sav file
+    size_t prgRamBytes() const { return prgRam.size(); }
+    bool isPrgRamMapped() const { return prgRam.isMapped(); }
+
+    // Save state for the cartridge side: PRG RAM and the mapper's registers; the bank windows are rebuilt on load
+    void saveState(StateWriter& state) const;
+    bool loadState(StateReader& state);
 
+private:
+    MappedFile image;   // The whole .nes file; PRG and CHR are used in place
+    SaveRAM prgRam;     // $6000-$7FFF work RAM, mapped from the .sav file when battery backed
+    uint16_t prgRamMask = 0;    // Window size - 1 (only the first 8 KB of larger RAM is mapped), 0: none
 };
 
 #endif // NESROM_H
\ No newline at end of file
@@ -0,0 +1,219 @@
+#include "Resampler.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define RESAMPLER_X86 1
+#include <immintrin.h>
+#endif
+
+// Largest number of input samples copied into the history buffer at once
+static const int MAX_BLOCK = 4096;
+static const double PI = 3.14159265358979323846;
+
+// ---------------------------------------------------------------------------- //
+// ------------------------------- DOT PRODUCTS ------------------------------- //
+// ---------------------------------------------------------------------------- //
+
+// All kernels are padded to a multiple of 8 taps, so no path needs a scalar tail
+static float dotScalar(const float* a, const float* b, int n) {
+    float s0 = 0.0f, s1 = 0.0f, s2 = 0.0f, s3 = 0.0f;
+    for (int i = 0; i < n; i += 4) {
+        s0 += a[i] * b[i];
+        s1 += a[i + 1] * b[i + 1];
+        s2 += a[i + 2] * b[i + 2];
+        s3 += a[i + 3] * b[i + 3];
+    }
+    return (s0 + s1) + (s2 + s3);
+}
+
+#ifdef RESAMPLER_X86
+__attribute__((target("sse2")))
+static float dotSSE2(const float* a, const float* b, int n) {
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    for (int i = 0; i < n; i += 8) {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+    }
+    __m128 sum = _mm_add_ps(acc0, acc1);
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 0x55));
+    return _mm_cvtss_f32(sum);
+}
+
+__attribute__((target("avx2,fma")))
+static float dotAVX2(const float* a, const float* b, int n) {
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), acc1);
+    }
+    if (i < n) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+    }
+    __m256 sum256 = _mm256_add_ps(acc0, acc1);
+    __m128 sum = _mm_add_ps(_mm256_castps256_ps128(sum256), _mm256_extractf128_ps(sum256, 1));
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 0x55));
+    return _mm_cvtss_f32(sum);
+}
+#endif
+
+// ---------------------------------------------------------------------------- //
+// ------------------------------ FILTER DESIGN ------------------------------- //
+// ---------------------------------------------------------------------------- //
+
+// Zeroth order modified Bessel function of the first kind, used by the Kaiser window
+static double besselI0(double x) {
+    double sum = 1.0;
+    double term = 1.0;
+    for (int k = 1; k < 50; k++) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+        if (term < sum * 1e-12) break;
+    }
+    return sum;
+}
+
+Resampler::Resampler(double inputRate, double outputRate, Quality quality) {
+    isa = bestIsa();
+    configure(inputRate, outputRate, quality);
+}
+
+void Resampler::configure(double inputRate, double outputRate, Quality quality) {
+    static const int ZERO_CROSSINGS[3] = {4, 8, 16};
+    static const int PHASES[3] = {8, 16, 32};
+    static const double BETA[3] = {6.0, 8.0, 10.0};
+
+    this->inputRate = inputRate;
+    this->outputRate = outputRate;
+    this->quality = quality;
+
+    // Cutoff just under the output Nyquist frequency, normalized to the input rate
+    double cutoff = 0.45 * outputRate / inputRate;
+    double zeroSpacing = 0.5 / cutoff;  // input samples between sinc zero crossings
+
+    taps = static_cast<int>(std::ceil(2.0 * ZERO_CROSSINGS[quality] * zeroSpacing));
+    taps = (taps + 7) & ~7;
+    phases = PHASES[quality];
+
+    kernel.assign(static_cast<size_t>(phases) * taps, 0.0f);
+    double half = taps / 2.0;
+    double beta = BETA[quality];
+    double i0Beta = besselI0(beta);
+
+    for (int p = 0; p < phases; p++) {
+        double frac = static_cast<double>(p) / phases;
+        double sum = 0.0;
+        std::vector<double> row(taps);
+        for (int k = 0; k < taps; k++) {
+            // Distance (in input samples) from the output instant, which lags the newest input by half the kernel
+            double u = k - (taps - 1) - frac + half;
+            double x = u / half;
+            double window = (x <= -1.0 || x >= 1.0) ? 0.0 : besselI0(beta * std::sqrt(1.0 - x * x)) / i0Beta;
+            double arg = 2.0 * cutoff * u;
+            double sinc = (arg == 0.0) ? 1.0 : std::sin(PI * arg) / (PI * arg);
+            row[k] = sinc * window;
+            sum += row[k];
+        }
+        // Unity gain at DC for every phase
+        for (int k = 0; k < taps; k++) {
+            kernel[static_cast<size_t>(p) * taps + k] = static_cast<float>(row[k] / sum);
+        }
+    }
+
+    step = static_cast<uint64_t>(std::llround(inputRate / outputRate * 4294967296.0));
+    history.assign(static_cast<size_t>(taps - 1 + MAX_BLOCK), 0.0f);
+    setIsa(isa);
+    reset();
+}
+
+void Resampler::reset() {
+    std::fill(history.begin(), history.end(), 0.0f);
+    filled = taps - 1;
+    position = static_cast<uint64_t>(taps - 1) << 32;
+}
+
+int Resampler::maxOutputFor(int count) const {
+    return static_cast<int>(count * outputRate / inputRate) + 2;
+}
+
+// ---------------------------------------------------------------------------- //
+// -------------------------------- PROCESSING -------------------------------- //
+// ---------------------------------------------------------------------------- //
+
+int Resampler::process(const float* in, int count, float* out, int maxOut) {
+    int produced = 0;
+    const float* coefficients = kernel.data();
+
+    while (count > 0) {
+        int chunk = std::min(count, MAX_BLOCK);
+        std::memcpy(history.data() + filled, in, chunk * sizeof(float));
+        filled += chunk;
+        in += chunk;
+        count -= chunk;
+
+        // Emit every output whose newest input sample is already in the buffer
+        while (static_cast<int>(position >> 32) < filled) {
+            int newest = static_cast<int>(position >> 32);
+            uint32_t frac = static_cast<uint32_t>(position);
+            int phase = static_cast<int>((static_cast<uint64_t>(frac) * phases) >> 32);
+            float sample = dot(history.data() + newest - (taps - 1), coefficients + phase * taps, taps);
+            if (produced < maxOut) {
+                out[produced++] = sample;
+            }
+            position += step;
+        }
+
+        // Keep only the samples the next outputs still reach back to
+        int discard = filled - (taps - 1);
+        std::memmove(history.data(), history.data() + discard, (taps - 1) * sizeof(float));
+        filled = taps - 1;
+        position -= static_cast<uint64_t>(discard) << 32;
+    }
+    return produced;
+}
+
+// ---------------------------------------------------------------------------- //
+// ------------------------------- ISA SELECTION ------------------------------ //
+// ---------------------------------------------------------------------------- //
+
+Resampler::Isa Resampler::bestIsa() {
+#ifdef RESAMPLER_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return AVX2;
+    if (__builtin_cpu_supports("sse2")) return SSE2;
+#endif
+    return SCALAR;
+}
+
+void Resampler::setIsa(Isa requested) {
+    isa = std::min(requested, bestIsa());
+    switch (isa) {
+#ifdef RESAMPLER_X86
+        case AVX2: dot = &dotAVX2; break;
+        case SSE2: dot = &dotSSE2; break;
+#endif
+        default: isa = SCALAR; dot = &dotScalar; break;
+    }
+}
+
+const char* Resampler::isaName(Isa isa) {
+    switch (isa) {
+        case AVX2: return "AVX2";
+        case SSE2: return "SSE2";
+        default: return "scalar";
+    }
+}
+
+const char* Resampler::qualityName(Quality quality) {
+    switch (quality) {
+        case LOW: return "low";
+        case HIGH: return "high";
+        default: return "medium";
+    }
+}
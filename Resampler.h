@@ -0,0 +1,82 @@
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Polyphase FIR decimator used to bring the APU output (one sample per CPU cycle,
+// ~1.79 MHz) down to the audio device rate (44.1 / 48 kHz).
+//
+// The filter is a Kaiser windowed sinc with its cutoff just below the output Nyquist
+// frequency. Because the output rate is not an integer divisor of the input rate, the
+// kernel is pre-computed for a number of fractional phases; each output sample picks
+// the phase closest to its fractional input position and runs one dot product.
+class Resampler {
+public:
+    // Quality presets trade filter length (stop band attenuation / transition width)
+    // and phase resolution against CPU time
+    enum Quality {
+        LOW = 0,        // 4 zero crossings per side, 8 phases
+        MEDIUM = 1,     // 8 zero crossings per side, 16 phases
+        HIGH = 2        // 16 zero crossings per side, 32 phases
+    };
+
+    // Dot product implementation, picked at runtime from what the host supports
+    enum Isa {
+        SCALAR = 0,
+        SSE2 = 1,
+        AVX2 = 2
+    };
+
+    Resampler(double inputRate = 1789773.0, double outputRate = 44100.0, Quality quality = MEDIUM);
+
+    // Rebuild the filter tables for a new rate pair or quality, clears history
+    void configure(double inputRate, double outputRate, Quality quality);
+
+    // Clear the sample history without touching the filter
+    void reset();
+
+    // Consume `count` input samples and write up to `maxOut` output samples to `out`.
+    // Returns the number of output samples produced. Output that does not fit is dropped.
+    int process(const float* in, int count, float* out, int maxOut);
+
+    // Upper bound of output samples produced by `count` input samples
+    int maxOutputFor(int count) const;
+
+    // Force a dot product implementation (clamped to what the host supports)
+    void setIsa(Isa isa);
+    Isa getIsa() const { return isa; }
+    static Isa bestIsa();
+    static const char* isaName(Isa isa);
+
+    Quality getQuality() const { return quality; }
+    static const char* qualityName(Quality quality);
+    int getTaps() const { return taps; }
+    int getPhases() const { return phases; }
+
+    // Heap bytes held by the filter tables and history
+    size_t memoryBytes() const { return (kernel.capacity() + history.capacity()) * sizeof(float); }
+
+private:
+    double inputRate = 1789773.0;
+    double outputRate = 44100.0;
+    Quality quality = MEDIUM;
+    Isa isa = SCALAR;
+
+    int taps = 0;               // Kernel length, multiple of 8 so every ISA path runs without tails
+    int phases = 0;             // Number of fractional positions the kernel is sampled at
+    std::vector<float> kernel;  // phases * taps coefficients, one row per phase
+
+    // Input history: the last (taps - 1) samples followed by the block being processed
+    std::vector<float> history;
+    int filled = 0;
+
+    // 32.32 fixed point position of the newest input sample used by the next output
+    uint64_t position = 0;
+    uint64_t step = 0;
+
+    float (*dot)(const float*, const float*, int) = nullptr;
+};
+
+#endif // RESAMPLER_H
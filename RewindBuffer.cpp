@@ -0,0 +1,149 @@
+#include "RewindBuffer.h"
+#include <cstring>
+
+// A literal run ends once this many unchanged bytes follow it, shorter gaps are cheaper to copy
+static const size_t MIN_ZERO_RUN = 4;
+
+static uint8_t* writeVarint(uint8_t* out, size_t value) {
+    while (value >= 0x80) {
+        *out++ = static_cast<uint8_t>(value | 0x80);
+        value >>= 7;
+    }
+    *out++ = static_cast<uint8_t>(value);
+    return out;
+}
+
+static const uint8_t* readVarint(const uint8_t* in, const uint8_t* end, size_t& value) {
+    value = 0;
+    for (int shift = 0; in < end && shift < 64; shift += 7) {
+        uint8_t byte = *in++;
+        value |= static_cast<size_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) break;
+    }
+    return in;
+}
+
+RewindBuffer::RewindBuffer(size_t capacityBytes, size_t maxStates) : ring(capacityBytes), maxStates(maxStates) {
+}
+
+void RewindBuffer::clear() {
+    entries.clear();
+    used = 0;
+    writeOffset = 0;
+    head.clear();
+}
+
+void RewindBuffer::dropOldest() {
+    used -= entries.front().length;
+    entries.pop_front();
+}
+
+void RewindBuffer::push(const std::vector<uint8_t>& state) {
+    if (head.size() != state.size()) {
+        clear();
+        head = state;
+        return;
+    }
+
+    // Worst case every segment is one literal byte between two short zero runs
+    scratch.resize(2 * state.size() + 16);
+    size_t length = encode(state.data(), head.data(), state.size(), scratch.data());
+    head = state;
+    if (length > ring.size()) {
+        // Too different to keep, start the history over from this state
+        entries.clear();
+        used = 0;
+        writeOffset = 0;
+        return;
+    }
+
+    while (entries.size() + 1 >= maxStates && !entries.empty()) {
+        dropOldest();
+    }
+
+    // Entries are never split; when one does not fit before the end, the oldest ones parked
+    // behind the write position are dropped and writing continues at the start
+    if (writeOffset + length > ring.size()) {
+        while (!entries.empty() && entries.front().offset >= writeOffset) {
+            dropOldest();
+        }
+        writeOffset = 0;
+    }
+    while (!entries.empty() && entries.front().offset >= writeOffset && entries.front().offset < writeOffset + length) {
+        dropOldest();
+    }
+
+    std::memcpy(ring.data() + writeOffset, scratch.data(), length);
+    entries.push_back({writeOffset, length});
+    used += length;
+    writeOffset += length;
+}
+
+bool RewindBuffer::pop(std::vector<uint8_t>& state) {
+    if (entries.empty()) {
+        return false;
+    }
+    const Entry& newest = entries.back();
+    decode(ring.data() + newest.offset, newest.length, head.data(), head.size());
+    used -= newest.length;
+    writeOffset = newest.offset;
+    entries.pop_back();
+    state = head;
+    return true;
+}
+
+// XOR `a` against `b` into zero run / literal pairs, trailing zeros are implied
+size_t RewindBuffer::encode(const uint8_t* a, const uint8_t* b, size_t size, uint8_t* out) {
+    uint8_t* start = out;
+    size_t i = 0;
+    while (i < size) {
+        size_t runStart = i;
+        // Skip unchanged bytes a word at a time, then finish byte by byte
+        while (i + 8 <= size) {
+            uint64_t x, y;
+            std::memcpy(&x, a + i, 8);
+            std::memcpy(&y, b + i, 8);
+            if (x != y) break;
+            i += 8;
+        }
+        while (i < size && a[i] == b[i]) {
+            i++;
+        }
+        if (i == size) {
+            break;
+        }
+
+        size_t literalEnd = i;
+        for (size_t j = i; j < size && j - literalEnd < MIN_ZERO_RUN; j++) {
+            if (a[j] != b[j]) {
+                literalEnd = j + 1;
+            }
+        }
+
+        out = writeVarint(out, i - runStart);
+        out = writeVarint(out, literalEnd - i);
+        for (; i < literalEnd; i++) {
+            *out++ = a[i] ^ b[i];
+        }
+    }
+    return static_cast<size_t>(out - start);
+}
+
+void RewindBuffer::decode(const uint8_t* in, size_t length, uint8_t* state, size_t size) {
+    const uint8_t* end = in + length;
+    size_t position = 0;
+    while (in < end) {
+        size_t zeros, literal;
+        in = readVarint(in, end, zeros);
+        in = readVarint(in, end, literal);
+        position += zeros;
+        if (position > size || literal > size - position || literal > static_cast<size_t>(end - in)) {
+            return;
+        }
+        for (size_t k = 0; k < literal; k++) {
+            state[position + k] ^= in[k];
+        }
+        in += literal;
+        position += literal;
+    }
+}
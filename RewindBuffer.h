@@ -0,0 +1,62 @@
+#ifndef REWIND_BUFFER_H
+#define REWIND_BUFFER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+// History of save states for rewinding, kept in a fixed size byte ring.
+//
+// Only the newest state is stored whole (the head). Every older state k is stored as the XOR
+// delta d = S(k+1) ^ S(k) against the state after it. Consecutive frames differ in a few hundred
+// bytes, so a delta is almost all zeros and is run-length encoded as
+//   varint zero run | varint literal length | literal bytes     (repeated)
+// Rewinding applies the newest delta to the head in place, which walks the history backwards
+// without ever decoding more than one delta per frame.
+class RewindBuffer {
+public:
+    // `capacityBytes` bounds the compressed history, `maxStates` bounds its length
+    explicit RewindBuffer(size_t capacityBytes = 8 * 1024 * 1024, size_t maxStates = 60 * 60);
+
+    // Drop all history (new ROM, reset)
+    void clear();
+
+    // Record the state after the newest one. A state of a different size than the head clears the history.
+    void push(const std::vector<uint8_t>& state);
+
+    // Step back one state: the newest state is discarded and `state` receives the one before it,
+    // which becomes the newest. Returns false when there is nothing older to go back to.
+    bool pop(std::vector<uint8_t>& state);
+
+    // Number of states held, including the newest one
+    size_t size() const { return head.empty() ? 0 : entries.size() + 1; }
+    bool empty() const { return head.empty(); }
+
+    // Bytes held: compressed deltas plus the uncompressed head
+    size_t memoryUsed() const { return used + head.size(); }
+    // Bytes the same history would take as raw snapshots
+    size_t rawSize() const { return size() * head.size(); }
+    double compressionRatio() const { return memoryUsed() ? static_cast<double>(rawSize()) / memoryUsed() : 0.0; }
+
+private:
+    struct Entry {
+        size_t offset;
+        size_t length;
+    };
+
+    std::vector<uint8_t> ring;
+    size_t maxStates;
+    std::deque<Entry> entries;  // Oldest first, each one undoes the state after it
+    size_t used = 0;            // Bytes of `ring` covered by entries
+    size_t writeOffset = 0;
+
+    std::vector<uint8_t> head;
+    std::vector<uint8_t> scratch;
+
+    void dropOldest();
+    static size_t encode(const uint8_t* a, const uint8_t* b, size_t size, uint8_t* out);
+    static void decode(const uint8_t* in, size_t length, uint8_t* state, size_t size);
+};
+
+#endif // REWIND_BUFFER_H
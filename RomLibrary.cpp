@@ -0,0 +1,246 @@
+#include "RomLibrary.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+#include "Hash.h"
+#include "MappedFile.h"
+#include "SaveState.h"
+#include "ThreadPool.h"
+
+namespace fs = std::filesystem;
+
+// Cache file layout (host byte order, it never leaves the machine):
+//   "NLIB" | uint32 version | uint32 count | count x entry
+//   entry: uint32 length + path | uint64 size | int64 mtime | uint8 valid | CartridgeInfo | uint32 crc32 | 40 byte sha1
+// Bump the version whenever an entry field changes; an old cache is then ignored and rebuilt.
+static const uint32_t LIBRARY_CACHE_VERSION = 1;
+
+static bool hasNesExtension(const fs::path& path) {
+    std::string extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return extension == ".nes";
+}
+
+static int64_t modificationTime(const fs::directory_entry& file, std::error_code& error) {
+    auto time = file.last_write_time(error);
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+}
+
+bool RomLibrary::indexFile(const std::string& path, RomEntry& entry) {
+    entry.valid = false;
+    entry.crc32 = 0;
+    entry.sha1.clear();
+
+    MappedFile file;
+    if (!file.open(path)) {
+        return false;
+    }
+    entry.size = file.size();
+
+    NESHeader header{};
+    if (file.size() < NES_HEADER_SIZE) {
+        return false;
+    }
+    std::memcpy(&header, file.data(), NES_HEADER_SIZE);
+    if (!parseCartridgeInfo(header, entry.info) || file.size() < entry.info.fileSize()) {
+        return false;
+    }
+
+    const uint8_t* data = file.data() + entry.info.dataOffset;
+    size_t size = entry.info.prgRomBytes + entry.info.chrRomBytes;
+    entry.crc32 = crc32(data, size);
+    entry.sha1 = sha1Hex(data, size);
+    entry.valid = true;
+    return true;
+}
+
+bool RomLibrary::scan(const std::string& root, ThreadPool& pool, ScanStats* stats) {
+    ScanStats counts;
+
+    // Walk first, so the pool only ever sees files that need reading
+    std::unordered_map<std::string, const RomEntry*> cached;
+    for (const RomEntry& entry : roms) {
+        cached[entry.path] = &entry;
+    }
+
+    std::vector<RomEntry> found;
+    std::vector<size_t> stale;
+    std::error_code error;
+    fs::recursive_directory_iterator it(root, fs::directory_options::skip_permission_denied, error);
+    if (error) {
+        std::cerr << "Failed to scan ROM directory: " << root << " (" << error.message() << ")" << std::endl;
+        return false;
+    }
+    for (; it != fs::recursive_directory_iterator(); it.increment(error)) {
+        if (error) {
+            break;
+        }
+        const fs::directory_entry& file = *it;
+        std::error_code fileError;
+        if (!file.is_regular_file(fileError) || !hasNesExtension(file.path())) {
+            continue;
+        }
+
+        RomEntry entry;
+        entry.path = file.path().string();
+        entry.size = file.file_size(fileError);
+        entry.mtime = modificationTime(file, fileError);
+        if (fileError) {
+            continue;
+        }
+
+        auto hit = cached.find(entry.path);
+        if (hit != cached.end() && hit->second->size == entry.size && hit->second->mtime == entry.mtime) {
+            found.push_back(*hit->second);
+            counts.reused++;
+        } else {
+            stale.push_back(found.size());
+            found.push_back(entry);
+        }
+    }
+
+    // Each task fills its own slot, nothing else is shared
+    for (size_t index : stale) {
+        pool.submit([&found, index](int) {
+            RomEntry& entry = found[index];
+            uint64_t size = entry.size;
+            int64_t mtime = entry.mtime;
+            indexFile(entry.path, entry);
+            // Keep what the walk saw; if the file changes while it is read the next scan catches it
+            entry.size = size;
+            entry.mtime = mtime;
+        });
+    }
+    pool.wait();
+    counts.hashed = stale.size();
+
+    std::sort(found.begin(), found.end(), [](const RomEntry& a, const RomEntry& b) { return a.path < b.path; });
+    for (const RomEntry& entry : found) {
+        counts.invalid += entry.valid ? 0 : 1;
+    }
+    counts.files = found.size();
+    roms.swap(found);
+
+    if (stats != nullptr) {
+        *stats = counts;
+    }
+    return true;
+}
+
+bool RomLibrary::saveCache(const std::string& path) const {
+    std::vector<uint8_t> blob;
+    StateWriter out(blob);
+    out.put(stateTag("NLIB"));
+    out.put(LIBRARY_CACHE_VERSION);
+    out.put(static_cast<uint32_t>(roms.size()));
+    for (const RomEntry& entry : roms) {
+        out.put(static_cast<uint32_t>(entry.path.size()));
+        out.write(entry.path.data(), entry.path.size());
+        out.put(entry.size);
+        out.put(entry.mtime);
+        out.put(static_cast<uint8_t>(entry.valid));
+        out.put(entry.info);
+        out.put(entry.crc32);
+        char sha1[40] = {};
+        std::memcpy(sha1, entry.sha1.data(), std::min(entry.sha1.size(), sizeof(sha1)));
+        out.write(sha1, sizeof(sha1));
+    }
+
+    // Write next to the old cache and rename, so an interrupted save never leaves half a file
+    std::string temporary = path + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        if (!file.is_open() || !file.write(reinterpret_cast<const char*>(blob.data()), blob.size())) {
+            std::cerr << "Failed to write ROM library cache: " << path << std::endl;
+            return false;
+        }
+    }
+    std::error_code error;
+    fs::rename(temporary, path, error);
+    if (error) {
+        std::cerr << "Failed to write ROM library cache: " << path << " (" << error.message() << ")" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool RomLibrary::loadCache(const std::string& path) {
+    MappedFile file;
+    std::error_code error;
+    if (!fs::exists(path, error) || !file.open(path)) {
+        return false;
+    }
+
+    StateReader in(file.data(), file.size());
+    uint32_t tag = 0;
+    uint32_t version = 0;
+    uint32_t count = 0;
+    if (!in.get(tag) || !in.get(version) || !in.get(count) || tag != stateTag("NLIB") || version != LIBRARY_CACHE_VERSION) {
+        return false;
+    }
+
+    std::vector<RomEntry> loaded;
+    for (uint32_t i = 0; i < count && in.good(); i++) {
+        RomEntry entry;
+        uint32_t length = 0;
+        uint8_t valid = 0;
+        char sha1[40];
+        if (!in.get(length) || length > in.remaining()) {
+            break;
+        }
+        entry.path.resize(length);
+        in.read(entry.path.data(), length);
+        in.get(entry.size);
+        in.get(entry.mtime);
+        in.get(valid);
+        in.get(entry.info);
+        in.get(entry.crc32);
+        in.read(sha1, sizeof(sha1));
+        entry.valid = valid != 0;
+        if (entry.valid) {
+            entry.sha1.assign(sha1, sizeof(sha1));
+        }
+        loaded.push_back(std::move(entry));
+    }
+    if (!in.good() || loaded.size() != count) {
+        std::cerr << "Ignoring damaged ROM library cache: " << path << std::endl;
+        return false;
+    }
+
+    std::sort(loaded.begin(), loaded.end(), [](const RomEntry& a, const RomEntry& b) { return a.path < b.path; });
+    roms.swap(loaded);
+    return true;
+}
+
+const RomEntry* RomLibrary::findByPath(const std::string& path) const {
+    auto it = std::lower_bound(roms.begin(), roms.end(), path,
+                               [](const RomEntry& entry, const std::string& key) { return entry.path < key; });
+    return it != roms.end() && it->path == path ? &*it : nullptr;
+}
+
+const RomEntry* RomLibrary::findByCrc32(uint32_t crc) const {
+    for (const RomEntry& entry : roms) {
+        if (entry.valid && entry.crc32 == crc) {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+const RomEntry* RomLibrary::findBySha1(const std::string& sha1) const {
+    std::string key = sha1;
+    std::transform(key.begin(), key.end(), key.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    for (const RomEntry& entry : roms) {
+        if (entry.valid && entry.sha1 == key) {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
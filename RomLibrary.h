@@ -0,0 +1,63 @@
+#ifndef ROM_LIBRARY_H
+#define ROM_LIBRARY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "ROM.h"
+
+class ThreadPool;
+
+// One .nes file as the library knows it
+struct RomEntry {
+    std::string path;
+    uint64_t size = 0;          // File size and modification time decide whether the cached
+    int64_t mtime = 0;          // hashes below are still good
+    bool valid = false;         // Header parsed and the file holds everything it announces
+    CartridgeInfo info;
+    uint32_t crc32 = 0;         // Of PRG + CHR, i.e. without header and trainer, so the values
+    std::string sha1;           // match ROM databases that list headerless checksums
+};
+
+// Index of every .nes file below a directory.
+//
+// scan() walks the tree, reuses entries whose path, size and mtime match what the cache already
+// has, and hashes only new or changed files, one task per file on the given pool. The result can
+// be written to a cache file and read back, so a rescan of a large unchanged library is just a
+// directory walk.
+class RomLibrary {
+public:
+    struct ScanStats {
+        size_t files = 0;       // .nes files found
+        size_t hashed = 0;      // Read and hashed this time
+        size_t reused = 0;      // Taken from the cache unchanged
+        size_t invalid = 0;     // Not a usable NES file
+    };
+
+    // Cache file name scan users keep next to the ROMs
+    static constexpr const char* CACHE_FILE = ".nes_library";
+
+    // Replaces the entries with what is below `root` now. Waits for the pool to drain, so do not
+    // share the pool with unrelated long jobs. Returns false if `root` cannot be read.
+    bool scan(const std::string& root, ThreadPool& pool, ScanStats* stats = nullptr);
+
+    // Reads a single file (header, sizes and hashes). Returns entry.valid.
+    static bool indexFile(const std::string& path, RomEntry& entry);
+
+    bool loadCache(const std::string& path);
+    bool saveCache(const std::string& path) const;
+
+    // Sorted by path
+    const std::vector<RomEntry>& entries() const { return roms; }
+
+    // Lookups return nullptr when nothing matches. `sha1` is 40 hex digits, either case.
+    const RomEntry* findByPath(const std::string& path) const;
+    const RomEntry* findByCrc32(uint32_t crc) const;
+    const RomEntry* findBySha1(const std::string& sha1) const;
+
+private:
+    std::vector<RomEntry> roms;
+};
+
+#endif // ROM_LIBRARY_H
@@ -0,0 +1,119 @@
+#include "SaveRAM.h"
+#include <fstream>
+#include <iostream>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define SAVE_RAM_MMAP 1
+#endif
+
+SaveRAM::~SaveRAM() {
+    close();
+}
+
+bool SaveRAM::open(const std::string& file, size_t size) {
+    close();
+    if (size == 0) {
+        return true;
+    }
+
+#ifdef SAVE_RAM_MMAP
+    int fd = ::open(file.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        std::cerr << "Failed to open save file: " << file << std::endl;
+        return false;
+    }
+    // A short (or new) file grows with zeros; a longer one keeps its tail untouched
+    struct stat info;
+    bool sized = fstat(fd, &info) == 0 && S_ISREG(info.st_mode) &&
+                 (static_cast<size_t>(info.st_size) >= size || ftruncate(fd, static_cast<off_t>(size)) == 0);
+    if (sized) {
+        void* view = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (view != MAP_FAILED) {
+            ::close(fd);
+            bytes = static_cast<uint8_t*>(view);
+            length = size;
+            mapped = true;
+            path = file;
+            return true;
+        }
+    }
+    ::close(fd);
+#endif
+
+    path = file;
+    return readIntoHeap(size);
+}
+
+bool SaveRAM::readIntoHeap(size_t size) {
+    heap.assign(size, 0);
+    std::ifstream in(path, std::ios::binary);
+    if (in.is_open()) {
+        in.read(reinterpret_cast<char*>(heap.data()), static_cast<std::streamsize>(size));
+    }
+    bytes = heap.data();
+    length = heap.size();
+    // Write the file out on the first flush even if the game never touches the RAM
+    dirty = !in.is_open();
+    return true;
+}
+
+void SaveRAM::allocate(size_t size) {
+    close();
+    heap.assign(size, 0);
+    bytes = heap.empty() ? nullptr : heap.data();
+    length = heap.size();
+}
+
+bool SaveRAM::flush() {
+    if (!dirty || path.empty()) {
+        dirty = false;
+        return true;
+    }
+#ifdef SAVE_RAM_MMAP
+    if (mapped) {
+        if (msync(bytes, length, MS_SYNC) != 0) {
+            std::cerr << "Failed to sync save file: " << path << std::endl;
+            return false;
+        }
+        dirty = false;
+        return true;
+    }
+#endif
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out.write(reinterpret_cast<const char*>(bytes), static_cast<std::streamsize>(length))) {
+        std::cerr << "Failed to write save file: " << path << std::endl;
+        return false;
+    }
+    dirty = false;
+    return true;
+}
+
+void SaveRAM::swap(SaveRAM& other) {
+    std::swap(bytes, other.bytes);
+    std::swap(length, other.length);
+    std::swap(mapped, other.mapped);
+    std::swap(dirty, other.dirty);
+    path.swap(other.path);
+    heap.swap(other.heap);
+}
+
+void SaveRAM::close() {
+    flush();
+#ifdef SAVE_RAM_MMAP
+    if (mapped) {
+        munmap(bytes, length);
+    }
+#endif
+    heap.clear();
+    heap.shrink_to_fit();
+    bytes = nullptr;
+    length = 0;
+    mapped = false;
+    dirty = false;
+    path.clear();
+}
@@ -0,0 +1,57 @@
+#ifndef SAVE_RAM_H
+#define SAVE_RAM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Cartridge work RAM, optionally backed by a save file.
+//
+// Battery backed RAM is a shared writable mapping of the .sav file, so the CPU writes straight into
+// the page cache and a write costs a store plus setting the dirty flag. Nothing is synced per write:
+// flush() pushes dirty pages out (msync) and is called when emulation pauses or the RAM is released.
+// Hosts without mmap keep the RAM on the heap and flush() rewrites the file instead.
+class SaveRAM {
+public:
+    SaveRAM() = default;
+    ~SaveRAM();
+
+    SaveRAM(const SaveRAM&) = delete;
+    SaveRAM& operator=(const SaveRAM&) = delete;
+
+    // Maps `size` bytes of the save file, creating it or zero-extending it as needed.
+    // Returns false (and stays empty) if the file cannot be opened for writing.
+    bool open(const std::string& path, size_t size);
+
+    // Zeroed RAM that is not saved anywhere
+    void allocate(size_t size);
+
+    // Flushes, then releases
+    void close();
+    void swap(SaveRAM& other);
+
+    uint8_t* data() { return bytes; }
+    const uint8_t* data() const { return bytes; }
+    size_t size() const { return length; }
+    bool isMapped() const { return mapped; }
+    bool isPersistent() const { return !path.empty(); }
+
+    void markDirty() { dirty = true; }
+    bool isDirty() const { return dirty; }
+
+    // Writes the contents back to the save file if anything changed since the last flush
+    bool flush();
+
+private:
+    uint8_t* bytes = nullptr;
+    size_t length = 0;
+    bool mapped = false;
+    bool dirty = false;
+    std::string path;           // Empty for volatile RAM
+    std::vector<uint8_t> heap;
+
+    bool readIntoHeap(size_t size);
+};
+
+#endif // SAVE_RAM_H
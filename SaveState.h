@@ -0,0 +1,111 @@
+#ifndef SAVESTATE_H
+#define SAVESTATE_H
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+// Save state blob layout (all values in host byte order):
+//
+//   header   "NESS" | uint32 version | uint32 total size
+//   chunks   uint32 tag | uint32 payload size | payload     (CPU, BUS, PPU, APU, CART in that order)
+//
+// Every device copies its state field by field or as whole arrays, so a snapshot is a handful of
+// memcpy's into a buffer the caller keeps around. Bump the version whenever any payload changes.
+const uint32_t SAVE_STATE_VERSION = 6;
+
+constexpr uint32_t stateTag(const char (&name)[5]) {
+    return static_cast<uint32_t>(name[0]) | static_cast<uint32_t>(name[1]) << 8 |
+           static_cast<uint32_t>(name[2]) << 16 | static_cast<uint32_t>(name[3]) << 24;
+}
+
+class StateWriter {
+public:
+    // Clears `out` but keeps its capacity, so reusing one buffer avoids allocating per snapshot
+    explicit StateWriter(std::vector<uint8_t>& out) : out(out) { out.clear(); }
+
+    void write(const void* data, size_t size) {
+        size_t at = out.size();
+        out.resize(at + size);
+        std::memcpy(out.data() + at, data, size);
+    }
+
+    template <typename T>
+    void put(const T& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "save state values must be trivially copyable");
+        write(&value, sizeof(T));
+    }
+
+    // Returns the offset of the chunk header, pass it back to endChunk() to patch the size in
+    size_t beginChunk(uint32_t tag) {
+        size_t at = out.size();
+        put(tag);
+        put(uint32_t(0));
+        return at;
+    }
+
+    void endChunk(size_t at) {
+        uint32_t size = static_cast<uint32_t>(out.size() - at - 8);
+        std::memcpy(out.data() + at + 4, &size, sizeof(size));
+    }
+
+    size_t size() const { return out.size(); }
+    uint8_t* data() { return out.data(); }
+
+private:
+    std::vector<uint8_t>& out;
+};
+
+class StateReader {
+public:
+    StateReader(const uint8_t* data, size_t size) : data(data), size(size) {}
+
+    // Once a read runs past the end (or a chunk does not match) every later read fails too
+    bool read(void* dst, size_t count) {
+        if (!ok || count > size - position) {
+            ok = false;
+            return false;
+        }
+        std::memcpy(dst, data + position, count);
+        position += count;
+        return true;
+    }
+
+    template <typename T>
+    bool get(T& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "save state values must be trivially copyable");
+        return read(&value, sizeof(T));
+    }
+
+    bool enterChunk(uint32_t tag) {
+        uint32_t foundTag = 0;
+        uint32_t length = 0;
+        if (!get(foundTag) || !get(length) || foundTag != tag || length > size - position) {
+            ok = false;
+            return false;
+        }
+        chunkEnd = position + length;
+        return true;
+    }
+
+    // The chunk must have been consumed exactly, otherwise the layout does not match this build
+    bool leaveChunk() {
+        if (position != chunkEnd) {
+            ok = false;
+        }
+        return ok;
+    }
+
+    bool good() const { return ok; }
+    size_t remaining() const { return size - position; }
+
+private:
+    const uint8_t* data;
+    size_t size;
+    size_t position = 0;
+    size_t chunkEnd = 0;
+    bool ok = true;
+};
+
+#endif // SAVESTATE_H
@@ -0,0 +1,117 @@
+#include "ThreadPool.h"
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+ThreadPool::ThreadPool(int threadCount, bool pin) {
+    if (threadCount <= 0) {
+        threadCount = hardwareThreads();
+    }
+    for (int i = 0; i < threadCount; i++) {
+        queues.emplace_back(new Queue());
+    }
+    for (int i = 0; i < threadCount; i++) {
+        threads.emplace_back([this, i, pin] {
+#ifdef __linux__
+            if (pin) {
+                cpu_set_t set;
+                CPU_ZERO(&set);
+                CPU_SET(i % hardwareThreads(), &set);
+                pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+            }
+#else
+            (void)pin;
+#endif
+            workerMain(i);
+        });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    workReady.notify_all();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+int ThreadPool::hardwareThreads() {
+    unsigned count = std::thread::hardware_concurrency();
+    return count > 0 ? static_cast<int>(count) : 1;
+}
+
+void ThreadPool::submit(Task task) {
+    size_t index;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        index = nextQueue++ % queues.size();
+        unfinished++;
+    }
+    {
+        std::lock_guard<std::mutex> lock(queues[index]->mutex);
+        queues[index]->tasks.push_back(std::move(task));
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queued++;
+    }
+    workReady.notify_one();
+}
+
+void ThreadPool::wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    allDone.wait(lock, [this] { return unfinished == 0; });
+}
+
+// Own queue from the back, then the front of everybody else's
+bool ThreadPool::takeTask(int index, Task& task) {
+    {
+        Queue& own = *queues[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    for (size_t k = 1; k < queues.size(); k++) {
+        Queue& victim = *queues[(index + k) % queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::workerMain(int index) {
+    while (true) {
+        // Reserve one of the queued tasks first, so the search below always finds something
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            workReady.wait(lock, [this] { return stopping || queued > 0; });
+            if (queued == 0) {
+                return;
+            }
+            queued--;
+        }
+
+        Task task;
+        while (!takeTask(index, task)) {
+            std::this_thread::yield();
+        }
+        task(index);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--unfinished == 0) {
+            allDone.notify_all();
+        }
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed size work-stealing pool for coarse jobs (whole emulation runs).
+//
+// Every worker has its own queue. submit() deals tasks out round robin; a worker runs its own
+// queue newest first and, once it is empty, steals the oldest task from the other queues, so a
+// few long jobs do not leave the rest of the pool idle. Tasks get the index of the worker that
+// runs them, which lets callers keep one heavy object (e.g. a NES) per worker.
+class ThreadPool {
+public:
+    using Task = std::function<void(int worker)>;
+
+    // `threads` <= 0 uses one worker per hardware thread. With `pin`, worker i is bound to core i
+    // (Linux only, elsewhere it is ignored).
+    explicit ThreadPool(int threads = 0, bool pin = false);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void submit(Task task);
+
+    // Block until every submitted task has finished
+    void wait();
+
+    int size() const { return static_cast<int>(threads.size()); }
+    static int hardwareThreads();
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> threads;
+
+    std::mutex mutex;                   // Guards the counters below and the sleep / wake up
+    std::condition_variable workReady;
+    std::condition_variable allDone;
+    size_t queued = 0;                  // Submitted, not yet taken
+    size_t unfinished = 0;              // Submitted, not yet finished
+    size_t nextQueue = 0;
+    bool stopping = false;
+
+    void workerMain(int index);
+    bool takeTask(int index, Task& task);
+};
+
+#endif // THREAD_POOL_H
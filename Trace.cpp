@@ -0,0 +1,217 @@
+#include "Trace.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+enum Mode : uint8_t { IMP, ACC, IMM, ZP, ZPX, ZPY, ABS, ABX, ABY, IND, IZX, IZY, REL };
+
+struct OpcodeInfo {
+    const char* mnemonic;
+    Mode mode;
+    bool unofficial;    // nestest.log marks these with '*'
+};
+
+// Standard 6502 decoding, including the undocumented opcodes
+const OpcodeInfo opcodes[256] = {
+    {"BRK", IMP, false}, {"ORA", IZX, false}, {"STP", IMP, true}, {"SLO", IZX, true}, {"NOP", ZP, true}, {"ORA", ZP, false}, {"ASL", ZP, false}, {"SLO", ZP, true},
+    {"PHP", IMP, false}, {"ORA", IMM, false}, {"ASL", ACC, false}, {"ANC", IMM, true}, {"NOP", ABS, true}, {"ORA", ABS, false}, {"ASL", ABS, false}, {"SLO", ABS, true},
+    {"BPL", REL, false}, {"ORA", IZY, false}, {"STP", IMP, true}, {"SLO", IZY, true}, {"NOP", ZPX, true}, {"ORA", ZPX, false}, {"ASL", ZPX, false}, {"SLO", ZPX, true},
+    {"CLC", IMP, false}, {"ORA", ABY, false}, {"NOP", IMP, true}, {"SLO", ABY, true}, {"NOP", ABX, true}, {"ORA", ABX, false}, {"ASL", ABX, false}, {"SLO", ABX, true},
+    {"JSR", ABS, false}, {"AND", IZX, false}, {"STP", IMP, true}, {"RLA", IZX, true}, {"BIT", ZP, false}, {"AND", ZP, false}, {"ROL", ZP, false}, {"RLA", ZP, true},
+    {"PLP", IMP, false}, {"AND", IMM, false}, {"ROL", ACC, false}, {"ANC", IMM, true}, {"BIT", ABS, false}, {"AND", ABS, false}, {"ROL", ABS, false}, {"RLA", ABS, true},
+    {"BMI", REL, false}, {"AND", IZY, false}, {"STP", IMP, true}, {"RLA", IZY, true}, {"NOP", ZPX, true}, {"AND", ZPX, false}, {"ROL", ZPX, false}, {"RLA", ZPX, true},
+    {"SEC", IMP, false}, {"AND", ABY, false}, {"NOP", IMP, true}, {"RLA", ABY, true}, {"NOP", ABX, true}, {"AND", ABX, false}, {"ROL", ABX, false}, {"RLA", ABX, true},
+    {"RTI", IMP, false}, {"EOR", IZX, false}, {"STP", IMP, true}, {"SRE", IZX, true}, {"NOP", ZP, true}, {"EOR", ZP, false}, {"LSR", ZP, false}, {"SRE", ZP, true},
+    {"PHA", IMP, false}, {"EOR", IMM, false}, {"LSR", ACC, false}, {"ALR", IMM, true}, {"JMP", ABS, false}, {"EOR", ABS, false}, {"LSR", ABS, false}, {"SRE", ABS, true},
+    {"BVC", REL, false}, {"EOR", IZY, false}, {"STP", IMP, true}, {"SRE", IZY, true}, {"NOP", ZPX, true}, {"EOR", ZPX, false}, {"LSR", ZPX, false}, {"SRE", ZPX, true},
+    {"CLI", IMP, false}, {"EOR", ABY, false}, {"NOP", IMP, true}, {"SRE", ABY, true}, {"NOP", ABX, true}, {"EOR", ABX, false}, {"LSR", ABX, false}, {"SRE", ABX, true},
+    {"RTS", IMP, false}, {"ADC", IZX, false}, {"STP", IMP, true}, {"RRA", IZX, true}, {"NOP", ZP, true}, {"ADC", ZP, false}, {"ROR", ZP, false}, {"RRA", ZP, true},
+    {"PLA", IMP, false}, {"ADC", IMM, false}, {"ROR", ACC, false}, {"ARR", IMM, true}, {"JMP", IND, false}, {"ADC", ABS, false}, {"ROR", ABS, false}, {"RRA", ABS, true},
+    {"BVS", REL, false}, {"ADC", IZY, false}, {"STP", IMP, true}, {"RRA", IZY, true}, {"NOP", ZPX, true}, {"ADC", ZPX, false}, {"ROR", ZPX, false}, {"RRA", ZPX, true},
+    {"SEI", IMP, false}, {"ADC", ABY, false}, {"NOP", IMP, true}, {"RRA", ABY, true}, {"NOP", ABX, true}, {"ADC", ABX, false}, {"ROR", ABX, false}, {"RRA", ABX, true},
+    {"NOP", IMM, true}, {"STA", IZX, false}, {"NOP", IMM, true}, {"SAX", IZX, true}, {"STY", ZP, false}, {"STA", ZP, false}, {"STX", ZP, false}, {"SAX", ZP, true},
+    {"DEY", IMP, false}, {"NOP", IMM, true}, {"TXA", IMP, false}, {"XAA", IMM, true}, {"STY", ABS, false}, {"STA", ABS, false}, {"STX", ABS, false}, {"SAX", ABS, true},
+    {"BCC", REL, false}, {"STA", IZY, false}, {"STP", IMP, true}, {"AHX", IZY, true}, {"STY", ZPX, false}, {"STA", ZPX, false}, {"STX", ZPY, false}, {"SAX", ZPY, true},
+    {"TYA", IMP, false}, {"STA", ABY, false}, {"TXS", IMP, false}, {"TAS", ABY, true}, {"SHY", ABX, true}, {"STA", ABX, false}, {"SHX", ABY, true}, {"AHX", ABY, true},
+    {"LDY", IMM, false}, {"LDA", IZX, false}, {"LDX", IMM, false}, {"LAX", IZX, true}, {"LDY", ZP, false}, {"LDA", ZP, false}, {"LDX", ZP, false}, {"LAX", ZP, true},
+    {"TAY", IMP, false}, {"LDA", IMM, false}, {"TAX", IMP, false}, {"LAX", IMM, true}, {"LDY", ABS, false}, {"LDA", ABS, false}, {"LDX", ABS, false}, {"LAX", ABS, true},
+    {"BCS", REL, false}, {"LDA", IZY, false}, {"STP", IMP, true}, {"LAX", IZY, true}, {"LDY", ZPX, false}, {"LDA", ZPX, false}, {"LDX", ZPY, false}, {"LAX", ZPY, true},
+    {"CLV", IMP, false}, {"LDA", ABY, false}, {"TSX", IMP, false}, {"LAS", ABY, true}, {"LDY", ABX, false}, {"LDA", ABX, false}, {"LDX", ABY, false}, {"LAX", ABY, true},
+    {"CPY", IMM, false}, {"CMP", IZX, false}, {"NOP", IMM, true}, {"DCP", IZX, true}, {"CPY", ZP, false}, {"CMP", ZP, false}, {"DEC", ZP, false}, {"DCP", ZP, true},
+    {"INY", IMP, false}, {"CMP", IMM, false}, {"DEX", IMP, false}, {"AXS", IMM, true}, {"CPY", ABS, false}, {"CMP", ABS, false}, {"DEC", ABS, false}, {"DCP", ABS, true},
+    {"BNE", REL, false}, {"CMP", IZY, false}, {"STP", IMP, true}, {"DCP", IZY, true}, {"NOP", ZPX, true}, {"CMP", ZPX, false}, {"DEC", ZPX, false}, {"DCP", ZPX, true},
+    {"CLD", IMP, false}, {"CMP", ABY, false}, {"NOP", IMP, true}, {"DCP", ABY, true}, {"NOP", ABX, true}, {"CMP", ABX, false}, {"DEC", ABX, false}, {"DCP", ABX, true},
+    {"CPX", IMM, false}, {"SBC", IZX, false}, {"NOP", IMM, true}, {"ISB", IZX, true}, {"CPX", ZP, false}, {"SBC", ZP, false}, {"INC", ZP, false}, {"ISB", ZP, true},
+    {"INX", IMP, false}, {"SBC", IMM, false}, {"NOP", IMP, false}, {"SBC", IMM, true}, {"CPX", ABS, false}, {"SBC", ABS, false}, {"INC", ABS, false}, {"ISB", ABS, true},
+    {"BEQ", REL, false}, {"SBC", IZY, false}, {"STP", IMP, true}, {"ISB", IZY, true}, {"NOP", ZPX, true}, {"SBC", ZPX, false}, {"INC", ZPX, false}, {"ISB", ZPX, true},
+    {"SED", IMP, false}, {"SBC", ABY, false}, {"NOP", IMP, true}, {"ISB", ABY, true}, {"NOP", ABX, true}, {"SBC", ABX, false}, {"INC", ABX, false}, {"ISB", ABX, true},
+};
+
+int operandBytes(Mode mode) {
+    switch (mode) {
+    case IMP: case ACC: return 0;
+    case ABS: case ABX: case ABY: case IND: return 2;
+    default: return 1;
+    }
+}
+
+} // namespace
+
+TraceLog::TraceLog(size_t capacity) {
+    size_t size = 1;
+    while (size < capacity) {
+        size <<= 1;
+    }
+    ring.resize(size);
+    mask = size - 1;
+}
+
+TraceLog::~TraceLog() {
+    stop();
+}
+
+bool TraceLog::compiledIn() {
+#ifdef NES_TRACE
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool TraceLog::start(const std::string& path) {
+    stop();
+    file.open(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        std::cerr << "Failed to create trace file: " << path << std::endl;
+        return false;
+    }
+    TraceFileHeader header{{'N', 'T', 'R', 'C'}, TRACE_FILE_VERSION, sizeof(TraceRecord), 0};
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    head.store(0);
+    tail.store(0);
+    tailSeen = 0;
+    stallCount = 0;
+    stopping.store(false);
+    writer = std::thread(&TraceLog::writerMain, this);
+    return true;
+}
+
+void TraceLog::startCapture() {
+    stop();
+    head.store(0);
+    tail.store(0);
+    tailSeen = 0;
+    stallCount = 0;
+}
+
+void TraceLog::stop() {
+    if (!writer.joinable()) {
+        return;
+    }
+    stopping.store(true);
+    writer.join();
+    file.close();
+}
+
+void TraceLog::waitForSpace(uint64_t position) {
+    tailSeen = tail.load(std::memory_order_acquire);
+    if (position - tailSeen < ring.size()) {
+        return;
+    }
+    stallCount++;
+    while (position - tailSeen >= ring.size()) {
+        std::this_thread::yield();
+        tailSeen = tail.load(std::memory_order_acquire);
+    }
+}
+
+// Writes whatever is in the ring, as at most two blocks (before and after the wrap), then
+// sleeps a little when it caught up. The producer never has to wake it.
+void TraceLog::writerMain() {
+    uint64_t position = tail.load(std::memory_order_relaxed);
+    for (;;) {
+        bool last = stopping.load(std::memory_order_acquire);
+        uint64_t end = head.load(std::memory_order_acquire);
+        while (position != end) {
+            size_t first = static_cast<size_t>(position & mask);
+            size_t count = static_cast<size_t>(std::min<uint64_t>(end - position, ring.size() - first));
+            file.write(reinterpret_cast<const char*>(&ring[first]), count * sizeof(TraceRecord));
+            position += count;
+            tail.store(position, std::memory_order_release);
+        }
+        if (last) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    file.flush();
+}
+
+bool parseTraceFile(const uint8_t* data, size_t size, const TraceRecord*& records, size_t& count) {
+    TraceFileHeader header;
+    if (data == nullptr || size < sizeof(header)) {
+        return false;
+    }
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, "NTRC", 4) != 0 || header.version != TRACE_FILE_VERSION ||
+        header.recordSize != sizeof(TraceRecord)) {
+        return false;
+    }
+    records = reinterpret_cast<const TraceRecord*>(data + sizeof(header));
+    count = (size - sizeof(header)) / sizeof(TraceRecord);
+    return true;
+}
+
+const char* opcodeMnemonic(uint8_t opcode) {
+    return opcodes[opcode].mnemonic;
+}
+
+std::string formatTraceLine(const TraceRecord& record) {
+    const OpcodeInfo& op = opcodes[record.opcode];
+    int bytes = operandBytes(op.mode);
+    uint8_t lo = record.operand[0];
+    uint16_t word = static_cast<uint16_t>(record.operand[1] << 8 | lo);
+
+    char operand[16] = "";
+    switch (op.mode) {
+    case IMP: break;
+    case ACC: std::snprintf(operand, sizeof(operand), "A"); break;
+    case IMM: std::snprintf(operand, sizeof(operand), "#$%02X", lo); break;
+    case ZP:  std::snprintf(operand, sizeof(operand), "$%02X", lo); break;
+    case ZPX: std::snprintf(operand, sizeof(operand), "$%02X,X", lo); break;
+    case ZPY: std::snprintf(operand, sizeof(operand), "$%02X,Y", lo); break;
+    case ABS: std::snprintf(operand, sizeof(operand), "$%04X", word); break;
+    case ABX: std::snprintf(operand, sizeof(operand), "$%04X,X", word); break;
+    case ABY: std::snprintf(operand, sizeof(operand), "$%04X,Y", word); break;
+    case IND: std::snprintf(operand, sizeof(operand), "($%04X)", word); break;
+    case IZX: std::snprintf(operand, sizeof(operand), "($%02X,X)", lo); break;
+    case IZY: std::snprintf(operand, sizeof(operand), "($%02X),Y", lo); break;
+    case REL:
+        std::snprintf(operand, sizeof(operand), "$%04X",
+                      static_cast<uint16_t>(record.pc + 2 + static_cast<int8_t>(lo)));
+        break;
+    }
+
+    char hex[10];
+    if (bytes == 0) {
+        std::snprintf(hex, sizeof(hex), "%02X", record.opcode);
+    } else if (bytes == 1) {
+        std::snprintf(hex, sizeof(hex), "%02X %02X", record.opcode, lo);
+    } else {
+        std::snprintf(hex, sizeof(hex), "%02X %02X %02X", record.opcode, lo, record.operand[1]);
+    }
+
+    char text[32];
+    std::snprintf(text, sizeof(text), "%s%s%s", op.mnemonic, operand[0] ? " " : "", operand);
+
+    char line[128];
+    std::snprintf(line, sizeof(line), "%04X  %-8s %c%-31s A:%02X X:%02X Y:%02X P:%02X SP:%02X PPU:%3d,%3d CYC:%llu",
+                  record.pc, hex, op.unofficial ? '*' : ' ', text, record.a, record.x, record.y, record.p, record.s,
+                  record.scanline, record.dot, static_cast<unsigned long long>(record.cycle));
+    return line;
+}
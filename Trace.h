@@ -0,0 +1,116 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// One executed instruction, captured before it runs
+struct TraceRecord {
+    uint64_t cycle;         // CPU cycles since power on
+    uint16_t pc;
+    uint8_t opcode;
+    uint8_t operand[2];     // The two bytes after the opcode, whether the instruction uses them or not
+    uint8_t a, x, y, p, s;
+    int16_t scanline;
+    int16_t dot;
+};
+static_assert(sizeof(TraceRecord) == 24, "trace files store records as they are in memory");
+
+// A trace file is this header followed by the records
+struct TraceFileHeader {
+    char magic[4];          // "NTRC"
+    uint32_t version;
+    uint32_t recordSize;
+    uint32_t reserved;
+};
+
+const uint32_t TRACE_FILE_VERSION = 1;
+
+// CPU instruction trace.
+//
+// Built with NES_TRACE (make TRACE=1), the CPU hands each instruction it starts to the TraceLog
+// attached to it: one 24 byte store into a single producer / single consumer ring, no lock, no
+// formatting, no I/O. A writer thread drains the ring to disk in large blocks. When the ring is
+// full the emulation waits for the writer rather than dropping records, so a trace is always
+// complete. Without NES_TRACE the hook is not compiled in and costs nothing.
+//
+// Records expand to nestest.log lines offline (formatTraceLine, tools/tracefmt).
+class TraceLog {
+public:
+    explicit TraceLog(size_t capacity = 1 << 16);
+    ~TraceLog();
+
+    TraceLog(const TraceLog&) = delete;
+    TraceLog& operator=(const TraceLog&) = delete;
+
+    // Creates the file and starts the writer. Returns false if the file cannot be created.
+    bool start(const std::string& path);
+    // Writes out everything recorded so far and closes the file
+    void stop();
+    bool isOpen() const { return writer.joinable(); }
+
+    // Keeps records in the ring for take() instead of writing them out, for tools that check a
+    // trace while it is produced. Single threaded: take() has to keep up, a full ring never drains.
+    void startCapture();
+    bool take(TraceRecord& entry) {
+        uint64_t position = tail.load(std::memory_order_relaxed);
+        if (position == head.load(std::memory_order_acquire)) {
+            return false;
+        }
+        entry = ring[position & mask];
+        tail.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Emulation thread only
+    void record(const TraceRecord& entry) {
+        uint64_t position = head.load(std::memory_order_relaxed);
+        if (position - tailSeen >= ring.size()) {
+            waitForSpace(position);
+        }
+        ring[position & mask] = entry;
+        head.store(position + 1, std::memory_order_release);
+    }
+
+    uint64_t recorded() const { return head.load(std::memory_order_relaxed); }
+    // Times the emulation had to wait for the writer
+    uint64_t stalls() const { return stallCount; }
+
+    // Whether the CPU hook was compiled in (NES_TRACE)
+    static bool compiledIn();
+
+private:
+    std::vector<TraceRecord> ring;
+    size_t mask;
+
+    // Producer and consumer indices on their own cache lines
+    alignas(64) std::atomic<uint64_t> head{0};
+    uint64_t tailSeen = 0;      // Producer's last look at `tail`
+    uint64_t stallCount = 0;
+    alignas(64) std::atomic<uint64_t> tail{0};
+
+    std::atomic<bool> stopping{false};
+    std::thread writer;
+    std::ofstream file;
+
+    void waitForSpace(uint64_t position);
+    void writerMain();
+};
+
+// Finds the records in a whole trace file image. Returns false if it is not a trace file.
+bool parseTraceFile(const uint8_t* data, size_t size, const TraceRecord*& records, size_t& count);
+
+// One line in nestest.log layout, e.g.
+//   C000  4C F5 C5  JMP $C5F5                       A:00 X:00 Y:00 P:24 SP:FD PPU:  0, 21 CYC:7
+// The trace holds no memory contents, so the "= xx" value columns nestest.log adds are left out.
+std::string formatTraceLine(const TraceRecord& record);
+
+// "LDA", "JSR", ... including the undocumented opcodes
+const char* opcodeMnemonic(uint8_t opcode);
+
+#endif // TRACE_H
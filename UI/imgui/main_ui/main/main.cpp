@@ -8,6 +8,10 @@
 #include <stdio.h>
 #include <SDL2/SDL.h>
 #include "../../../../NES.h"
+#include "../../../../EmulationThread.h"
+#include "../../../../RomLibrary.h"
+#include "../../../../ThreadPool.h"
+#include "../../../../HostZones.h"
 #if defined(IMGUI_IMPL_OPENGL_ES2)
 #include <SDL_opengles2.h>
 #else
@@ -18,18 +22,106 @@
 #include <stdio.h>
 #include <bits/fs_fwd.h>
 #include <bits/fs_path.h>
+#include <algorithm>
+#include <fstream>
+#include <future>
+#include <string>
 
 #include "portable-file-dialogs.h"
 
+// Host time of the last HostZones::HISTORY frames of a track, one stacked bar per frame with the
+// time outside every zone on top in grey. The dark line marks 60 fps.
+static void drawFrameTimes(HostZones::Track track) {
+    static const ImU32 colors[HostZones::ZONES] = {
+        IM_COL32(230, 90, 70, 255), IM_COL32(80, 160, 230, 255), IM_COL32(110, 200, 110, 255),
+        IM_COL32(230, 180, 60, 255), IM_COL32(170, 110, 220, 255), IM_COL32(90, 200, 200, 255)};
+    const ImU32 otherColor = IM_COL32(110, 110, 110, 255);
+    const float barWidth = 2.0f;
+    const float height = 80.0f;
+
+    std::vector<HostZones::Sample> samples = HostZones::history(track);
+    double msPerTick = 1000.0 / HostZones::ticksPerSecond();
+    double average[HostZones::ZONES] = {};
+    double averageFrame = 0.0;
+    double longest = 1000.0 / 60.0;
+    for (const HostZones::Sample& sample : samples) {
+        for (int zone = 0; zone < HostZones::ZONES; zone++) {
+            average[zone] += sample.ticks[zone] * msPerTick / samples.size();
+        }
+        averageFrame += sample.duration * msPerTick / samples.size();
+        longest = std::max(longest, sample.duration * msPerTick);
+    }
+
+    ImGui::Text("%s: %.2f ms per frame", HostZones::trackName(track), averageFrame);
+    ImVec2 origin = ImGui::GetCursorScreenPos();
+    ImVec2 size(HostZones::HISTORY * barWidth, height);
+    float pixelsPerMs = static_cast<float>(height / longest);
+    ImDrawList* draw = ImGui::GetWindowDrawList();
+    draw->AddRectFilled(origin, ImVec2(origin.x + size.x, origin.y + size.y), IM_COL32(25, 25, 25, 255));
+    float x = origin.x + (HostZones::HISTORY - samples.size()) * barWidth;
+    for (const HostZones::Sample& sample : samples) {
+        float y = origin.y + size.y;
+        uint64_t zoned = 0;
+        for (int zone = 0; zone < HostZones::ZONES; zone++) {
+            float bar = static_cast<float>(sample.ticks[zone] * msPerTick) * pixelsPerMs;
+            draw->AddRectFilled(ImVec2(x, y - bar), ImVec2(x + barWidth, y), colors[zone]);
+            y -= bar;
+            zoned += sample.ticks[zone];
+        }
+        if (sample.duration > zoned) {
+            float bar = static_cast<float>((sample.duration - zoned) * msPerTick) * pixelsPerMs;
+            draw->AddRectFilled(ImVec2(x, y - bar), ImVec2(x + barWidth, y), otherColor);
+        }
+        x += barWidth;
+    }
+    float frameLine = origin.y + size.y - static_cast<float>(1000.0 / 60.0) * pixelsPerMs;
+    draw->AddLine(ImVec2(origin.x, frameLine), ImVec2(origin.x + size.x, frameLine), IM_COL32(0, 0, 0, 255));
+    ImGui::Dummy(size);
+
+    // Legend with the average of each zone that ran on this track
+    double other = averageFrame;
+    for (int zone = 0; zone < HostZones::ZONES; zone++) {
+        if (average[zone] > 0.0) {
+            ImGui::TextColored(ImColor(colors[zone]), "%s %.2f ms", HostZones::zoneName(static_cast<HostZones::Zone>(zone)), average[zone]);
+            ImGui::SameLine();
+            other -= average[zone];
+        }
+    }
+    ImGui::TextColored(ImColor(otherColor), "Other %.2f ms", std::max(other, 0.0));
+}
+
 int main(int, char**)
 {
     NES nes;
+    EmulationThread emulator(nes);
 
     float R = 1;
     float G = 1;
     float B = 1;
 
     bool showDebug = false;
+    bool tracing = false;
+    bool profiling = false;
+
+    // ROM library browser; scans run on a background task so big folders do not stall the UI
+    bool showLibrary = false;
+    RomLibrary library;
+    std::string libraryDir;
+    std::future<RomLibrary> libraryScan;
+    auto startLibraryScan = [&](const std::string& dir) {
+        libraryDir = dir;
+        libraryScan = std::async(std::launch::async, [dir, previous = library]() mutable {
+            std::string cache = dir + "/" + RomLibrary::CACHE_FILE;
+            if (previous.entries().empty()) {
+                previous.loadCache(cache);
+            }
+            ThreadPool pool;
+            if (previous.scan(dir, pool)) {
+                previous.saveCache(cache);
+            }
+            return previous;
+        });
+    };
 
     // Setup SDL
     if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER | SDL_INIT_GAMECONTROLLER) != 0)
@@ -120,6 +212,9 @@ int main(int, char**)
     bool show_another_window = false;
     ImVec4 clear_color = ImVec4(0.45f, 0.55f, 0.60f, 1.00f);
 
+    // The NES runs on its own thread from here on, the UI only talks to it through `emulator`
+    emulator.start();
+
     // Main loop
     bool done = false;
 #ifdef __EMSCRIPTEN__
@@ -151,6 +246,8 @@ int main(int, char**)
             continue;
         }
 
+        NES_FRAME_ZONE(UI);
+
         // Start the Dear ImGui frame
         ImGui_ImplOpenGL3_NewFrame();
         ImGui_ImplSDL2_NewFrame();
@@ -172,7 +269,9 @@ int main(int, char**)
           //ImGui::Begin("NES Emulator", nullptr, ImGuiWindowFlags_NoResize;		// don't allow resizing?
           ImVec2 widgetSize = ImGui::GetContentRegionAvail();
 
-          uint32_t* framebuffer = nes.getFramebuffer();
+          // Latest frame published by the emulation thread (pixels + registers)
+          const EmulationThread::Frame& frame = emulator.latestFrame();
+          const uint32_t* framebuffer = frame.pixels;
 
 
           // Set the width and height of the NES screen
@@ -196,66 +295,73 @@ int main(int, char**)
           //ImGui::SetWindowSize(ImVec2(renderWidth, renderHeight), 0);
 
           const Uint8 *keyboard;
+          Bus::controller input{};
 
           SDL_PumpEvents();
           keyboard = SDL_GetKeyboardState(NULL);
           // Handle the Return key
           if (keyboard[SDL_SCANCODE_RETURN]) {
-              nes.bus.controller1.start = 1;
+              input.start = 1;
           } else {
-              nes.bus.controller1.start = 0;
+              input.start = 0;
           }
 
           // Handle the Up arrow key
           if (keyboard[SDL_SCANCODE_W]) {
-              nes.bus.controller1.up = 1;
+              input.up = 1;
           } else {
-              nes.bus.controller1.up = 0;
+              input.up = 0;
           }
 
           // Handle the Down arrow key
           if (keyboard[SDL_SCANCODE_S]) {
-              nes.bus.controller1.down = 1;
+              input.down = 1;
           } else {
-              nes.bus.controller1.down = 0;
+              input.down = 0;
           }
 
           // Handle the Left arrow key
           if (keyboard[SDL_SCANCODE_A]) {
-              nes.bus.controller1.left = 1;
+              input.left = 1;
           } else {
-              nes.bus.controller1.left = 0;
+              input.left = 0;
           }
 
           // Handle the Right arrow key
           if (keyboard[SDL_SCANCODE_D]) {
-              nes.bus.controller1.right = 1;
+              input.right = 1;
           } else {
-              nes.bus.controller1.right = 0;
+              input.right = 0;
           }
 
           // Handle the Control key
           if (keyboard[SDL_SCANCODE_LCTRL]) {
-              nes.bus.controller1.select = 1;
+              input.select = 1;
           } else {
-              nes.bus.controller1.select = 0;
+              input.select = 0;
           }
 
           // Handle the X key
           if (keyboard[SDL_SCANCODE_M]) {
-              nes.bus.controller1.a = 1;
+              input.a = 1;
           } else {
-              nes.bus.controller1.a = 0;
+              input.a = 0;
           }
 
           // Handle the Z key
           if (keyboard[SDL_SCANCODE_N]) {
-              nes.bus.controller1.b = 1;
+              input.b = 1;
           } else {
-              nes.bus.controller1.b = 0;
+              input.b = 0;
           }
 
-          GLuint textureID;
+          // Hand the controller snapshot to the emulation thread, it latches it at the next frame
+          emulator.setInput(input.reg);
+
+          // Hold Backspace to rewind
+          emulator.setRewind(keyboard[SDL_SCANCODE_BACKSPACE] != 0);
+
+          static GLuint textureID = 0;
 
           // Create/OpenGL texture if not already created
           if (textureID == 0) {
@@ -268,8 +374,12 @@ int main(int, char**)
           }
 
           // Upload the framebuffer data to the texture
-          glBindTexture(GL_TEXTURE_2D, textureID);
-          glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, screenWidth, screenHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, framebuffer);
+          {
+              NES_ZONE(UI_UPLOAD);
+              NES_COUNT(UPLOAD_BYTES, screenWidth * screenHeight * 4);
+              glBindTexture(GL_TEXTURE_2D, textureID);
+              glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, screenWidth, screenHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, framebuffer);
+          }
 
           // Render the texture with Image()
           ImGui::Image(reinterpret_cast<ImTextureID>(reinterpret_cast<void *>(static_cast<intptr_t>(textureID))), ImVec2(renderWidth, renderHeight)); // Render the texture with the NES screen size
@@ -279,17 +389,68 @@ int main(int, char**)
           ImGui::BeginMainMenuBar();
           if (ImGui::BeginMenu("File")) {
               if (ImGui::MenuItem("Load ROM")) {
-                  nes.on = false;
                   auto selection = pfd::open_file("NES files", std::filesystem::current_path().string(), {"NES Files", "*.nes"}).result();
                   if (!selection.empty()) {
-                      nes.load_rom(selection[0].c_str());
+                      emulator.load(selection[0]);
+                  }
+              }
+              ImGui::MenuItem("ROM Library", nullptr, &showLibrary);
+              ImGui::Separator();
+              // Recordings start from the current state and are saved when recording stops
+              bool movieActive = frame.moviePlaying || frame.movieRecording;
+              if (ImGui::MenuItem(frame.movieRecording ? "Stop Recording" : "Record Movie...", nullptr, false,
+                                  !frame.moviePlaying)) {
+                  if (frame.movieRecording) {
+                      emulator.stopMovie();
+                  } else {
+                      std::string path = pfd::save_file("Record movie", "input.nesm", {"Movies", "*.nesm"}).result();
+                      if (!path.empty()) {
+                          emulator.recordMovie(path);
+                      }
+                  }
+              }
+              if (ImGui::MenuItem(frame.moviePlaying ? "Stop Movie" : "Play Movie...", nullptr, false, !frame.movieRecording)) {
+                  if (movieActive) {
+                      emulator.stopMovie();
+                  } else {
+                      auto selection = pfd::open_file("Play movie", std::filesystem::current_path().string(),
+                                                      {"Movies", "*.nesm *.fm2"}).result();
+                      if (!selection.empty()) {
+                          emulator.playMovie(selection[0]);
+                      }
                   }
-                  nes.initNES();
               }
               ImGui::EndMenu();
           }
           if (ImGui::BeginMenu("Debug")) {
               ImGui::MenuItem("Show Debug Window", nullptr, &showDebug);
+              // Only builds with NES_TRACE have the CPU hook
+              if (ImGui::MenuItem(tracing ? "Stop CPU Trace" : "CPU Trace...", nullptr, false, TraceLog::compiledIn())) {
+                  if (tracing) {
+                      emulator.stopTrace();
+                      tracing = false;
+                  } else {
+                      std::string path = pfd::save_file("CPU trace", "cpu.trace", {"Trace Files", "*.trace"}).result();
+                      if (!path.empty()) {
+                          emulator.startTrace(path);
+                          tracing = true;
+                      }
+                  }
+              }
+              // Game code profile: a sorted report, plus collapsed stacks (.folded) for flame graphs
+              if (ImGui::MenuItem(profiling ? "Stop Guest Profile..." : "Guest Profile", nullptr, false,
+                                  GuestProfiler::compiledIn())) {
+                  if (profiling) {
+                      std::string path = pfd::save_file("Guest profile report", "profile.txt", {"Text Files", "*.txt"}).result();
+                      if (!path.empty()) {
+                          emulator.stopProfile(path);
+                          profiling = false;
+                      }
+                  } else {
+                      emulator.startProfile();
+                      profiling = true;
+                  }
+              }
               ImGui::EndMenu();
           }
           ImGui::EndMainMenuBar();
@@ -299,70 +460,252 @@ int main(int, char**)
               ImGui::Begin("Debug");
               // Pause button
               if (ImGui::Button("PAUSE")) {
-                  nes.end();
-                  nes.paused = true;
+                  emulator.pause();
               }
 
               // Continue button
               ImGui::SameLine();
               if (ImGui::Button("CONTINUE")) {
-                  nes.paused = false;
-                  nes.on = true;
+                  emulator.resume();
               }
 
-              // Cycle button
+              // Cycle button, runs a single frame while paused
               ImGui::SameLine();
               if (ImGui::Button("CYCLE")) {
-                  if (nes.on == false) {
-                      nes.on = true;
-                      nes.cycle();
-                      //nes.RandomizeFramebuffer();
-                      // if (nes.A_changed == true) {
-                      //     R = rand() / (float)RAND_MAX;
-                      //     G = rand() / (float)RAND_MAX;
-                      //     B = rand() / (float)RAND_MAX;
-                      // }
-                      nes.on = false;
-                  }
+                  emulator.step();
+              }
+
+              // Reset button
+              ImGui::SameLine();
+              if (ImGui::Button("RESET")) {
+                  emulator.reset();
+              }
+
+              // Turbo: uncapped speed, only every Nth frame is composed and shown
+              static bool turbo = false;
+              static int presentEvery = 4;
+              bool turboChanged = ImGui::Checkbox("TURBO", &turbo);
+              ImGui::SameLine();
+              turboChanged |= ImGui::SliderInt("Show every Nth frame", &presentEvery, 1, 16);
+              if (turboChanged) {
+                  emulator.setTurbo(turbo ? presentEvery : 0);
+              }
+
+              ImGui::Text("Emulation: %s  %.1f fps (x%.2f)  UI: %.1f fps", emulator.isPaused() ? "paused" : "running",
+                          emulator.emulatedFps(), emulator.speedMultiplier(), io.Framerate);
+
+              // Run-ahead: show the game N frames ahead to hide its input lag, costs N extra frames per frame
+              static int runAhead = 0;
+              if (ImGui::SliderInt("Run-ahead frames", &runAhead, 0, 4)) {
+                  emulator.setRunAhead(runAhead);
+              }
+              ImGui::Text("Core headroom: x%.1f real time (run-ahead up to %d frames)", emulator.headroom(), emulator.maxRunAhead());
+
+              // Rewind history (hold Backspace)
+              ImGui::Text("Rewind: %s  %.1f s  %.2f MB  (%.1fx compression)", frame.rewinding ? "rewinding" : "recording",
+                          frame.rewindSeconds, frame.rewindBytes / (1024.0 * 1024.0),
+                          frame.rewindBytes ? static_cast<double>(frame.rewindRawBytes) / frame.rewindBytes : 0.0);
+
+              if (frame.moviePlaying || frame.movieRecording) {
+                  ImGui::Text("Movie: %s  frame %zu / %zu", frame.moviePlaying ? "playing" : "recording", frame.movieFrame,
+                              frame.moviePlaying ? frame.movieLength : frame.movieFrame);
               }
 
               // Display registers and buttons
               ImGui::Text("Registers      Buttons");
               //ImGui::TextColored(ImVec4(R, G, B, 1.0f), "A: [%02x]", nes.cpu.A);
-              ImGui::Text("A:    [%02x]     A:      [%01x]", nes.cpu.A, nes.bus.controller1.a);
-              ImGui::Text("X:    [%02x]     B:      [%01x]", nes.cpu.X, nes.bus.controller1.b);
-              ImGui::Text("Y:    [%02x]     Select: [%01x]", nes.cpu.Y, nes.bus.controller1.select);
-              ImGui::Text("PC: [%04x]     Start:  [%01x]", nes.cpu.PC, nes.bus.controller1.start);
-              ImGui::Text("S:  [%04x]     Up:     [%01x]", nes.cpu.S, nes.bus.controller1.up);
-              ImGui::Text("P:  [%04x]     Down:   [%01x]", nes.cpu.P, nes.bus.controller1.down);
-              ImGui::Text("               Left:   [%01x]", nes.bus.controller1.left);
-              ImGui::Text("               Right:  [%01x]", nes.bus.controller1.right);
+              Bus::controller buttons{};
+              buttons.reg = frame.controller;
+              ImGui::Text("A:    [%02x]     A:      [%01x]", frame.A, buttons.a);
+              ImGui::Text("X:    [%02x]     B:      [%01x]", frame.X, buttons.b);
+              ImGui::Text("Y:    [%02x]     Select: [%01x]", frame.Y, buttons.select);
+              ImGui::Text("PC: [%04x]     Start:  [%01x]", frame.PC, buttons.start);
+              ImGui::Text("S:  [%04x]     Up:     [%01x]", frame.S, buttons.up);
+              ImGui::Text("P:  [%04x]     Down:   [%01x]", frame.P, buttons.down);
+              ImGui::Text("               Left:   [%01x]", buttons.left);
+              ImGui::Text("               Right:  [%01x]", buttons.right);
+
+              // Breakpoints: the emulation thread pauses where one hits, CONTINUE / CYCLE carry on
+              static uint16_t breakAddress = 0;
+              static bool breakExecute = true, breakRead = false, breakWrite = false;
+              static std::vector<std::pair<uint16_t, uint8_t>> breakpoints;    // What the thread was sent
+              ImGui::InputScalar("Address", ImGuiDataType_U16, &breakAddress, nullptr, nullptr, "%04X",
+                                 ImGuiInputTextFlags_CharsHexadecimal);
+              ImGui::Checkbox("Exec", &breakExecute);
+              ImGui::SameLine();
+              ImGui::Checkbox("Read", &breakRead);
+              ImGui::SameLine();
+              ImGui::Checkbox("Write", &breakWrite);
+              ImGui::SameLine();
+              if (ImGui::Button("Set")) {
+                  uint8_t kinds = (breakExecute ? Debugger::EXECUTE : 0) | (breakRead ? Debugger::READ : 0) |
+                                  (breakWrite ? Debugger::WRITE : 0);
+                  emulator.setBreakpoint(breakAddress, kinds);
+                  breakpoints.erase(std::remove_if(breakpoints.begin(), breakpoints.end(),
+                                                   [](const auto& point) { return point.first == breakAddress; }),
+                                    breakpoints.end());
+                  if (kinds != 0) {
+                      breakpoints.emplace_back(breakAddress, kinds);
+                  }
+              }
+              ImGui::SameLine();
+              if (ImGui::Button("Clear all")) {
+                  emulator.clearBreakpoints();
+                  breakpoints.clear();
+              }
+              for (const auto& point : breakpoints) {
+                  ImGui::Text("$%04X %s%s%s", point.first, point.second & Debugger::EXECUTE ? "X" : "-",
+                              point.second & Debugger::READ ? "R" : "-", point.second & Debugger::WRITE ? "W" : "-");
+              }
+              static int breakScanline = 241, breakDot = 1;
+              ImGui::InputInt("Scanline", &breakScanline);
+              ImGui::InputInt("Dot", &breakDot);
+              if (ImGui::Button("Break at scanline / dot")) {
+                  emulator.addPpuBreakpoint(breakScanline, breakDot);
+              }
+
+              // Run until: PC = address, address holds a value, or N more frames
+              static uint8_t untilValue = 0;
+              static int untilFrames = 60;
+              if (ImGui::Button("Run to PC = address")) {
+                  emulator.runUntilPC(breakAddress);
+              }
+              ImGui::InputScalar("Value", ImGuiDataType_U8, &untilValue, nullptr, nullptr, "%02X",
+                                 ImGuiInputTextFlags_CharsHexadecimal);
+              ImGui::SameLine();
+              if (ImGui::Button("Run until address holds value")) {
+                  emulator.runUntilValue(breakAddress, untilValue);
+              }
+              ImGui::InputInt("Frames", &untilFrames);
+              ImGui::SameLine();
+              if (ImGui::Button("Run frames")) {
+                  emulator.runFrames(untilFrames);
+              }
+
+              const char* stopReasons[] = {"", "breakpoint", "read", "write", "PPU dot", "PC reached", "value reached",
+                                           "frames done", "frame limit"};
+              const Debugger::Stop& stop = frame.stop;
+              if (stop.reason != Debugger::Reason::NONE) {
+                  ImGui::Text("Stopped: %s at PC $%04X  ($%04X = %02X)  scanline %d dot %d frame %u",
+                              stopReasons[static_cast<int>(stop.reason)], stop.pc, stop.address, stop.value, stop.scanline,
+                              stop.dot, stop.frame);
+              }
+
+              // What the game made the machine do last frame
+              const PerfCounters& counters = frame.counters;
+              ImGui::Text("CPU: %llu cycles  %llu instructions", static_cast<unsigned long long>(counters.cpuCycles),
+                          static_cast<unsigned long long>(counters.instructions));
+              ImGui::Text("OAM DMA: %llu (%llu stall cycles)  NMI: %llu  IRQ: %llu  Bank switches: %llu",
+                          static_cast<unsigned long long>(counters.dmaTransfers), static_cast<unsigned long long>(counters.dmaStallCycles),
+                          static_cast<unsigned long long>(counters.nmis), static_cast<unsigned long long>(counters.irqs),
+                          static_cast<unsigned long long>(counters.bankSwitches));
+              ImGui::Text("PPU writes: %llu on %d visible lines  $2002 polls: %llu", static_cast<unsigned long long>(counters.ppuWrites),
+                          counters.scanlinesWithWrites(), static_cast<unsigned long long>(counters.statusPolls));
+              float writesByScanline[PerfCounters::SCANLINES];
+              std::copy(std::begin(counters.ppuWritesByScanline), std::end(counters.ppuWritesByScanline), writesByScanline);
+              ImGui::PlotHistogram("PPU writes by scanline", writesByScanline, PerfCounters::SCANLINES, 0, nullptr, 0.0f,
+                                   FLT_MAX, ImVec2(0, 60));
+
+              // Resampler quality for the CPU rate -> device rate audio conversion
+              static int audioQuality = Resampler::MEDIUM;
+              const char* audioQualities[] = {"Low", "Medium", "High"};
+              if (ImGui::Combo("Audio quality", &audioQuality, audioQualities, 3)) {
+                  emulator.post({EmulationThread::CommandType::AUDIO_QUALITY, "", audioQuality});
+              }
+
+              // Host time per frame by zone (make ZONES=1)
+              if (HostZones::compiledIn()) {
+                  drawFrameTimes(HostZones::EMULATION);
+                  drawFrameTimes(HostZones::UI);
+                  if (ImGui::Button("Export Chrome Trace...")) {
+                      std::string path = pfd::save_file("Chrome trace", "frames.json", {"JSON Files", "*.json"}).result();
+                      if (!path.empty()) {
+                          std::ofstream out(path);
+                          HostZones::writeChromeTrace(out);
+                      }
+                  }
+              }
 
               ImGui::End();
           }
 
-        // Cycle the NES
-                if (nes.on == true && nes.rom_loaded == true && nes.paused == false) {
-                    //nes.RandomizeFramebuffer();
-                    nes.cycle();
+          if (showLibrary) {
+              ImGui::Begin("ROM Library", &showLibrary);
+              bool scanning = libraryScan.valid();
+              if (scanning && libraryScan.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+                  library = libraryScan.get();
+                  scanning = false;
+              }
 
-                    // Get the NES framebuffer (assuming it returns 32-bit RGBA data)
-                    uint32_t* pixels = nes.getFramebuffer();
-                }
+              if (ImGui::Button("Choose Folder") && !scanning) {
+                  std::string folder = pfd::select_folder("ROM folder", std::filesystem::current_path().string()).result();
+                  if (!folder.empty()) {
+                      library = RomLibrary();
+                      startLibraryScan(folder);
+                  }
+              }
+              ImGui::SameLine();
+              if (ImGui::Button("Rescan") && !scanning && !libraryDir.empty()) {
+                  startLibraryScan(libraryDir);
+              }
+              ImGui::SameLine();
+              ImGui::Text(scanning ? "Scanning %s..." : "%s", libraryDir.empty() ? "(no folder)" : libraryDir.c_str());
+
+              static char filter[128] = "";
+              ImGui::InputText("Filter", filter, sizeof(filter));
+
+              if (ImGui::BeginTable("roms", 4, ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY | ImGuiTableFlags_Resizable)) {
+                  ImGui::TableSetupColumn("Name");
+                  ImGui::TableSetupColumn("Mapper");
+                  ImGui::TableSetupColumn("PRG/CHR KB");
+                  ImGui::TableSetupColumn("CRC32");
+                  ImGui::TableHeadersRow();
+                  for (const RomEntry& rom : library.entries()) {
+                      std::string name = std::filesystem::path(rom.path).filename().string();
+                      if (filter[0] != '\0' && name.find(filter) == std::string::npos) {
+                          continue;
+                      }
+                      ImGui::TableNextRow();
+                      ImGui::TableNextColumn();
+                      if (ImGui::Selectable(name.c_str(), false, ImGuiSelectableFlags_SpanAllColumns) && rom.valid) {
+                          emulator.load(rom.path);
+                      }
+                      ImGui::TableNextColumn();
+                      if (rom.valid) {
+                          ImGui::Text("%d", rom.info.mapper);
+                          ImGui::TableNextColumn();
+                          ImGui::Text("%zu / %zu", rom.info.prgRomBytes / 1024, rom.info.chrRomBytes / 1024);
+                          ImGui::TableNextColumn();
+                          ImGui::Text("%08X", rom.crc32);
+                      } else {
+                          ImGui::TextDisabled("invalid");
+                      }
+                  }
+                  ImGui::EndTable();
+              }
+              ImGui::End();
+          }
 
         // Rendering
-        ImGui::Render();
-        glViewport(0, 0, (int)io.DisplaySize.x, (int)io.DisplaySize.y);
-        glClearColor(clear_color.x * clear_color.w, clear_color.y * clear_color.w, clear_color.z * clear_color.w, clear_color.w);
-        glClear(GL_COLOR_BUFFER_BIT);
-        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
-        SDL_GL_SwapWindow(window);
+        {
+            NES_ZONE(UI_RENDER);
+            ImGui::Render();
+            glViewport(0, 0, (int)io.DisplaySize.x, (int)io.DisplaySize.y);
+            glClearColor(clear_color.x * clear_color.w, clear_color.y * clear_color.w, clear_color.z * clear_color.w, clear_color.w);
+            glClear(GL_COLOR_BUFFER_BIT);
+            ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        }
+        {
+            NES_ZONE(UI_PRESENT);
+            SDL_GL_SwapWindow(window);
+        }
     }
 #ifdef __EMSCRIPTEN__
     EMSCRIPTEN_MAINLOOP_END;
 #endif
 
     // Cleanup
+    emulator.stop();
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplSDL2_Shutdown();
     ImGui::DestroyContext();
@@ -45,6 +45,31 @@ int main(int argc, char* argv[]) {
 	tests.test_PPU_registers();
 	tests.test_pattern_tables(testPath);
 	tests.test_Pulse1();
+	tests.test_resampler();
+	tests.test_save_state(testPath);
+	tests.test_rewind(testPath);
+	tests.test_run_ahead(testPath);
+	tests.test_hash();
+	tests.test_thread_pool();
+	tests.test_chr_banks(testPath);
+	tests.test_rom_loading(testPath);
+	tests.test_library(testPath);
+	tests.test_UNROM();
+	tests.test_MMC1();
+	tests.test_CNROM();
+	tests.test_AxROM();
+	tests.test_GxROM();
+	tests.test_MMC3();
+	tests.test_save_ram();
+	tests.test_trace();
+	tests.test_json();
+	tests.test_movie();
+	tests.test_guest_profiler();
+	tests.test_host_zones();
+	tests.test_perf_counters(testPath);
+	tests.test_log();
+	tests.test_debugger(testPath);
+	tests.test_skip_frame(testPath);
 
     return 0;
 }
@@ -3,6 +3,7 @@
 #include <cstdint>
 #include <cstring>		// for memcpy
 #include "ROM.h"
+#include "../Log.h"
 
 
 // Destructor to clean up allocated memory
@@ -180,7 +181,7 @@ void NESROM::printHeaderInfo(const NESHeader& header) {
 void NESROM::switchBank(uint8_t bankNumber) {
 	if (bankNumber < prgBanks.size()) {
         curBank = bankNumber;
-        std::cout << "Switched to bank: " << (int)bankNumber << "\n";
+        NES_LOG_TRACE("Switched to bank %d", bankNumber);
     } else {
         std::cerr << "Invalid bank switch: " << (int)bankNumber << "\n";
     }
@@ -3,7 +3,7 @@
 void Tests::test_cpu() {
 	std::cout << "\nCPU Tests:\n";
 	NES nes;
-	CPU& cpu = *nes.bus.cpu;
+	CPU& cpu = nes.cpu;
 
 	// Check start up values
 	cpu.printRegisters();
@@ -39,7 +39,7 @@ void Tests::test_cpu() {
 void Tests::test_opcodes() {
 	std::cout << "---------------------------\nOpcode Tests:\n\n";
 	NES nes;
-	CPU& cpu = *nes.bus.cpu;
+	CPU& cpu = nes.cpu;
 
 	// Test Program
 	cpu.writeBus(0x00, 0xA9); // LDA Immediate AA
@@ -101,7 +101,7 @@ void Tests::test_opcodes() {
 void Tests::test_ADC() {
 	std::cout << "---------------------------\nADC Tests:\n\n";
 	NES nes;
-	CPU& cpu = *nes.bus.cpu;
+	CPU& cpu = nes.cpu;
 
 	// Test Program
 	cpu.writeBus(0x00, 0x69); // Load 5
@@ -176,7 +176,7 @@ void Tests::test_ADC() {
 //----------------------------------------------------------------------------------------------------------------------------
 void Tests::test_stack() {
 	NES nes;
-	CPU& cpu = *nes.bus.cpu;
+	CPU& cpu = nes.cpu;
 
 	uint16_t starting_stack_address = 0x0100 + cpu.S;
 	cpu.stack_push(0xBC);
@@ -204,7 +204,7 @@ void Tests::test_stack() {
 void Tests::test_reset() {
 	NES nes;
 
-	CPU& cpu = *nes.bus.cpu;
+	CPU& cpu = nes.cpu;
 
 	std::cout << "Test setup: PC = " << std::hex << cpu.PC << "\n";
 
@@ -240,7 +240,7 @@ void Tests::test_reset() {
 void Tests::test_nmi() {
 	std::cout << ">>> test_nmi() starting\n";
 	NES nes;
-	CPU& cpu = *nes.bus.cpu;
+	CPU& cpu = nes.cpu;
 
 	uint8_t starting_stack_address = 0x0100 + cpu.S;
 	cpu.nmi_interrupt();
@@ -266,7 +266,7 @@ void Tests::test_nmi() {
 void Tests::test_irq() {
 	std::cout << ">>> test_irq() starting\n";
 	NES nes;
-	CPU& cpu = *nes.bus.cpu;
+	CPU& cpu = nes.cpu;
 
 	// Set flag so interrupt will work
 	cpu.setFlag(CPU::FLAGS::I, false);
@@ -296,7 +296,7 @@ void Tests::test_irq() {
 //----------------------------------------------------------------------------------------------------------------------------
 void Tests::test_jmp() {
 	NES nes;
-	CPU& cpu = *nes.bus.cpu;
+	CPU& cpu = nes.cpu;
 	cpu.reset();
 	uint16_t test_memory = 0xFFFF;
 
@@ -341,7 +341,7 @@ void Tests::test_jmp() {
 //----------------------------------------------------------------------------------------------------------------------------
 void Tests::test_stack_instructions() {
 	NES nes;
-	CPU& cpu = *nes.bus.cpu;
+	CPU& cpu = nes.cpu;
 	cpu.reset();
 	uint16_t test_memory = 0xFFFF;
 	cpu.A = 0x34;
@@ -360,7 +360,7 @@ void Tests::test_stack_instructions() {
 //----------------------------------------------------------------------------------------------------------------------------
 void Tests::test_branch() {
 	NES nes;
-	CPU& cpu = *nes.bus.cpu;
+	CPU& cpu = nes.cpu;
 
 	uint16_t test_memory = 0x0000;
 	cpu.writeBus(test_memory, 0x79);
@@ -418,7 +418,7 @@ void Tests::test_branch() {
 //----------------------------------------------------------------------------------------------------------------------------
 void Tests::test_ASL() {
 	NES nes;
-	CPU& cpu = *nes.bus.cpu;
+	CPU& cpu = nes.cpu;
     cpu.reset();
 
     // Accumulator loaded with 25, ASL executed, accumulator should now hold 50
@@ -447,7 +447,7 @@ void Tests::test_ASL() {
 //----------------------------------------------------------------------------------------------------------------------------
 void Tests::test_LSR() {
 	NES nes;
-	CPU& cpu = *nes.bus.cpu;
+	CPU& cpu = nes.cpu;
     cpu.reset();
 
     // Accumulator loaded with 144, LSR executed, accumulator should now hold 72
@@ -470,7 +470,7 @@ void Tests::test_LSR() {
 //----------------------------------------------------------------------------------------------------------------------------
 void Tests::test_ROL() {
 	NES nes;
-	CPU& cpu = *nes.bus.cpu;
+	CPU& cpu = nes.cpu;
     cpu.reset();
 
     // Accumulator loaded with 25, ROL executed, accumulator should now hold 50
@@ -502,7 +502,7 @@ void Tests::test_ROL() {
 //----------------------------------------------------------------------------------------------------------------------------
 void Tests::test_ROR() {
 	NES nes;
-	CPU& cpu = *nes.bus.cpu;
+	CPU& cpu = nes.cpu;
     cpu.reset();
 
     // Accumulator loaded with 1, ROR executed, accumulator should now hold 0
@@ -534,7 +534,7 @@ void Tests::test_ROR() {
 //----------------------------------------------------------------------------------------------------------------------------
 void Tests::test_CMP() {
 	NES nes;
-	CPU& cpu = *nes.bus.cpu;
+	CPU& cpu = nes.cpu;
     cpu.reset();
 
     // Accumulator loaded with 144, address loaded with 80, CMP executed, Carry flag should be set
@@ -560,7 +560,7 @@ void Tests::test_CMP() {
 //----------------------------------------------------------------------------------------------------------------------------
 void Tests::test_CPX() {
 	NES nes;
-	CPU& cpu = *nes.bus.cpu;
+	CPU& cpu = nes.cpu;
     cpu.reset();
 
     // X register loaded with 144, address loaded with 80, CPX executed, Carry flag should be set
@@ -586,7 +586,7 @@ void Tests::test_CPX() {
 //----------------------------------------------------------------------------------------------------------------------------
 void Tests::test_CPY() {
 	NES nes;
-	CPU& cpu = *nes.bus.cpu;
+	CPU& cpu = nes.cpu;
     cpu.reset();
 
     // Y register loaded with 144, address loaded with 80, CPY executed, Carry flag should be set
@@ -612,7 +612,7 @@ void Tests::test_CPY() {
 //----------------------------------------------------------------------------------------------------------------------------
 void Tests::test_CLD_SED_CLV() {
 	NES nes;
-	CPU& cpu = *nes.bus.cpu;
+	CPU& cpu = nes.cpu;
     cpu.reset();
 
     cpu.writeBus(0x00, 0xF8); // SED
@@ -634,10 +634,6 @@ void Tests::test_CLD_SED_CLV() {
 void Tests::test_NES(std::string path) {
 	NES nes;
 
-	// Connect CPU to the bus
-	nes.bus.cpu = &nes.cpu;
-	nes.cpu.connectBus(&nes.bus);
-
 	// Load ROM
 	nes.load_rom(path.c_str()); // Current test rom is ./nestest.nes
 	nes.rom.printHeaderInfo(nes.rom.ROMheader);
@@ -648,8 +644,8 @@ void Tests::test_NES(std::string path) {
 
 	// DEBUG: Verify connections right after initNES()
 	std::cout << "initNES() finished\n";
-	if (nes.bus.cpu == nullptr) {
-		std::cerr << "ERROR: nes.bus.cpu is NULL after initNES()\n";
+	if (&nes.bus.cpu != &nes.cpu) {
+		std::cerr << "ERROR: nes.bus is not wired to nes.cpu\n";
 		return;
 	}
 	try {
@@ -697,8 +693,8 @@ void Tests::test_NES(std::string path) {
 
 void Tests::test_Bus() {
 
-	Bus bus;
-	CPU& cpu = *bus.cpu;
+	NES nes;
+	CPU& cpu = nes.cpu;
 
 	cpu.reset();
 	cpu.writeBus(0x0000, 0xFF);
@@ -708,8 +704,9 @@ void Tests::test_Bus() {
 }
 
 void Tests::test_PPU_registers() {
-	Bus bus;
-	CPU& cpu = *bus.cpu;
+	NES nes;
+	Bus& bus = nes.bus;
+	CPU& cpu = nes.cpu;
 	// Write to PPUCTRL
 	cpu.writeBus(0x2000, 0xC2);
 
@@ -744,3 +741,1336 @@ void Tests::test_Pulse1() {
     std::cout << "Starting Pulse 1 test...\n";
     std::cout << "Pulse 1 test completed.\n";
 }
+
+void Tests::test_resampler() {
+	std::cout << "---------------------------\nResampler Tests:\n\n";
+	const double cpuRate = 1789773.0;
+	const int block = 1024;
+
+	for (int q = Resampler::LOW; q <= Resampler::HIGH; q++) {
+		for (int i = Resampler::SCALAR; i <= Resampler::bestIsa(); i++) {
+			Resampler resampler(cpuRate, 44100.0, static_cast<Resampler::Quality>(q));
+			resampler.setIsa(static_cast<Resampler::Isa>(i));
+			std::vector<float> in(block);
+			std::vector<float> out(resampler.maxOutputFor(block));
+
+			// DC passes with unity gain once the filter history is full
+			std::fill(in.begin(), in.end(), 0.3f);
+			int produced = 0;
+			for (int b = 0; b < 64; b++) {
+				produced = resampler.process(in.data(), block, out.data(), static_cast<int>(out.size()));
+			}
+			assert(produced > 0);
+			assert(std::fabs(out[produced - 1] - 0.3f) < 1e-3f);
+
+			// A 1 kHz tone keeps its amplitude, a 40 kHz tone (above the output Nyquist) is removed
+			auto peakFor = [&](double frequency) {
+				resampler.reset();
+				float peak = 0.0f;
+				long long n = 0;
+				for (int b = 0; b < 256; b++) {
+					for (int k = 0; k < block; k++, n++) {
+						in[k] = static_cast<float>(std::sin(2.0 * 3.14159265358979 * frequency * n / cpuRate));
+					}
+					produced = resampler.process(in.data(), block, out.data(), static_cast<int>(out.size()));
+					// Skip the start-up transient
+					for (int k = 0; b > 32 && k < produced; k++) {
+						peak = std::max(peak, std::fabs(out[k]));
+					}
+				}
+				return peak;
+			};
+			assert(std::fabs(peakFor(1000.0) - 1.0f) < 0.01f);
+			assert(peakFor(40000.0) < 0.01f);
+
+			printf("   %s / %s good\n", Resampler::qualityName(resampler.getQuality()), Resampler::isaName(resampler.getIsa()));
+		}
+	}
+
+	std::cout << "Resampler tests passed!\n";
+}
+
+void Tests::test_save_state(std::string path) {
+	std::cout << "---------------------------\nSave State Tests:\n\n";
+	NES nes;
+	nes.load_rom(path.c_str());
+	nes.initNES();
+	for (int i = 0; i < 30; i++) {
+		nes.run_frame();
+	}
+
+	// Play a fixed input sequence, remembering where the machine ends up
+	auto play = [&]() {
+		for (int i = 0; i < 60; i++) {
+			nes.bus.controller1.reg = static_cast<uint8_t>((i / 8) & 0x0F);
+			nes.run_frame();
+		}
+	};
+
+	std::vector<uint8_t> snapshot;
+	nes.saveState(snapshot);
+	assert(!snapshot.empty());
+
+	play();
+	std::vector<uint8_t> expected;
+	nes.saveState(expected);
+	std::vector<uint8_t> expectedFrame(nes.bus.ppu.framebuffer, nes.bus.ppu.framebuffer + 256 * 240);
+
+	// Loading and replaying the same input has to land in exactly the same state
+	assert(nes.loadState(snapshot));
+	play();
+	std::vector<uint8_t> replayed;
+	nes.saveState(replayed);
+	assert(replayed == expected);
+	assert(std::equal(expectedFrame.begin(), expectedFrame.end(), nes.bus.ppu.framebuffer));
+	printf("   replay after load good (%zu bytes per state)\n", snapshot.size());
+
+	// Blobs from another version or truncated blobs are rejected without touching the machine
+	std::vector<uint8_t> bad = snapshot;
+	bad[4]++;
+	assert(!nes.loadState(bad));
+	bad = snapshot;
+	bad.pop_back();
+	assert(!nes.loadState(bad));
+	nes.saveState(replayed);
+	assert(replayed == expected);
+	std::cout << "   bad states rejected\n";
+
+	std::cout << "Save state tests passed!\n";
+}
+
+void Tests::test_rewind(std::string path) {
+	std::cout << "---------------------------\nRewind Tests:\n\n";
+	NES nes;
+	nes.load_rom(path.c_str());
+	nes.initNES();
+
+	// Record 300 frames, keeping raw copies to compare against
+	RewindBuffer rewind;
+	std::vector<std::vector<uint8_t>> states;
+	std::vector<uint8_t> state;
+	for (int i = 0; i < 300; i++) {
+		nes.bus.controller1.reg = static_cast<uint8_t>((i / 16) & 0x0F);
+		nes.run_frame();
+		nes.saveState(state);
+		rewind.push(state);
+		states.push_back(state);
+	}
+	assert(rewind.size() == states.size());
+	assert(rewind.compressionRatio() > 4.0);
+	printf("   %zu states in %zu bytes (%.1fx)\n", rewind.size(), rewind.memoryUsed(), rewind.compressionRatio());
+
+	// Every state comes back exactly, newest to oldest
+	for (size_t i = states.size() - 1; i > 0; i--) {
+		assert(rewind.pop(state));
+		assert(state == states[i - 1]);
+	}
+	assert(!rewind.pop(state));
+	assert(rewind.size() == 1);
+	std::cout << "   rewound to the first state\n";
+
+	// Recording continues from a rewound state, a small ring drops the oldest states
+	RewindBuffer small(4096, 1000);
+	for (const std::vector<uint8_t>& s : states) {
+		small.push(s);
+	}
+	assert(small.size() > 1 && small.size() < states.size());
+	assert(small.memoryUsed() <= 4096 + states[0].size());
+	size_t kept = small.size();
+	for (size_t i = 1; i < kept; i++) {
+		assert(small.pop(state));
+		assert(state == states[states.size() - 1 - i]);
+	}
+	printf("   4 KB ring kept the newest %zu states\n", kept);
+
+	std::cout << "Rewind tests passed!\n";
+}
+
+// Room for a machine. buildOnUsedMemory() runs one there and destroys it before building the one it
+// returns, so state the constructor or initNES() leaves alone starts from leftover bytes instead of
+// fresh zeroed pages. The caller destroys the machine.
+struct alignas(NES) UsedMemory {
+	unsigned char bytes[sizeof(NES)];
+};
+
+static NES& buildOnUsedMemory(UsedMemory& storage, const std::string& path) {
+	NES* used = new (&storage) NES(false);
+	used->load_rom(path.c_str());
+	used->initNES();
+	for (int i = 0; i < 30; i++) {
+		used->bus.controller1.reg = 0xFF;
+		used->run_frame();
+	}
+	used->~NES();
+	NES* machine = new (&storage) NES(false);
+	machine->load_rom(path.c_str());
+	machine->initNES();
+	return *machine;
+}
+
+void Tests::test_run_ahead(std::string path) {
+	std::cout << "---------------------------\nRun-ahead Tests:\n\n";
+	NES plain;
+	plain.load_rom(path.c_str());
+	plain.initNES();
+
+	std::unique_ptr<UsedMemory> storage(new UsedMemory);
+	NES& ahead = buildOnUsedMemory(*storage, path);
+
+	// Running ahead never changes where the game really is
+	std::vector<uint8_t> plainState, aheadState;
+	for (int i = 0; i < 120; i++) {
+		uint8_t buttons = static_cast<uint8_t>((i / 16) & 0x0F);
+		plain.bus.controller1.reg = buttons;
+		plain.run_frame();
+		ahead.bus.controller1.reg = buttons;
+		ahead.run_ahead(2);
+	}
+	plain.saveState(plainState);
+	ahead.saveState(aheadState);
+	assert(plainState == aheadState);
+	std::cout << "   real state unchanged by run-ahead\n";
+
+	// With the input held, the picture shown is the one the game draws two frames later
+	ahead.run_ahead(2);
+	for (int i = 0; i < 3; i++) {
+		plain.run_frame();
+	}
+	assert(std::equal(plain.bus.ppu.framebuffer, plain.bus.ppu.framebuffer + 256 * 240, ahead.bus.ppu.framebuffer));
+	std::cout << "   shown frame is two frames ahead\n";
+	ahead.~NES();
+
+	std::cout << "Run-ahead tests passed!\n";
+}
+
+void Tests::test_hash() {
+	std::cout << "---------------------------\nHash Tests:\n\n";
+	// Reference values from the xxHash and CRC-32 specifications
+	const char* phrase = "Nobody inspects the spammish repetition";
+	assert(xxhash64("", 0) == 0xEF46DB3751D8E999ULL);
+	assert(xxhash64("abc", 3) == 0x44BC2CF5AD770999ULL);
+	assert(xxhash64(phrase, std::strlen(phrase)) == 0xFBCEA83C8A378BF1ULL);
+	assert(crc32("123456789", 9) == 0xCBF43926u);
+	assert(crc32("56789", 5, crc32("1234", 4)) == 0xCBF43926u);
+	assert(sha1Hex("", 0) == "da39a3ee5e6b4b0d3255bfef95601890afd80709");
+	assert(sha1Hex("abc", 3) == "a9993e364706816aba3e25717850c26c9cd0d89d");
+	const char* twoBlocks = "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+	assert(sha1Hex(twoBlocks, std::strlen(twoBlocks)) == "84983e441c3bd26ebaae4aa1f95129e5e54670f1");
+	std::cout << "Hash tests passed!\n";
+}
+
+void Tests::test_thread_pool() {
+	std::cout << "---------------------------\nThread Pool Tests:\n\n";
+	ThreadPool pool(4);
+	std::vector<int> results(1000, 0);
+	std::vector<int> ranOn(1000, -1);
+	for (int i = 0; i < 1000; i++) {
+		pool.submit([&, i](int worker) {
+			results[i] = i * 2;
+			ranOn[i] = worker;
+		});
+	}
+	pool.wait();
+	for (int i = 0; i < 1000; i++) {
+		assert(results[i] == i * 2);
+		assert(ranOn[i] >= 0 && ranOn[i] < pool.size());
+	}
+
+	// The pool is reusable after wait()
+	int count = 0;
+	std::mutex countMutex;
+	for (int i = 0; i < 10; i++) {
+		pool.submit([&](int) {
+			std::lock_guard<std::mutex> lock(countMutex);
+			count++;
+		});
+	}
+	pool.wait();
+	assert(count == 10);
+	std::cout << "Thread pool tests passed!\n";
+}
+
+void Tests::test_chr_banks(std::string path) {
+	std::cout << "---------------------------\nCHR Bank Tests:\n\n";
+
+	// Without a cartridge the PPU has writable CHR RAM
+	NES blank(false);
+	blank.bus.ppu.writePPU(0x1234, 0x5A);
+	assert(blank.bus.ppu.readPPU(0x1234) == 0x5A);
+	assert(blank.bus.ppu.chrRam[0x1234] == 0x5A);
+
+	// With CHR ROM the pattern tables are the cartridge's own bytes, and they are read only
+	NES nes(false);
+	assert(nes.load_rom(path.c_str()));
+	assert(nes.rom.chrRom != nullptr);
+	for (uint16_t addr = 0; addr < 0x2000; addr++) {
+		assert(nes.bus.ppu.readPPU(addr) == nes.rom.chrRom[addr]);
+	}
+	uint8_t before = nes.rom.chrRom[0x0010];
+	nes.bus.ppu.writePPU(0x0010, before ^ 0xFF);
+	assert(nes.rom.chrRom[0x0010] == before);
+	std::cout << "   CHR ROM mapped without a copy\n";
+
+	// Switching a 1 KB bank is a pointer write
+	nes.bus.ppu.mapCHR(0, nes.rom.chrRom + 0x1C00);
+	assert(nes.bus.ppu.readPPU(0x0005) == nes.rom.chrRom[0x1C05]);
+	assert(nes.bus.ppu.readPPU(0x0405) == nes.rom.chrRom[0x0405]);
+	std::cout << "   bank switch good\n";
+
+	std::cout << "CHR bank tests passed!\n";
+}
+
+void Tests::test_rom_loading(std::string path) {
+	std::cout << "---------------------------\nROM Loading Tests:\n\n";
+	std::ifstream in(path, std::ios::binary);
+	std::vector<uint8_t> contents((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	assert(contents.size() > 16);
+
+	// Regular files are mapped, and the view holds exactly the file's bytes
+	MappedFile file;
+	assert(file.open(path));
+	assert(file.size() == contents.size());
+	assert(std::memcmp(file.data(), contents.data(), contents.size()) == 0);
+#if defined(__unix__) || defined(__APPLE__)
+	assert(file.isMapped());
+#endif
+	file.assign(contents);
+	assert(!file.isMapped() && file.size() == contents.size());
+	assert(!file.open(path + ".missing") && file.size() == 0);
+
+	// PRG and CHR point into the image, right behind the header
+	NES nes(false);
+	assert(nes.load_rom(path.c_str()));
+	assert(std::memcmp(nes.rom.prgRom, contents.data() + 16, nes.rom.ROMheader.prgRomSize * 16 * 1024) == 0);
+	std::cout << "   ROM used in place\n";
+
+	// A file cut short is refused, and the cartridge loaded before stays usable
+	std::string truncated = "truncated_test.nes";
+	std::ofstream(truncated, std::ios::binary).write(reinterpret_cast<const char*>(contents.data()), contents.size() / 2);
+	NESROM rom;
+	assert(rom.load(path));
+	assert(!rom.load(truncated));
+	assert(rom.prgRom != nullptr && rom.prgRom[0] == contents[16]);
+	std::remove(truncated.c_str());
+	std::cout << "   truncated file rejected\n";
+
+	std::cout << "ROM loading tests passed!\n";
+}
+
+void Tests::test_library(std::string path) {
+	std::cout << "---------------------------\nROM Library Tests:\n\n";
+
+	// iNES: mapper from both flag nibbles; junk in the tail means flags7 cannot be trusted
+	NESHeader header{{'N', 'E', 'S', 0x1A}, 2, 1, 0x13, 0x40, 0, 0, 0, {0, 0, 0, 0, 0}};
+	CartridgeInfo info;
+	assert(parseCartridgeInfo(header, info));
+	assert(!info.nes2 && info.mapper == 0x41 && info.verticalMirroring && info.battery);
+	assert(info.prgRomBytes == 32 * 1024 && info.chrRomBytes == 8 * 1024 && info.dataOffset == 16);
+	std::memcpy(header.padding + 1, "Dude", 4);
+	assert(parseCartridgeInfo(header, info) && info.mapper == 0x01);
+
+	// NES 2.0: 12 bit mapper, submapper, size MSBs and exponent sizes, RAM shift counts
+	NESHeader nes2{{'N', 'E', 'S', 0x1A}, 0x02, 0x07, 0x44, 0x18, 0x31, 0xF1, 0x70, {0x07, 0, 0, 0, 0}};
+	assert(parseCartridgeInfo(nes2, info));
+	assert(info.nes2 && info.mapper == 0x114 && info.submapper == 3 && info.trainer && info.dataOffset == 16 + 512);
+	assert(info.prgRomBytes == 0x102 * 16 * 1024);
+	assert(info.chrRomBytes == (size_t(1) << 1) * 7);
+	assert(info.prgRamBytes == 8192 && info.chrRamBytes == 8192);
+	nes2.header[0] = 'X';
+	assert(!parseCartridgeInfo(nes2, info));
+	std::cout << "   headers parsed\n";
+
+	// Hashes cover PRG + CHR only
+	std::ifstream in(path, std::ios::binary);
+	std::vector<uint8_t> contents((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	RomEntry entry;
+	assert(RomLibrary::indexFile(path, entry));
+	assert(entry.crc32 == crc32(contents.data() + 16, contents.size() - 16));
+	assert(entry.sha1 == sha1Hex(contents.data() + 16, contents.size() - 16));
+
+	// A directory with one good ROM (upper case extension, in a subfolder) and one broken file
+	std::string dir = "library_test";
+	std::filesystem::remove_all(dir);
+	std::filesystem::create_directories(dir + "/sub");
+	std::filesystem::copy_file(path, dir + "/sub/Game.NES");
+	std::ofstream(dir + "/broken.nes") << "not a rom";
+	std::ofstream(dir + "/readme.txt") << "skipped";
+
+	ThreadPool pool(2);
+	RomLibrary library;
+	RomLibrary::ScanStats stats;
+	assert(library.scan(dir, pool, &stats));
+	assert(stats.files == 2 && stats.hashed == 2 && stats.reused == 0 && stats.invalid == 1);
+	const RomEntry* game = library.findByCrc32(entry.crc32);
+	assert(game != nullptr && game->path == dir + "/sub/Game.NES" && library.findByPath(game->path) == game);
+	std::string upper = entry.sha1;
+	std::transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
+	assert(library.findBySha1(upper) == game);
+
+	// The cache round trips, and a rescan from it reads nothing that did not change
+	std::string cache = dir + "/" + RomLibrary::CACHE_FILE;
+	assert(library.saveCache(cache));
+	RomLibrary reloaded;
+	assert(reloaded.loadCache(cache));
+	assert(reloaded.entries().size() == 2 && reloaded.findByCrc32(entry.crc32) != nullptr);
+	assert(reloaded.scan(dir, pool, &stats));
+	assert(stats.files == 2 && stats.hashed == 0 && stats.reused == 2);
+	assert(reloaded.findBySha1(entry.sha1)->path == game->path);
+	std::cout << "   rescan served from cache\n";
+
+	// A changed file is hashed again
+	std::ofstream(dir + "/broken.nes", std::ios::app) << "still not a rom";
+	assert(reloaded.scan(dir, pool, &stats));
+	assert(stats.hashed == 1 && stats.reused == 1);
+	std::filesystem::remove_all(dir);
+
+	std::cout << "ROM library tests passed!\n";
+}
+
+// Writes an iNES file for `mapper` in which every byte of 8 KB PRG bank n reads n and every byte
+// of 1 KB CHR bank n reads 0x80 + n, so a read tells which bank a window points at.
+static std::string writeMapperTestROM(const std::string& name, int mapper, int prg16K, int chr8K, uint8_t flags6 = 0) {
+	std::vector<uint8_t> file = {'N', 'E', 'S', 0x1A, static_cast<uint8_t>(prg16K), static_cast<uint8_t>(chr8K),
+								 static_cast<uint8_t>(((mapper & 0x0F) << 4) | flags6), static_cast<uint8_t>(mapper & 0xF0),
+								 0, 0, 0, 0, 0, 0, 0, 0};
+	for (int bank = 0; bank < prg16K * 2; bank++) {
+		file.insert(file.end(), 0x2000, static_cast<uint8_t>(bank));
+	}
+	for (int bank = 0; bank < chr8K * 8; bank++) {
+		file.insert(file.end(), 0x0400, static_cast<uint8_t>(0x80 + bank));
+	}
+	std::ofstream(name, std::ios::binary).write(reinterpret_cast<const char*>(file.data()), file.size());
+	return name;
+}
+
+// Sends one MMC1 register value, low bit first
+static void writeMMC1(Bus& bus, uint16_t address, uint8_t value) {
+	for (int bit = 0; bit < 5; bit++) {
+		bus.write(address, (value >> bit) & 1);
+	}
+}
+
+void Tests::test_UNROM() {
+	std::cout << "---------------------------\nUNROM Tests:\n\n";
+	std::string path = writeMapperTestROM("unrom_test.nes", 2, 8, 0, 0x01);
+	NES nes(false);
+	assert(nes.load_rom(path.c_str()));
+	assert(std::string(nes.rom.mapper->name()) == "UNROM");
+
+	// $C000 is the last 16 KB for good, $8000 follows the latch
+	assert(nes.bus.read(0x8000) == 0 && nes.bus.read(0xA000) == 1);
+	assert(nes.bus.read(0xC000) == 14 && nes.bus.read(0xFFFF) == 15);
+	nes.bus.write(0x8000, 5);
+	assert(nes.bus.read(0x8000) == 10 && nes.bus.read(0xBFFF) == 11 && nes.bus.read(0xC000) == 14);
+
+	// CHR RAM takes writes; vertical mirroring from the header
+	nes.bus.ppu.writePPU(0x1234, 0x5A);
+	assert(nes.bus.ppu.readPPU(0x1234) == 0x5A);
+	nes.bus.ppu.writePPU(0x2005, 0x77);
+	assert(nes.bus.ppu.readPPU(0x2805) == 0x77 && nes.bus.ppu.readPPU(0x2405) != 0x77);
+
+	// The bank survives a save state round trip
+	std::vector<uint8_t> state;
+	nes.saveState(state);
+	nes.bus.write(0x8000, 2);
+	assert(nes.loadState(state));
+	assert(nes.bus.read(0x8000) == 10);
+	std::remove(path.c_str());
+	std::cout << "UNROM tests passed!\n";
+}
+
+void Tests::test_MMC1() {
+	std::cout << "---------------------------\nMMC1 Tests:\n\n";
+	std::string path = writeMapperTestROM("mmc1_test.nes", 1, 8, 4);
+	NES nes(false);
+	assert(nes.load_rom(path.c_str()));
+	Bus& bus = nes.bus;
+	PPU& ppu = nes.bus.ppu;
+
+	// Power on: PRG mode 3, first bank at $8000, last bank fixed at $C000
+	assert(bus.read(0x8000) == 0 && bus.read(0xC000) == 14);
+
+	// Nothing changes until the fifth write, which lands in the register its address picks
+	for (int bit = 0; bit < 4; bit++) {
+		bus.write(0xE000, (3 >> bit) & 1);
+		assert(bus.read(0x8000) == 0);
+	}
+	bus.write(0xE000, 0);
+	assert(bus.read(0x8000) == 6 && bus.read(0xA000) == 7 && bus.read(0xC000) == 14);
+
+	// Bit 7 abandons a half written value
+	bus.write(0xE000, 1);
+	bus.write(0xE000, 1);
+	bus.write(0x8000, 0x80);
+	writeMMC1(bus, 0xE000, 1);
+	assert(bus.read(0x8000) == 2);
+
+	// PRG mode 2: first bank fixed at $8000, $C000 switches
+	writeMMC1(bus, 0x8000, 0x08);
+	assert(bus.read(0x8000) == 0 && bus.read(0xC000) == 2);
+
+	// PRG mode 0: 32 KB, the low bit is ignored
+	writeMMC1(bus, 0x8000, 0x00);
+	writeMMC1(bus, 0xE000, 5);
+	assert(bus.read(0x8000) == 8 && bus.read(0xC000) == 10 && bus.read(0xE000) == 11);
+
+	// CHR: one 8 KB bank (low bit ignored), then two 4 KB banks with the CHR mode bit
+	writeMMC1(bus, 0xA000, 3);
+	assert(ppu.readPPU(0x0000) == 0x80 + 8 && ppu.readPPU(0x1000) == 0x80 + 12);
+	writeMMC1(bus, 0x8000, 0x10);
+	writeMMC1(bus, 0xC000, 6);
+	assert(ppu.readPPU(0x0000) == 0x80 + 12 && ppu.readPPU(0x1C00) == 0x80 + 27);
+
+	// Mirroring from control bits 0-1: single screen lower / upper, vertical, horizontal
+	writeMMC1(bus, 0x8000, 0x10);
+	assert(ppu.getMirroring() == Mirroring::SINGLE_LOWER);
+	writeMMC1(bus, 0x8000, 0x11);
+	assert(ppu.getMirroring() == Mirroring::SINGLE_UPPER);
+	writeMMC1(bus, 0x8000, 0x12);
+	assert(ppu.getMirroring() == Mirroring::VERTICAL);
+	writeMMC1(bus, 0x8000, 0x13);
+	assert(ppu.getMirroring() == Mirroring::HORIZONTAL);
+	ppu.writePPU(0x2001, 0x44);
+	assert(ppu.readPPU(0x2401) == 0x44 && ppu.readPPU(0x2801) != 0x44);
+
+	// Registers, including a half filled shift register, survive a save state
+	bus.write(0xE000, 1);
+	std::vector<uint8_t> state;
+	nes.saveState(state);
+	writeMMC1(bus, 0xA000, 0);
+	assert(nes.loadState(state));
+	assert(ppu.readPPU(0x0000) == 0x80 + 12 && bus.read(0x8000) == 8);
+	for (int i = 0; i < 4; i++) {
+		bus.write(0xE000, 1);
+	}
+	assert(bus.read(0x8000) == 12);
+	std::remove(path.c_str());
+	std::cout << "MMC1 tests passed!\n";
+}
+
+void Tests::test_CNROM() {
+	std::cout << "---------------------------\nCNROM Tests:\n\n";
+	std::string path = writeMapperTestROM("cnrom_test.nes", 3, 1, 4);
+	NES nes(false);
+	assert(nes.load_rom(path.c_str()));
+
+	// 16 KB of PRG shows up twice, CHR switches 8 KB at a time and wraps past the last bank
+	assert(nes.bus.read(0x8000) == 0 && nes.bus.read(0xC000) == 0 && nes.bus.read(0xE000) == 1);
+	assert(nes.bus.ppu.readPPU(0x1C00) == 0x80 + 7);
+	nes.bus.write(0x8000, 2);
+	assert(nes.bus.ppu.readPPU(0x0000) == 0x80 + 16 && nes.bus.ppu.readPPU(0x1FFF) == 0x80 + 23);
+	nes.bus.write(0xFFFF, 5);
+	assert(nes.bus.ppu.readPPU(0x0000) == 0x80 + 8);
+
+	// CHR ROM ignores writes
+	nes.bus.ppu.writePPU(0x0000, 0x00);
+	assert(nes.bus.ppu.readPPU(0x0000) == 0x80 + 8);
+	std::remove(path.c_str());
+	std::cout << "CNROM tests passed!\n";
+}
+
+void Tests::test_AxROM() {
+	std::cout << "---------------------------\nAxROM Tests:\n\n";
+	std::string path = writeMapperTestROM("axrom_test.nes", 7, 8, 0);
+	NES nes(false);
+	assert(nes.load_rom(path.c_str()));
+	PPU& ppu = nes.bus.ppu;
+
+	// 32 KB PRG banks
+	assert(nes.bus.read(0x8000) == 0 && nes.bus.read(0xE000) == 3);
+	nes.bus.write(0x8000, 0x03);
+	assert(nes.bus.read(0x8000) == 12 && nes.bus.read(0xFFFF) == 15);
+
+	// Bit 4 picks which 1 KB of VRAM all four name tables show
+	assert(ppu.getMirroring() == Mirroring::SINGLE_LOWER);
+	ppu.writePPU(0x2C10, 0x11);
+	assert(ppu.readPPU(0x2010) == 0x11 && ppu.readPPU(0x2410) == 0x11);
+	nes.bus.write(0x8000, 0x13);
+	assert(ppu.getMirroring() == Mirroring::SINGLE_UPPER && nes.bus.read(0x8000) == 12);
+	assert(ppu.readPPU(0x2010) != 0x11);
+	ppu.writePPU(0x2010, 0x22);
+	nes.bus.write(0x8000, 0x03);
+	assert(ppu.readPPU(0x2810) == 0x11);
+	std::remove(path.c_str());
+	std::cout << "AxROM tests passed!\n";
+}
+
+void Tests::test_GxROM() {
+	std::cout << "---------------------------\nGxROM Tests:\n\n";
+	std::string path = writeMapperTestROM("gxrom_test.nes", 66, 8, 4);
+	NES nes(false);
+	assert(nes.load_rom(path.c_str()));
+	assert(nes.rom.info.mapper == 66);
+
+	// PRG in bits 4-5, CHR in bits 0-1, one write switches both
+	assert(nes.bus.read(0x8000) == 0 && nes.bus.ppu.readPPU(0x0000) == 0x80);
+	nes.bus.write(0x8000, 0x21);
+	assert(nes.bus.read(0x8000) == 8 && nes.bus.read(0xFFFF) == 11);
+	assert(nes.bus.ppu.readPPU(0x0000) == 0x80 + 8 && nes.bus.ppu.readPPU(0x1FFF) == 0x80 + 15);
+	nes.bus.write(0x8000, 0x13);
+	assert(nes.bus.read(0x8000) == 4 && nes.bus.ppu.readPPU(0x0400) == 0x80 + 25);
+	std::remove(path.c_str());
+	std::cout << "GxROM tests passed!\n";
+}
+
+void Tests::test_MMC3() {
+	std::cout << "---------------------------\nMMC3 Tests:\n\n";
+	std::string path = writeMapperTestROM("mmc3_test.nes", 4, 8, 8);
+	NES nes(false);
+	assert(nes.load_rom(path.c_str()));
+	Bus& bus = nes.bus;
+	PPU& ppu = nes.bus.ppu;
+
+	// PRG: R6 / R7 switch, the second to last bank trades places with R6 in PRG mode 1
+	bus.write(0x8000, 6);
+	bus.write(0x8001, 3);
+	bus.write(0x8000, 7);
+	bus.write(0x8001, 9);
+	assert(bus.read(0x8000) == 3 && bus.read(0xA000) == 9 && bus.read(0xC000) == 14 && bus.read(0xE000) == 15);
+	bus.write(0x8000, 0x40);
+	assert(bus.read(0x8000) == 14 && bus.read(0xC000) == 3);
+
+	// CHR: R0 / R1 are 2 KB (low bit ignored) at $0000, R2-R5 1 KB at $1000; swapped in CHR mode 1
+	bus.write(0x8000, 0);
+	bus.write(0x8001, 11);
+	bus.write(0x8000, 5);
+	bus.write(0x8001, 40);
+	assert(ppu.readPPU(0x0000) == 0x80 + 10 && ppu.readPPU(0x0400) == 0x80 + 11 && ppu.readPPU(0x1C00) == 0x80 + 40);
+	bus.write(0x8000, 0x80);
+	assert(ppu.readPPU(0x1000) == 0x80 + 10 && ppu.readPPU(0x0C00) == 0x80 + 40);
+
+	// Mirroring register
+	bus.write(0xA000, 1);
+	assert(ppu.getMirroring() == Mirroring::HORIZONTAL);
+	bus.write(0xA000, 0);
+	assert(ppu.getMirroring() == Mirroring::VERTICAL);
+
+	// Scanline IRQ. Keep the CPU busy counting down so nothing but the PPU and the mapper runs,
+	// and note the line and dot at which /IRQ goes low.
+	nes.cpu.cycles = 1000000;
+	auto runUntilIrq = [&](int maxDots) {
+		for (int dot = 0; dot < maxDots && !bus.cartridgeIrq; dot++) {
+			nes.cpu.cycles = 1000000;
+			bus.clock();
+		}
+		return bus.cartridgeIrq;
+	};
+	auto startFrame = [&](uint8_t ctrl) {
+		while (!(ppu.scanline == -1 && ppu.cycle == 0)) {
+			bus.clock();
+		}
+		bus.write(0x2000, ctrl);
+	};
+
+	// Sprites at $1000: edges at dot 260 of the pre-render line and every visible line. A latch of
+	// 10 reloads on the pre-render edge and reaches zero ten edges later, on line 9.
+	bus.write(0x2001, 0x18);
+	startFrame(0x08);
+	bus.write(0xC000, 10);
+	bus.write(0xC001, 0);
+	bus.write(0xE001, 0);
+	assert(runUntilIrq(341 * 262));
+	assert(ppu.scanline == 9 && ppu.cycle >= 260 && ppu.cycle < 264);
+
+	// The line stays low until $E000 acknowledges it
+	bus.clock();
+	assert(bus.cartridgeIrq);
+	bus.write(0xE000, 0);
+	assert(!bus.cartridgeIrq);
+
+	// Background at $1000 instead: the edge moves to dot 324
+	startFrame(0x10);
+	bus.write(0xC001, 0);
+	bus.write(0xE001, 0);
+	assert(runUntilIrq(341 * 262));
+	assert(ppu.scanline == 9 && ppu.cycle >= 324 && ppu.cycle < 328);
+	bus.write(0xE000, 0);
+
+	// Switching the sprite table away from $1000 mid frame stops the count until it comes back
+	startFrame(0x08);
+	bus.write(0xC001, 0);
+	bus.write(0xE001, 0);
+	while (ppu.scanline < 4) {
+		bus.clock();
+	}
+	bus.write(0x2000, 0x00);
+	while (ppu.scanline < 20) {
+		bus.clock();
+	}
+	assert(!bus.cartridgeIrq);
+	bus.write(0x2000, 0x08);
+	assert(runUntilIrq(341 * 262));
+	assert(ppu.scanline == 25);
+	bus.write(0xE000, 0);
+
+	// With rendering off there are no edges at all
+	bus.write(0x2001, 0x00);
+	startFrame(0x08);
+	bus.write(0xC001, 0);
+	bus.write(0xE001, 0);
+	assert(!runUntilIrq(341 * 262));
+
+	// A pending IRQ and the counter survive a save state
+	bus.write(0x2001, 0x18);
+	startFrame(0x08);
+	bus.write(0xC001, 0);
+	assert(runUntilIrq(341 * 262));
+	std::vector<uint8_t> state;
+	nes.saveState(state);
+	bus.write(0xE000, 0);
+	assert(nes.loadState(state) && bus.cartridgeIrq);
+
+	// The CPU takes the interrupt at the next instruction boundary once I is clear
+	nes.cpu.cycles = 0;
+	nes.cpu.setFlag(CPU::FLAGS::I, false);
+	uint8_t stack = nes.cpu.S;
+	bus.clock();
+	bus.clock();
+	bus.clock();
+	assert(nes.cpu.getFlag(CPU::FLAGS::I) && nes.cpu.S == static_cast<uint8_t>(stack - 3));
+
+	// A reset mid line, before that line's edge, leaves rendering off: no edge, no clock
+	bus.write(0xE000, 0);
+	bus.write(0x2001, 0x18);
+	startFrame(0x08);
+	while (!(ppu.scanline == 5 && ppu.cycle >= 100)) {
+		nes.cpu.cycles = 1000000;
+		bus.clock();
+	}
+	assert(ppu.nextA12Edge == 260);
+	bus.write(0xC000, 0);
+	bus.write(0xC001, 0);
+	bus.write(0xE001, 0);
+	bus.reset();
+	assert(!runUntilIrq(341 * 2));
+
+	std::remove(path.c_str());
+	std::cout << "MMC3 tests passed!\n";
+}
+
+void Tests::test_save_ram() {
+	std::cout << "---------------------------\nSave RAM Tests:\n\n";
+	std::string path = writeMapperTestROM("save_ram_test.nes", 1, 2, 1, 0x02);
+	std::string save = "save_ram_test.sav";
+	std::remove(save.c_str());
+	{
+		NES nes(false);
+		assert(nes.load_rom(path.c_str()));
+		assert(nes.rom.hasSaveFile());
+		assert(std::filesystem::file_size(save) == 0x2000);
+
+		// Work RAM at $6000-$7FFF, blank until written
+		assert(nes.bus.read(0x6000) == 0 && nes.bus.read(0x7FFF) == 0);
+		nes.bus.write(0x6000, 0x12);
+		nes.bus.write(0x7FFF, 0x34);
+		assert(nes.bus.read(0x6000) == 0x12 && nes.bus.read(0x7FFF) == 0x34);
+
+		// blargg status: nothing until the signature is in place
+		uint8_t status = 0;
+		std::string message;
+		assert(!nes.rom.readTestStatus(status, message));
+		const char text[] = "Passed\n";
+		nes.bus.write(0x6001, 0xDE);
+		nes.bus.write(0x6002, 0xB0);
+		nes.bus.write(0x6003, 0x61);
+		for (size_t i = 0; i < sizeof(text); i++) {
+			nes.bus.write(static_cast<uint16_t>(0x6004 + i), static_cast<uint8_t>(text[i]));
+		}
+		nes.bus.write(0x6000, 0x80);
+		assert(nes.rom.readTestStatus(status, message) && status == 0x80 && message == "Passed\n");
+		nes.bus.write(0x6000, 0x00);
+
+		// The RAM is part of a save state
+		std::vector<uint8_t> state;
+		nes.saveState(state);
+		nes.bus.write(0x7FFF, 0x56);
+		assert(nes.loadState(state));
+		assert(nes.bus.read(0x7FFF) == 0x34);
+		assert(nes.rom.flushSaveRAM());
+	}
+
+	// The next power on finds it in the .sav file
+	{
+		NES nes(false);
+		assert(nes.load_rom(path.c_str()));
+		assert(nes.bus.read(0x6000) == 0x00 && nes.bus.read(0x6001) == 0xDE && nes.bus.read(0x7FFF) == 0x34);
+		uint8_t status = 0xFF;
+		std::string message;
+		assert(nes.rom.readTestStatus(status, message) && status == 0 && message == "Passed\n");
+	}
+
+	// Without the battery bit, or with save files turned off, the RAM is volatile
+	{
+		NES nes(false);
+		nes.rom.useSaveFiles = false;
+		assert(nes.load_rom(path.c_str()));
+		assert(!nes.rom.hasSaveFile() && nes.bus.read(0x7FFF) == 0);
+		nes.bus.write(0x7FFF, 0x99);
+	}
+	std::ifstream kept(save, std::ios::binary);
+	kept.seekg(0x1FFF);
+	assert(kept.get() == 0x34);
+	kept.close();
+	std::remove(save.c_str());
+	std::remove(path.c_str());
+
+	path = writeMapperTestROM("save_ram_test.nes", 0, 1, 1);
+	{
+		NES nes(false);
+		assert(nes.load_rom(path.c_str()));
+		nes.bus.write(0x6000, 0x42);
+		assert(!nes.rom.hasSaveFile() && nes.bus.read(0x6000) == 0x42);
+	}
+	assert(!std::filesystem::exists(save));
+	std::remove(path.c_str());
+	std::cout << "Save RAM tests passed!\n";
+}
+
+void Tests::test_trace() {
+	std::cout << "---------------------------\nTrace Tests:\n\n";
+
+	// nestest.log layout, including the '*' of undocumented opcodes and branch targets
+	TraceRecord jmp{7, 0xC000, 0x4C, {0xF5, 0xC5}, 0x00, 0x00, 0x00, 0x24, 0xFD, 0, 21};
+	assert(formatTraceLine(jmp) ==
+		   "C000  4C F5 C5  JMP $C5F5                       A:00 X:00 Y:00 P:24 SP:FD PPU:  0, 21 CYC:7");
+	TraceRecord nop{14579, 0xC6BD, 0x04, {0xA9, 0x00}, 0xAA, 0x01, 0x02, 0xE5, 0xF9, 240, 300};
+	assert(formatTraceLine(nop) ==
+		   "C6BD  04 A9    *NOP $A9                         A:AA X:01 Y:02 P:E5 SP:F9 PPU:240,300 CYC:14579");
+	TraceRecord bne{20, 0xC72A, 0xD0, {0xFC, 0x00}, 0, 0, 0, 0x24, 0xFB, 1, 5};
+	assert(formatTraceLine(bne).compare(0, 25, "C72A  D0 FC     BNE $C728") == 0);
+
+	// A ring far smaller than the trace: the producer waits for the writer instead of dropping
+	std::string path = "trace_test.trace";
+	{
+		TraceLog log(64);
+		assert(log.start(path));
+		for (uint32_t i = 0; i < 100000; i++) {
+			TraceRecord entry{};
+			entry.cycle = i;
+			entry.pc = static_cast<uint16_t>(i);
+			log.record(entry);
+		}
+		log.stop();
+		assert(log.recorded() == 100000);
+	}
+	MappedFile file;
+	assert(file.open(path));
+	const TraceRecord* records = nullptr;
+	size_t count = 0;
+	assert(parseTraceFile(file.data(), file.size(), records, count) && count == 100000);
+	for (size_t i = 0; i < count; i++) {
+		assert(records[i].cycle == i && records[i].pc == static_cast<uint16_t>(i));
+	}
+	file.close();
+
+	// Capture mode hands the records back in order without a file
+	{
+		TraceLog log(4);
+		log.startCapture();
+		TraceRecord entry{};
+		assert(!log.take(entry));
+		for (uint16_t pc = 1; pc <= 3; pc++) {
+			entry.pc = pc;
+			log.record(entry);
+		}
+		for (uint16_t pc = 1; pc <= 3; pc++) {
+			assert(log.take(entry) && entry.pc == pc);
+		}
+		assert(!log.take(entry));
+	}
+
+	// The CPU hook, in builds that have it: the first instruction is the one at the reset vector
+	if (TraceLog::compiledIn()) {
+		// 16 KB of NOPs, reset vector $8000
+		std::vector<uint8_t> image = {'N', 'E', 'S', 0x1A, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+		image.insert(image.end(), 0x4000, 0xEA);
+		image[16 + 0x3FFC] = 0x00;
+		image[16 + 0x3FFD] = 0x80;
+		image.insert(image.end(), 0x2000, 0x00);
+		std::string rom = "trace_test.nes";
+		std::ofstream(rom, std::ios::binary).write(reinterpret_cast<const char*>(image.data()), image.size());
+		NES nes(false);
+		assert(nes.load_rom(rom.c_str()));
+		nes.initNES();
+		uint16_t start = nes.cpu.PC;
+		assert(nes.startTrace(path));
+		nes.run_frame();
+		nes.stopTrace();
+		assert(file.open(path));
+		assert(parseTraceFile(file.data(), file.size(), records, count) && count > 1000);
+		assert(start == 0x8000 && records[0].pc == 0x8000 && records[0].opcode == 0xEA);
+		assert(records[1].pc == 0x8001 && records[1].cycle == records[0].cycle + 2);
+		file.close();
+		std::remove(rom.c_str());
+	}
+	std::remove(path.c_str());
+	std::cout << "Trace tests passed!\n";
+}
+
+void Tests::test_json() {
+	std::cout << "---------------------------\nJSON Tests:\n\n";
+	JsonDocument document;
+	std::string text = R"( {"name": "a9 \"q\" é", "n": [1, -2, 3.5, 1e3, 12345678901], "t": true, "f": false,
+		"z": null, "empty": {}, "list": [], "nested": {"a": [[1, 2], [3, 4]]}} )";
+	assert(document.parse(text));
+	JsonValue root = document.root();
+	assert(root.isObject() && root.size() == 8);
+	assert(root["name"].string() == "a9 \"q\" \xC3\xA9");
+	JsonValue numbers = root["n"];
+	assert(numbers.size() == 5 && numbers.at(0).integer() == 1 && numbers.at(1).integer() == -2);
+	assert(numbers.at(2).number() == 3.5 && numbers.at(3).number() == 1000.0 && numbers.at(4).integer() == 12345678901LL);
+	assert(root["t"].boolean() && !root["f"].boolean(true) && root["z"].type() == JsonValue::Type::NUL);
+	assert(root["empty"].isObject() && root["empty"].size() == 0 && root["list"].isArray() && root["list"].size() == 0);
+	assert(root["nested"]["a"].at(1).at(0).integer() == 3);
+	assert(!root["missing"].valid() && root["missing"]["deeper"].at(2).integer(-1) == -1);
+	int sum = 0;
+	for (JsonValue pair : root["nested"]["a"]) {
+		for (JsonValue value : pair) {
+			sum += static_cast<int>(value.integer());
+		}
+	}
+	assert(sum == 10);
+
+	const char* broken[] = {"", "[1, 2", "{\"a\" 1}", "[1,]", "tru", "\"open", "[1] 2", "-", "{\"a\": [1}"};
+	for (const char* bad : broken) {
+		assert(!document.parse(bad) && !document.error().empty());
+	}
+
+	// One ProcessorTests style case on the flat test bus: LDA #$80, two reads, N set
+	assert(document.parse(R"({"name": "a9 80", "initial": {"pc": 1000, "s": 253, "a": 0, "x": 0, "y": 0, "p": 36,
+		"ram": [[1000, 169], [1001, 128]]}, "final": {"pc": 1002, "a": 128, "p": 164},
+		"cycles": [[1000, 169, "read"], [1001, 128, "read"]]})"));
+	JsonValue test = document.root();
+	NES nes(false);
+	std::vector<Bus::Access> accesses;
+	nes.bus.flatMemory = true;
+	nes.bus.accessLog = &accesses;
+	for (JsonValue cell : test["initial"]["ram"]) {
+		nes.bus.testFallbackRAM(static_cast<uint16_t>(cell.at(0).integer())) = static_cast<uint8_t>(cell.at(1).integer());
+	}
+	nes.cpu.PC = static_cast<uint16_t>(test["initial"]["pc"].integer());
+	nes.cpu.P = static_cast<uint8_t>(test["initial"]["p"].integer());
+	nes.cpu.cycles = 0;
+	nes.cpu.cycleExecute();
+	assert(nes.cpu.PC == test["final"]["pc"].integer() && nes.cpu.A == test["final"]["a"].integer());
+	assert(nes.cpu.P == test["final"]["p"].integer() && nes.cpu.cycles + 1 == test["cycles"].size());
+	assert(accesses.size() == 2 && accesses[1].address == 1001 && accesses[1].value == 128 && !accesses[1].write);
+	std::cout << "JSON tests passed!\n";
+}
+
+void Tests::test_movie() {
+	std::cout << "---------------------------\nMovie Tests:\n\n";
+
+	// Strobe: writing 1 to $4016 latches the buttons, reads shift them out A first, then 1s follow
+	{
+		NES nes(false);
+		nes.bus.controller1.reg = 0x81;     // A + Right
+		nes.bus.write(0x4016, 1);
+		nes.bus.controller1.reg = 0x00;     // Too late for this latch
+		assert(nes.bus.read(0x4016) == 1 && nes.bus.read(0x4016) == 1);   // Strobe high: A, no shifting
+		nes.bus.write(0x4016, 0);
+		uint8_t bits[9];
+		for (uint8_t& bit : bits) {
+			bit = nes.bus.read(0x4016);
+		}
+		assert(bits[0] == 1 && bits[7] == 1 && bits[8] == 1);
+		assert(bits[1] == 0 && bits[2] == 0 && bits[3] == 0 && bits[6] == 0);
+	}
+
+	// Record a stretch of DK with input changing every few frames, replay it on a fresh machine
+	const int frames = 240;
+	auto input = [](int frame) { return static_cast<uint8_t>(frame < 60 ? 0 : ((frame / 8) * 37) & 0xCF); };
+	std::vector<uint8_t> recordedState;
+	Movie recorded;
+	{
+		NES nes(false);
+		assert(nes.load_rom("./ROMs/DK.nes"));
+		nes.initNES();
+		recorded.startRecording(nes.bus.ppu.total_frames);
+		nes.bus.movie = &recorded;
+		for (int frame = 0; frame < frames; frame++) {
+			nes.bus.controller1.reg = input(frame);
+			nes.run_frame();
+		}
+		// Run-ahead frames are recorded too but dropped again when recording stops
+		nes.run_ahead(2);
+		recorded.stop(nes.bus.ppu.total_frames);
+		nes.bus.movie = nullptr;
+		nes.saveState(recordedState);
+	}
+	assert(recorded.length() == frames + 1);
+	assert(recorded.input(100) == input(100));
+	assert(recorded.save("movie_test.nesm"));
+
+	Movie replay;
+	assert(replay.load("movie_test.nesm") && replay.length() == recorded.length() && replay.startState.empty());
+	{
+		NES nes(false);
+		assert(nes.load_rom("./ROMs/DK.nes"));
+		nes.initNES();
+		replay.startPlayback(nes.bus.ppu.total_frames);
+		nes.bus.movie = &replay;
+		for (size_t frame = 0; frame < replay.length(); frame++) {
+			nes.bus.controller1.reg = 0xFF;    // Ignored, the movie supplies the input
+			nes.run_frame();
+		}
+		nes.bus.movie = nullptr;
+		std::vector<uint8_t> state;
+		nes.saveState(state);
+		assert(state == recordedState);
+	}
+	std::remove("movie_test.nesm");
+
+	// FM2: header lines, then |commands|RLDUTSBA|port1|
+	{
+		std::ofstream fm2("movie_test.fm2");
+		fm2 << "version 3\nemuVersion 22020\nromFilename DK\nport0 1\nport1 0\n"
+		    << "|0|........|||\n|0|....T...|||\n|0|R......A|||\n|0|.L..T.B.|||\n";
+	}
+	Movie imported;
+	assert(imported.load("movie_test.fm2") && imported.length() == 4);
+	assert(imported.input(0) == 0x00 && imported.input(1) == 0x08 && imported.input(2) == 0x81 && imported.input(3) == 0x4A);
+	{
+		std::ofstream fm2("movie_test.fm2");
+		fm2 << "version 3\n|0|........|||\n|1|........|||\n";
+	}
+	assert(!imported.load("movie_test.fm2"));
+	std::remove("movie_test.fm2");
+	std::cout << "Movie tests passed!\n";
+}
+
+void Tests::test_guest_profiler() {
+	std::cout << "---------------------------\nGuest Profiler Tests:\n\n";
+	// The hooks are fed by hand so the test does not depend on NES_PROFILE
+	NES nes(false);
+	CPU& cpu = nes.cpu;
+	GuestProfiler profiler;
+	profiler.reset(nullptr);
+	auto run = [&](uint16_t pc, uint8_t opcode, uint32_t cycles, uint16_t next, uint8_t s) {
+		cpu.PC = next;
+		cpu.S = s;
+		profiler.instruction(pc, opcode, cycles, cpu);
+	};
+	cpu.A = 0;
+	cpu.X = 0;
+	cpu.Y = 0;
+	cpu.P = 0x26;
+
+	// JSR $0300 from $0200, then a wait loop LDA $10 / BEQ back to it, twice round
+	run(0x0200, 0x20, 6, 0x0300, 0xFB);
+	run(0x0300, 0xA5, 3, 0x0302, 0xFB);
+	run(0x0302, 0xF0, 3, 0x0300, 0xFB);
+	run(0x0300, 0xA5, 3, 0x0302, 0xFB);
+	run(0x0302, 0xF0, 3, 0x0300, 0xFB);
+	assert(profiler.idleCycles() == 6);
+
+	// An NMI with one NOP, then RTI back into the loop
+	cpu.PC = 0x0400;
+	cpu.S = 0xF8;
+	profiler.interrupt(GuestProfiler::NMI, 8, cpu);
+	run(0x0400, 0xEA, 2, 0x0401, 0xF8);
+	run(0x0401, 0x40, 6, 0x0300, 0xFB);
+
+	// The loop exits, and an RTS trick (two pushes, RTS) must not end the call
+	cpu.A = 1;
+	run(0x0300, 0xA5, 3, 0x0302, 0xFB);
+	run(0x0302, 0xF0, 2, 0x0304, 0xFB);
+	run(0x0304, 0x48, 3, 0x0305, 0xFA);
+	run(0x0305, 0x48, 3, 0x0306, 0xF9);
+	run(0x0306, 0x60, 6, 0x0310, 0xFB);
+	run(0x0310, 0x60, 6, 0x0203, 0xFD);
+	run(0x0203, 0xEA, 2, 0x0204, 0xFD);
+
+	assert(profiler.instructions() == 14);
+	assert(profiler.cycles(GuestProfiler::MAIN) == 6 + 12 + 3 + 2 + 3 + 3 + 6 + 6 + 2);
+	assert(profiler.cycles(GuestProfiler::NMI) == 16 && profiler.cycles(GuestProfiler::IRQ) == 0);
+	assert(profiler.idleCycles() == 6);
+	assert(profiler.opcode(0xA5).executions == 3 && profiler.opcode(0x60).cycles == 12);
+	assert(profiler.site(0x0300).executions == 3 && profiler.site(0x0302).cycles == 8);
+	assert(profiler.bankAt(0x0300) == -1);
+
+	std::ostringstream stacks;
+	profiler.writeCollapsed(stacks);
+	std::string folded = stacks.str();
+	assert(folded.find("main 8\n") != std::string::npos);
+	assert(folded.find("main;0300 35\n") != std::string::npos);
+	assert(folded.find("nmi;0400 16\n") != std::string::npos);
+
+	std::ostringstream report;
+	profiler.writeReport(report, 5);
+	assert(report.str().find("idle") != std::string::npos && report.str().find("LDA") != std::string::npos);
+	std::cout << "Guest profiler tests passed!\n";
+}
+
+void Tests::test_host_zones() {
+	std::cout << "---------------------------\nHost Zone Tests:\n\n";
+	HostZones::clear();
+	assert(HostZones::history(HostZones::EMULATION).empty());
+
+	// The ring keeps the last HISTORY frames, oldest first
+	for (int frame = 0; frame < 300; frame++) {
+		HostZones::beginFrame();
+		HostZones::count(HostZones::CPU_CYCLES, frame);
+		if (frame == 299) {
+			HostZones::add(HostZones::CPU, 100);
+			HostZones::add(HostZones::PPU, 300);
+			HostZones::add(HostZones::CPU, 20);
+		}
+		HostZones::endFrame(HostZones::EMULATION);
+	}
+	std::vector<HostZones::Sample> samples = HostZones::history(HostZones::EMULATION);
+	assert(samples.size() == HostZones::HISTORY);
+	assert(samples.front().counts[HostZones::CPU_CYCLES] == 300 - HostZones::HISTORY);
+	assert(samples.back().counts[HostZones::CPU_CYCLES] == 299);
+	assert(samples.back().ticks[HostZones::CPU] == 120 && samples.back().ticks[HostZones::PPU] == 300);
+	assert(samples.back().ticks[HostZones::APU] == 0 && samples[0].ticks[HostZones::CPU] == 0);
+	assert(samples.back().start >= samples.front().start);
+	assert(HostZones::history(HostZones::EMULATION, 10).size() == 10);
+	assert(HostZones::history(HostZones::UI).empty());
+
+	// Trace: two thread names, one event per frame and one per zone that ran
+	std::ostringstream trace;
+	HostZones::writeChromeTrace(trace);
+	std::string text = trace.str();
+	JsonDocument document;
+	assert(document.parse(text));
+	JsonValue events = document.root();
+	assert(events.isArray() && events.size() == 2 + HostZones::HISTORY + 2);
+	JsonValue cpu = events.at(events.size() - 2);
+	JsonValue ppu = events.at(events.size() - 1);
+	assert(cpu["name"].string() == "CPU" && ppu["name"].string() == "PPU");
+	assert(cpu["ph"].string() == "X" && cpu["args"]["aggregated"].boolean());
+	assert(std::abs(ppu["ts"].number() - (cpu["ts"].number() + cpu["dur"].number())) < 0.01);
+	JsonValue frame = events.at(events.size() - 3);
+	assert(frame["name"].string() == "Emulation frame" && frame["args"]["cpuCycles"].number() == 299);
+
+	HostZones::clear();
+	std::cout << "Host zone tests passed!\n";
+}
+
+void Tests::test_perf_counters(std::string path) {
+	std::cout << "---------------------------\nPerf Counter Tests:\n\n";
+	std::string unrom = writeMapperTestROM("perf_test.nes", 2, 8, 0, 0x01);
+	NES board(false);
+	assert(board.load_rom(unrom.c_str()));
+
+	// Every 8 KB window a register write moves counts, rewriting the same bank does not
+	board.bus.write(0x8000, 0);
+	assert(board.bus.perf.bankSwitches == 0);
+	board.bus.write(0x8000, 3);
+	board.bus.write(0xC000, 3);
+	board.bus.write(0x8000, 4);
+	assert(board.bus.perf.bankSwitches == 4);
+	// Restoring a state repoints the windows without counting
+	std::vector<uint8_t> state;
+	board.saveState(state);
+	board.bus.write(0x8000, 5);
+	assert(board.loadState(state) && board.bus.perf.bankSwitches == 6);
+
+	// PPU writes land on the scanline the PPU is on, the pre-render line first
+	board.bus.ppu.scanline = 100;
+	board.bus.write(0x2001, 0x00);
+	board.bus.write(0x3FF9, 0x00);
+	board.bus.ppu.scanline = -1;
+	board.bus.write(0x2006, 0x20);
+	board.bus.read(0x2002);
+	board.bus.read(0x200A);
+	board.bus.read(0x2004);
+	board.bus.write(0x4014, 0x02);
+	const PerfCounters& perf = board.bus.perf;
+	assert(perf.ppuWrites == 3 && perf.ppuWritesByScanline[101] == 2 && perf.ppuWritesByScanline[0] == 1);
+	assert(perf.scanlinesWithWrites() == 1);
+	assert(perf.statusPolls == 2 && perf.dmaTransfers == 1);
+	std::remove(unrom.c_str());
+
+	// Frames hand their counters over at the boundary, the totals add up
+	NES nes(false);
+	assert(nes.load_rom(path.c_str()));
+	nes.initNES();
+	PerfCounters sum;
+	for (int frame = 0; frame < 5; frame++) {
+		nes.run_frame();
+		// The first frame runs from power on, mid-frame
+		assert(frame == 0 || (nes.frameCounters.cpuCycles >= 29780 && nes.frameCounters.cpuCycles <= 29781));
+		assert(nes.frameCounters.instructions > 0 && nes.frameCounters.instructions < nes.frameCounters.cpuCycles / 2);
+		assert(nes.bus.perf.cpuCycles == 0);
+		sum += nes.frameCounters;
+	}
+	assert(sum.cpuCycles == nes.totalCounters.cpuCycles && sum.instructions == nes.totalCounters.instructions);
+	assert(sum.nmis == nes.totalCounters.nmis && sum.ppuWrites == nes.totalCounters.ppuWrites);
+	std::cout << "Perf counter tests passed!\n";
+}
+
+void Tests::test_log() {
+	std::cout << "---------------------------\nLog Tests:\n\n";
+	std::FILE* file = std::tmpfile();
+	assert(file != nullptr);
+	Log::flush();
+	Log::setFile(file);
+
+	// A site writes its first BURST messages, then only every power of two
+	for (int i = 1; i <= 1000; i++) {
+		NES_LOG_WARN("repeated warning %d", i);
+	}
+	// Filtered at run time: counted, not written
+	Log::setLevel(Log::LEVEL_ERROR);
+	for (int i = 0; i < 3; i++) {
+		NES_LOG_WARN("filtered warning");
+	}
+	Log::setLevel(Log::LEVEL_TRACE);
+	// Below the compile time level the call site does not exist
+	static_assert(NES_LOG_LEVEL > NES_LOG_LEVEL_TRACE, "the test expects trace messages compiled out");
+	NES_LOG_TRACE("compiled out");
+	Log::flush();
+	Log::setFile(stderr);
+
+	std::rewind(file);
+	std::vector<std::string> lines;
+	char line[512];
+	while (std::fgets(line, sizeof(line), file) != nullptr) {
+		lines.push_back(line);
+	}
+	std::fclose(file);
+	assert(lines.size() == Log::BURST + 6);
+	assert(lines[0].rfind("[warn] tests.cpp:", 0) == 0 && lines[0].find(": repeated warning 1\n") != std::string::npos);
+	assert(lines[Log::BURST].find("repeated warning 16 [16 times]\n") != std::string::npos);
+	assert(lines.back().find("repeated warning 512 [512 times]\n") != std::string::npos);
+
+	std::ostringstream sites;
+	Log::writeSites(sites);
+	assert(sites.str().find(" warn 1000\n") != std::string::npos);
+	assert(sites.str().find(" warn 3\n") != std::string::npos);
+	assert(sites.str().find("trace") == std::string::npos);
+	assert(Log::dropped() == 0);
+	std::cout << "Log tests passed!\n";
+}
+
+void Tests::test_debugger(std::string path) {
+	std::cout << "---------------------------\nDebugger Tests:\n\n";
+	Debugger points;
+	assert(!points.armed() && points.mapBytes() == 0);
+	points.add(Debugger::READ | Debugger::WRITE, 0x0300, 0x0303);
+	points.add(Debugger::EXECUTE, 0xC000);
+	assert(points.armed() && points.watchesMemory());
+	assert(points.has(Debugger::READ, 0x0302) && points.has(Debugger::WRITE, 0x0300) && !points.has(Debugger::EXECUTE, 0x0300));
+	assert(!points.has(Debugger::READ, 0x0304) && points.has(Debugger::EXECUTE, 0xC000));
+	points.remove(Debugger::READ | Debugger::WRITE, 0x0300, 0x0303);
+	assert(!points.watchesMemory() && !points.has(Debugger::READ, 0x0302));
+	points.remove(Debugger::EXECUTE, 0xC000);
+	assert(!points.armed() && points.mapBytes() > 0);
+	points.clear();
+	assert(points.mapBytes() == 0 && !points.has(Debugger::EXECUTE, 0xC000));
+
+	NES nes(false);
+	assert(nes.load_rom(path.c_str()));
+	nes.initNES();
+	nes.run_frame();
+	nes.run_frame();
+
+	// An armed machine that never stops runs exactly like an unarmed one, built on used memory
+	std::unique_ptr<UsedMemory> storage(new UsedMemory);
+	NES& reference = buildOnUsedMemory(*storage, path);
+	nes.debugger.add(Debugger::EXECUTE | Debugger::WRITE, 0x0700);
+	for (int frame = 0; frame < 2; frame++) {
+		reference.run_frame();
+	}
+	for (int frame = 0; frame < 5; frame++) {
+		nes.run_frame();
+		reference.run_frame();
+	}
+	std::vector<uint8_t> armedState, plainState;
+	nes.saveState(armedState);
+	reference.saveState(plainState);
+	assert(armedState == plainState);
+	reference.~NES();
+	nes.debugger.clear();
+
+	// Run N frames
+	uint32_t target = nes.bus.ppu.total_frames + 3;
+	nes.debugger.untilFrame(target);
+	assert(nes.runUntil(10) == Debugger::Reason::UNTIL_FRAME);
+	assert(nes.bus.ppu.total_frames == target && nes.debugger.stop().frame == target);
+	assert(!nes.debugger.armed());
+
+	// Execute points stop before the instruction; resuming runs it and finds the next hit. The PC a
+	// frame ends on is in the loop the ROM waits in, so it comes round again within a frame.
+	uint16_t pc = nes.cpu.PC;
+	nes.debugger.add(Debugger::EXECUTE, pc);
+	assert(nes.runUntil(5) == Debugger::Reason::BREAKPOINT);
+	assert(nes.cpu.PC == pc && nes.cpu.cycles == 0 && nes.debugger.stop().pc == pc);
+	uint64_t clock = nes.bus.clockCounter;
+	nes.run_frame();
+	assert(nes.bus.clockCounter == clock);
+	Debugger::Reason again = nes.runUntil(5);
+	assert(nes.bus.clockCounter > clock);
+	assert(again == Debugger::Reason::BREAKPOINT && nes.cpu.PC == pc && nes.debugger.stop().pc == pc);
+	nes.debugger.clear();
+
+	// The opcode fetch is a watched read
+	uint8_t opcode = nes.bus.peek(pc);
+	nes.debugger.add(Debugger::READ, pc);
+	assert(nes.runUntil(5) == Debugger::Reason::READ);
+	assert(nes.debugger.stop().address == pc && nes.debugger.stop().value == opcode && nes.debugger.stop().pc == pc);
+	nes.debugger.clear();
+
+	// Armed just before vblank, the first stack write is the NMI pushing the return address: the
+	// machine stops in the handler, with the instruction the NMI interrupted as the PC
+	nes.debugger.addPpuDot(241, 0);
+	assert(nes.runUntil(2) == Debugger::Reason::PPU_DOT);
+	uint16_t interrupted = nes.debugger.stop().pc;
+	uint8_t stack = nes.cpu.S;
+	nes.debugger.clear();
+	nes.debugger.add(Debugger::WRITE, 0x0100, 0x01FF);
+	assert(nes.runUntil(1) == Debugger::Reason::WRITE);
+	assert(nes.debugger.stop().pc == interrupted && nes.debugger.stop().scanline == 241);
+	assert(nes.debugger.stop().address == 0x0100 + stack && nes.bus.peek(0x0100 + stack) == nes.debugger.stop().value);
+	assert(nes.cpu.PC == (nes.bus.peek(0xFFFB) << 8 | nes.bus.peek(0xFFFA)));
+	nes.debugger.clear();
+	assert(nes.cpu.debugger == nullptr);
+
+	// Value conditions are checked between instructions; one that already holds stops at the next
+	uint8_t value = nes.bus.peek(0x0000);
+	nes.debugger.untilValue(0x0000, value);
+	assert(nes.runUntil(1) == Debugger::Reason::UNTIL_VALUE && nes.cpu.cycles == 0);
+	assert(nes.debugger.stop().address == 0x0000 && nes.bus.peek(0x0000) == value);
+	nes.debugger.clear();
+
+	// PPU points
+	nes.debugger.addPpuDot(100, 50);
+	assert(nes.runUntil(2) == Debugger::Reason::PPU_DOT);
+	assert(nes.debugger.stop().scanline == 100 && nes.debugger.stop().dot == 50);
+	nes.debugger.clear();
+	assert(nes.runUntil(1) == Debugger::Reason::FRAME_LIMIT);
+	std::cout << "Debugger tests passed!\n";
+}
+
+void Tests::test_skip_frame(std::string path) {
+	std::cout << "---------------------------\nSkip Frame Tests:\n\n";
+	NES rendered(false);
+	NES skipped(false);
+	assert(rendered.load_rom(path.c_str()) && skipped.load_rom(path.c_str()));
+	rendered.initNES();
+	skipped.initNES();
+	skipped.bus.ppu.renderPixels = false;
+
+	// Sprite zero at x = 0 with every other pixel opaque, on a visible line
+	for (PPU* ppu : {&rendered.bus.ppu, &skipped.bus.ppu}) {
+		ppu->mask.enable_sprite_rendering = 1;
+		ppu->scanline = 10;
+		ppu->cycle = 100;
+		ppu->numOfSprites = 1;
+		ppu->spriteScanline[0].x = 0;
+		ppu->sprite_shifter_pattern_lo[0] = 0xAA;
+		ppu->bSpriteZeroBeingRendered = true;
+	}
+	// The saved sprite zero flag follows the pixels whether or not they are composed
+	int opaque = 0;
+	for (int dot = 0; dot < 8; dot++) {
+		rendered.bus.ppu.clock();
+		skipped.bus.ppu.clock();
+		assert(rendered.bus.ppu.bSpriteZeroBeingRendered == skipped.bus.ppu.bSpriteZeroBeingRendered);
+		opaque += rendered.bus.ppu.bSpriteZeroBeingRendered;
+	}
+	assert(opaque > 0 && opaque < 8);
+	std::cout << "Skip frame tests passed!\n";
+}
@@ -7,11 +7,30 @@
 #include <unistd.h>
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <string>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <filesystem>
+#include <cstring>
+#include <mutex>
 
 #include "CPU.h"
 #include "NES.h"
 #include "Bus.h"
+#include "Resampler.h"
+#include "RewindBuffer.h"
+#include "Hash.h"
+#include "ThreadPool.h"
+#include "MappedFile.h"
+#include "RomLibrary.h"
+#include "Mapper.h"
+#include "Json.h"
+#include "Movie.h"
+#include "GuestProfiler.h"
+#include "HostZones.h"
+#include "Log.h"
 
 class Tests {
 public:
@@ -38,6 +57,31 @@ public:
     void test_PPU_registers();
     void test_pattern_tables(std::string path);
     void test_Pulse1();
+    void test_resampler();
+    void test_save_state(std::string path);
+    void test_rewind(std::string path);
+    void test_run_ahead(std::string path);
+    void test_hash();
+    void test_thread_pool();
+    void test_chr_banks(std::string path);
+    void test_rom_loading(std::string path);
+    void test_library(std::string path);
+    void test_UNROM();
+    void test_MMC1();
+    void test_CNROM();
+    void test_AxROM();
+    void test_GxROM();
+    void test_MMC3();
+    void test_save_ram();
+    void test_trace();
+    void test_json();
+    void test_movie();
+    void test_guest_profiler();
+    void test_host_zones();
+    void test_perf_counters(std::string path);
+    void test_log();
+    void test_debugger(std::string path);
+    void test_skip_frame(std::string path);
 };
 
 
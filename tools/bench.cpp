@@ -0,0 +1,333 @@
+// Micro benchmarks for the emulator core.
+// Usage: ./bench [name ...]   (no arguments runs everything)
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "../Hash.h"
+#include "../Movie.h"
+#include "../NES.h"
+#include "../Resampler.h"
+#include "../RewindBuffer.h"
+
+// ---------------------------------------------------------------------------- //
+// -------------------------------- RESAMPLER --------------------------------- //
+// ---------------------------------------------------------------------------- //
+
+// Decimates 10 emulated seconds of a CPU-rate square wave for every quality / ISA pair
+static void benchResampler() {
+    const double cpuRate = 1789773.0;
+    const int block = 1024;
+    const int seconds = 10;
+
+    // One block of a 440 Hz square wave, repeated; the filter cost does not depend on content
+    std::vector<float> input(block);
+    for (int i = 0; i < block; i++) {
+        input[i] = std::fmod(i * 440.0 / cpuRate, 1.0) < 0.5 ? 0.3f : 0.0f;
+    }
+
+    const double outputRates[2] = {44100.0, 48000.0};
+    for (double outputRate : outputRates) {
+        for (int q = Resampler::LOW; q <= Resampler::HIGH; q++) {
+            for (int i = Resampler::SCALAR; i <= Resampler::bestIsa(); i++) {
+                Resampler resampler(cpuRate, outputRate, static_cast<Resampler::Quality>(q));
+                resampler.setIsa(static_cast<Resampler::Isa>(i));
+                std::vector<float> output(resampler.maxOutputFor(block));
+
+                long long produced = 0;
+                int blocks = static_cast<int>(cpuRate * seconds / block);
+                auto start = std::chrono::high_resolution_clock::now();
+                for (int b = 0; b < blocks; b++) {
+                    produced += resampler.process(input.data(), block, output.data(), static_cast<int>(output.size()));
+                }
+                auto end = std::chrono::high_resolution_clock::now();
+                double ns = std::chrono::duration<double, std::nano>(end - start).count();
+
+                printf("resampler %5.0f Hz %-6s %-6s taps=%4d phases=%2d  %8.1f ns/output sample  (%.0fx real time)\n",
+                       outputRate, Resampler::qualityName(resampler.getQuality()), Resampler::isaName(resampler.getIsa()),
+                       resampler.getTaps(), resampler.getPhases(), ns / produced, seconds * 1e9 / ns);
+            }
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------- //
+// -------------------------------- SAVE STATE -------------------------------- //
+// ---------------------------------------------------------------------------- //
+
+// Snapshot / restore cost on a running game, the budget rewind and run-ahead spend every frame
+static void benchSaveState() {
+    const int iterations = 20000;
+
+    auto nes = std::make_unique<NES>();
+    nes->load_rom("./ROMs/DK.nes");
+    nes->initNES();
+    for (int i = 0; i < 120; i++) {
+        nes->run_frame();
+    }
+
+    std::vector<uint8_t> state;
+    nes->saveState(state);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        nes->saveState(state);
+    }
+    auto middle = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        nes->loadState(state);
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+
+    double saveUs = std::chrono::duration<double, std::micro>(middle - start).count() / iterations;
+    double loadUs = std::chrono::duration<double, std::micro>(end - middle).count() / iterations;
+    printf("savestate %zu bytes  save %6.2f us  load %6.2f us\n", state.size(), saveUs, loadUs);
+}
+
+// ---------------------------------------------------------------------------- //
+// ---------------------------------- REWIND ---------------------------------- //
+// ---------------------------------------------------------------------------- //
+
+// Records 60 s of gameplay one state per frame, then rewinds through all of it
+static void benchRewind() {
+    const int frames = 60 * 60;
+
+    auto nes = std::make_unique<NES>();
+    nes->load_rom("./ROMs/DK.nes");
+    nes->initNES();
+
+    // Emulate first so only the rewind cost is timed
+    std::vector<std::vector<uint8_t>> states(frames);
+    for (int i = 0; i < frames; i++) {
+        nes->bus.controller1.reg = static_cast<uint8_t>((i / 16) & 0x0F);
+        nes->run_frame();
+        nes->saveState(states[i]);
+    }
+
+    RewindBuffer rewind;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (const std::vector<uint8_t>& state : states) {
+        rewind.push(state);
+    }
+    auto middle = std::chrono::high_resolution_clock::now();
+    size_t stored = rewind.size();
+    size_t memory = rewind.memoryUsed();
+    double ratio = rewind.compressionRatio();
+    std::vector<uint8_t> state;
+    while (rewind.pop(state)) {
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+
+    double pushUs = std::chrono::duration<double, std::micro>(middle - start).count() / frames;
+    double popUs = std::chrono::duration<double, std::micro>(end - middle).count() / (stored - 1);
+    printf("rewind %zu states  %.2f MB (raw %.1f MB, %.1fx)  push %6.2f us  pop %6.2f us  (%.0fx real time backwards)\n",
+           stored, memory / (1024.0 * 1024.0), stored * states[0].size() / (1024.0 * 1024.0), ratio, pushUs, popUs,
+           1e6 / 60.0988 / popUs);
+}
+
+// ---------------------------------------------------------------------------- //
+// --------------------------------- RUN-AHEAD -------------------------------- //
+// ---------------------------------------------------------------------------- //
+
+// Cost of the pieces of a run-ahead frame, and how deep run-ahead can go on this machine at 60 fps
+static void benchRunAhead() {
+    const int frames = 600;
+
+    auto nes = std::make_unique<NES>();
+    nes->load_rom("./ROMs/DK.nes");
+    nes->initNES();
+    for (int i = 0; i < 120; i++) {
+        nes->run_frame();
+    }
+
+    auto time = [&](auto&& body) {
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < frames; i++) {
+            body();
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        return std::chrono::duration<double, std::milli>(end - start).count() / frames;
+    };
+    double renderMs = time([&] { nes->run_frame(); });
+    double skipMs = time([&] { nes->skip_frame(); });
+    double frameBudgetMs = 1000.0 / 60.0988;
+    printf("runahead frame %.3f ms  skipped frame %.3f ms  (%.1fx real time with rendering skipped)\n",
+           renderMs, skipMs, frameBudgetMs / skipMs);
+
+    for (int ahead = 1; ahead <= 4; ahead++) {
+        double ms = time([&] { nes->run_ahead(ahead); });
+        printf("runahead %d frames  %.3f ms per frame  %3.0f%% of the frame budget\n", ahead, ms, 100.0 * ms / frameBudgetMs);
+    }
+}
+
+// ---------------------------------------------------------------------------- //
+// ----------------------------------- FETCH ---------------------------------- //
+// ---------------------------------------------------------------------------- //
+
+// Instruction fetch and bus traffic with several machines interleaved, the way batch workers and
+// run-ahead touch them. Frames are skipped so the time is CPU -> Bus -> RAM / PPU / cartridge
+// accesses rather than pixel output. Run it under `make perf-bench` to get the cache counters.
+static void benchFetch() {
+    const int machines = 8;
+    const int frames = 300;
+
+    std::vector<std::unique_ptr<NES>> nes;
+    for (int i = 0; i < machines; i++) {
+        nes.push_back(std::make_unique<NES>(false));
+        nes[i]->load_rom("./ROMs/DK.nes");
+        nes[i]->initNES();
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int f = 0; f < frames; f++) {
+        for (int i = 0; i < machines; i++) {
+            nes[i]->skip_frame();
+        }
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+
+    double us = std::chrono::duration<double, std::micro>(end - start).count() / (frames * machines);
+    printf("fetch %d machines x %d frames  %.1f us per frame  (%zu bytes per machine)\n", machines, frames, us,
+           sizeof(NES));
+}
+
+// ---------------------------------------------------------------------------- //
+// --------------------------------- GAMEPLAY --------------------------------- //
+// ---------------------------------------------------------------------------- //
+
+// Whole frames of real gameplay: replays the regression movies, which start a game and play it,
+// so the numbers cover scrolling, sprites and mapper traffic rather than a static title screen.
+// The replay is deterministic; the final state hash shows that both runs did the same work.
+static void benchGameplay() {
+    struct Run {
+        const char* rom;
+        const char* movie;
+    };
+    const Run runs[] = {
+        {"./ROMs/DK.nes", "./regression/DK.nesm"},
+        {"./ROMs/Mega Man (USA).nes", "./regression/MegaMan.nesm"},
+    };
+
+    for (const Run& run : runs) {
+        Movie movie;
+        if (!movie.load(run.movie)) {
+            continue;
+        }
+        for (int render = 1; render >= 0; render--) {
+            auto nes = std::make_unique<NES>(false);
+            nes->rom.useSaveFiles = false;
+            if (!nes->load_rom(run.rom)) {
+                break;
+            }
+            nes->initNES();
+            movie.startPlayback(nes->bus.ppu.total_frames);
+            nes->bus.movie = &movie;
+
+            auto start = std::chrono::high_resolution_clock::now();
+            for (size_t frame = 0; frame < movie.length(); frame++) {
+                if (render) {
+                    nes->run_frame();
+                } else {
+                    nes->skip_frame();
+                }
+            }
+            auto end = std::chrono::high_resolution_clock::now();
+            nes->bus.movie = nullptr;
+            std::vector<uint8_t> state;
+            nes->saveState(state);
+
+            double us = std::chrono::duration<double, std::micro>(end - start).count() / movie.length();
+            printf("gameplay %-26s %s %zu frames  %7.1f us per frame  (%.0fx real time)  state hash %016llx\n",
+                   run.movie, render ? "rendered" : "skipped ", movie.length(), us, 1e6 / 60.0988 / us,
+                   static_cast<unsigned long long>(xxhash64(state.data(), state.size())));
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------- //
+// ----------------------------------- TRACE ---------------------------------- //
+// ---------------------------------------------------------------------------- //
+
+// What tracing adds per instruction: skipped frames with and without a trace attached. Only
+// meaningful in a `make TRACE=1` build; otherwise both runs are the same code.
+static void benchTrace() {
+    const int rounds = 10;
+    const int frames = 60;
+    const char* path = "bench.trace";
+
+    auto nes = std::make_unique<NES>(false);
+    nes->load_rom("./ROMs/DK.nes");
+    nes->initNES();
+    if (!TraceLog::compiledIn()) {
+        printf("trace  not compiled in (build with TRACE=1)\n");
+        return;
+    }
+
+    // Alternate plain and traced rounds and keep the fastest of each, so drift and noise from
+    // other processes do not land on one side only
+    auto time = [&] {
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < frames; i++) {
+            nes->skip_frame();
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        return std::chrono::duration<double, std::nano>(end - start).count();
+    };
+    TraceLog log;
+    log.start(path);
+    double plainNs = 1e300;
+    double tracedNs = 1e300;
+    uint64_t instructions = 0;
+    for (int round = 0; round < rounds; round++) {
+        nes->cpu.trace = nullptr;
+        plainNs = std::min(plainNs, time());
+        nes->cpu.trace = &log;
+        uint64_t before = log.recorded();
+        tracedNs = std::min(tracedNs, time());
+        instructions = log.recorded() - before;
+    }
+    nes->cpu.trace = nullptr;
+    log.stop();
+    std::remove(path);
+
+    printf("trace %llu instructions per round  %.2f ns added per instruction  (%llu writer stalls)\n",
+           static_cast<unsigned long long>(instructions), (tracedNs - plainNs) / instructions,
+           static_cast<unsigned long long>(log.stalls()));
+}
+
+// ---------------------------------------------------------------------------- //
+// ---------------------------------- DRIVER ---------------------------------- //
+// ---------------------------------------------------------------------------- //
+
+struct Benchmark {
+    const char* name;
+    void (*run)();
+};
+
+static const Benchmark BENCHMARKS[] = {
+    {"resampler", &benchResampler},
+    {"savestate", &benchSaveState},
+    {"rewind", &benchRewind},
+    {"runahead", &benchRunAhead},
+    {"fetch", &benchFetch},
+    {"gameplay", &benchGameplay},
+    {"trace", &benchTrace},
+};
+
+int main(int argc, char* argv[]) {
+    for (const Benchmark& benchmark : BENCHMARKS) {
+        bool selected = argc < 2;
+        for (int i = 1; i < argc; i++) {
+            if (std::strcmp(argv[i], benchmark.name) == 0) selected = true;
+        }
+        if (selected) {
+            benchmark.run();
+        }
+    }
+    return 0;
+}
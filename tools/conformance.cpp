@@ -0,0 +1,212 @@
+// Checks the CPU against nestest.log, the instruction by instruction log of a known good run of
+// nestest.nes in automation mode (execution starting at $C000, no PPU needed).
+//
+// Usage: ./conformance_test [rom] [log]
+//
+// The ROM defaults to nestest.nes and the log to the ROM's name with .log, i.e. the reference is
+// expected next to the ROM. Needs the trace hook, `make conformance` builds it with NES_TRACE.
+//
+// Every traced instruction is compared with its log line as it executes: PC, instruction bytes,
+// A/X/Y/P/SP, the PPU scanline/dot and CYC. The disassembly column is not compared. Power-on takes
+// 7 cycles on hardware that this core does not spend, so CYC and PPU are compared as distances
+// from the first line. The run stops at the first mismatch and prints the lines leading up to it.
+// Exit status is 0 when the whole log matches.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../MappedFile.h"
+#include "../NES.h"
+#include "../Trace.h"
+
+// Frame length in PPU dots, for comparing positions across frames (rendering is off, no short frame)
+const long FRAME_DOTS = 341L * 262L;
+
+struct LogLine {
+    std::string text;
+    uint16_t pc = 0;
+    uint8_t bytes[3] = {};
+    int byteCount = 0;
+    uint8_t a = 0, x = 0, y = 0, p = 0, s = 0;
+    int scanline = 0;
+    int dot = 0;
+    unsigned long long cycle = 0;
+};
+
+static bool parseLine(const std::string& text, LogLine& line) {
+    line.text = text;
+    unsigned pc = 0;
+    if (std::sscanf(text.c_str(), "%4x", &pc) != 1) {
+        return false;
+    }
+    line.pc = static_cast<uint16_t>(pc);
+
+    // Instruction bytes: up to three hex pairs from column 6
+    line.byteCount = 0;
+    for (int i = 0; i < 3; i++) {
+        size_t at = 6 + static_cast<size_t>(i) * 3;
+        unsigned value = 0;
+        if (at + 2 > text.size() || text[at] == ' ' || std::sscanf(text.c_str() + at, "%2x", &value) != 1) {
+            break;
+        }
+        line.bytes[line.byteCount++] = static_cast<uint8_t>(value);
+    }
+
+    size_t registers = text.find(" A:");
+    if (registers == std::string::npos) {
+        return false;
+    }
+    unsigned a, x, y, p, s;
+    if (std::sscanf(text.c_str() + registers, " A:%2x X:%2x Y:%2x P:%2x SP:%2x PPU:%d,%d CYC:%llu",
+                    &a, &x, &y, &p, &s, &line.scanline, &line.dot, &line.cycle) != 8) {
+        return false;
+    }
+    line.a = static_cast<uint8_t>(a);
+    line.x = static_cast<uint8_t>(x);
+    line.y = static_cast<uint8_t>(y);
+    line.p = static_cast<uint8_t>(p);
+    line.s = static_cast<uint8_t>(s);
+    return true;
+}
+
+static bool loadLog(const std::string& path, std::vector<LogLine>& lines) {
+    MappedFile file;
+    if (!file.open(path)) {
+        return false;
+    }
+    const char* text = reinterpret_cast<const char*>(file.data());
+    size_t size = file.size();
+    size_t start = 0;
+    while (start < size) {
+        size_t end = start;
+        while (end < size && text[end] != '\n') {
+            end++;
+        }
+        std::string row(text + start, end - start);
+        if (!row.empty() && row.back() == '\r') {
+            row.pop_back();
+        }
+        if (!row.empty()) {
+            LogLine line;
+            if (!parseLine(row, line)) {
+                std::cerr << path << ":" << lines.size() + 1 << ": not a nestest.log line: " << row << std::endl;
+                return false;
+            }
+            lines.push_back(line);
+        }
+        start = end + 1;
+    }
+    return true;
+}
+
+static long wrapDots(long dots) {
+    return ((dots % FRAME_DOTS) + FRAME_DOTS) % FRAME_DOTS;
+}
+
+// Names the first field that differs, or returns nullptr
+static const char* compare(const LogLine& expected, const TraceRecord& actual, long cycleOffset, long dotOffset) {
+    if (expected.pc != actual.pc) return "PC";
+    if (expected.byteCount > 0 && expected.bytes[0] != actual.opcode) return "opcode";
+    for (int i = 1; i < expected.byteCount; i++) {
+        if (expected.bytes[i] != actual.operand[i - 1]) return "operand";
+    }
+    if (expected.a != actual.a) return "A";
+    if (expected.x != actual.x) return "X";
+    if (expected.y != actual.y) return "Y";
+    if (expected.p != actual.p) return "P";
+    if (expected.s != actual.s) return "SP";
+    if (static_cast<long>(expected.cycle) != static_cast<long>(actual.cycle) + cycleOffset) return "CYC";
+    long expectedDots = static_cast<long>(expected.scanline) * 341 + expected.dot;
+    long actualDots = static_cast<long>(actual.scanline) * 341 + actual.dot;
+    if (wrapDots(expectedDots) != wrapDots(actualDots + dotOffset)) return "PPU";
+    return nullptr;
+}
+
+int main(int argc, char** argv) {
+    std::string romPath = argc > 1 ? argv[1] : "nestest.nes";
+    std::string logPath = argc > 2 ? argv[2] : std::filesystem::path(romPath).replace_extension(".log").string();
+    if (argc > 3) {
+        std::cerr << "Usage: " << argv[0] << " [rom] [log]" << std::endl;
+        return 2;
+    }
+    if (!TraceLog::compiledIn()) {
+        std::cerr << "Built without NES_TRACE, use `make conformance`" << std::endl;
+        return 2;
+    }
+
+    std::vector<LogLine> expected;
+    if (!loadLog(logPath, expected) || expected.empty()) {
+        std::cerr << "No reference log at " << logPath << std::endl;
+        return 2;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    auto nes = std::make_unique<NES>(false);
+    nes->rom.useSaveFiles = false;
+    if (!nes->load_rom(romPath.c_str())) {
+        return 2;
+    }
+    nes->initNES();
+    nes->cpu.PC = expected[0].pc;   // Automation mode: $C000 instead of the reset vector
+
+    TraceLog trace;
+    trace.startCapture();
+    nes->cpu.trace = &trace;
+
+    // Matching log lines kept to print before a mismatch
+    const size_t context = 8;
+    std::deque<std::string> recent;
+    long cycleOffset = 0;
+    long dotOffset = 0;
+    size_t matched = 0;
+    uint64_t clockBudget = (expected.back().cycle + 1000) * 3 * 2;
+    TraceRecord record;
+    while (matched < expected.size() && clockBudget-- > 0) {
+        nes->bus.clock();
+        while (matched < expected.size() && trace.take(record)) {
+            const LogLine& line = expected[matched];
+            if (matched == 0) {
+                cycleOffset = static_cast<long>(line.cycle) - static_cast<long>(record.cycle);
+                dotOffset = static_cast<long>(line.scanline) * 341 + line.dot -
+                            (static_cast<long>(record.scanline) * 341 + record.dot);
+            }
+            const char* field = compare(line, record, cycleOffset, dotOffset);
+            if (field != nullptr) {
+                std::cerr << std::dec << "Mismatch in " << field << " at line " << matched + 1 << " of " << logPath << "\n\n";
+                for (const std::string& previous : recent) {
+                    std::cerr << "    " << previous << "\n";
+                }
+                std::cerr << "  - " << line.text << "\n";
+                std::cerr << "  + " << formatTraceLine(record) << "\n";
+                std::cerr << "\n(+ is this core with CYC and PPU as recorded; they are compared "
+                          << "offset by " << cycleOffset << " cycles and " << dotOffset << " dots)" << std::endl;
+                return 1;
+            }
+            recent.push_back(line.text);
+            if (recent.size() > context) {
+                recent.pop_front();
+            }
+            matched++;
+        }
+    }
+    nes->cpu.trace = nullptr;
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    if (matched < expected.size()) {
+        std::cerr << "Stopped after " << matched << " of " << expected.size()
+                  << " lines: the CPU ran past the log's last cycle without reaching its end" << std::endl;
+        return 1;
+    }
+    // nestest leaves its error codes in $02 (official opcodes) and $03 (unofficial ones)
+    std::cout << std::dec << expected.size() << " lines of " << logPath << " match (" << std::fixed;
+    std::cout.precision(1);
+    std::cout << ms << " ms), result codes $02=" << std::hex << static_cast<int>(nes->bus.cpuRam[2])
+              << " $03=" << static_cast<int>(nes->bus.cpuRam[3]) << std::endl;
+    return 0;
+}
@@ -0,0 +1,256 @@
+// Runs the CPU against single instruction test vectors in the ProcessorTests / SingleStepTests
+// JSON layout: one file per opcode (00.json ... ff.json), each an array of cases like
+//   {"name": "a9 12 34", "initial": {"pc": 1234, "s": 253, "a": 0, "x": 0, "y": 0, "p": 36,
+//    "ram": [[1234, 169], [1235, 18]]}, "final": {...}, "cycles": [[1234, 169, "read"], ...]}
+//
+// Usage: ./cputest [-j threads] [--no-bus] dir [opcode ...]
+//
+// Every case runs one instruction on a bus where all 64 KB are plain RAM and is checked three
+// ways: the final registers and RAM, the cycle count, and the bus activity cycle by cycle (address,
+// value and direction of every access). --no-bus leaves the last one out. The cases of an opcode
+// are spread over all cores, one headless machine per worker. Opcodes the CPU does not implement
+// are skipped. Prints one line per opcode and exits with 0 only if every case passed.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "../Json.h"
+#include "../MappedFile.h"
+#include "../NES.h"
+#include "../ThreadPool.h"
+
+struct Worker {
+    std::unique_ptr<NES> nes;
+    std::vector<Bus::Access> accesses;
+};
+
+struct OpcodeResult {
+    std::atomic<int> passed{0};
+    std::atomic<int> stateFailures{0};
+    std::atomic<int> cycleFailures{0};
+    std::atomic<int> busFailures{0};
+    std::mutex mutex;
+    std::string firstFailure;
+};
+
+static std::string hex(int value, int digits) {
+    char text[8];
+    std::snprintf(text, sizeof(text), "%0*X", digits, value);
+    return text;
+}
+
+// First difference in registers or RAM, empty if there is none
+static std::string checkState(const NES& nes, const JsonValue& expected) {
+    const CPU& cpu = nes.cpu;
+    struct Register {
+        const char* name;
+        int actual;
+        int digits;
+    };
+    const Register registers[] = {
+        {"pc", cpu.PC, 4}, {"s", cpu.S, 2}, {"a", cpu.A, 2}, {"x", cpu.X, 2}, {"y", cpu.Y, 2}, {"p", cpu.P, 2},
+    };
+    for (const Register& reg : registers) {
+        int value = static_cast<int>(expected[reg.name].integer());
+        if (value != reg.actual) {
+            return std::string(reg.name) + " expected " + hex(value, reg.digits) + ", got " + hex(reg.actual, reg.digits);
+        }
+    }
+    Bus& bus = const_cast<Bus&>(nes.bus);
+    for (JsonValue cell : expected["ram"]) {
+        uint16_t address = static_cast<uint16_t>(cell.at(0).integer());
+        int value = static_cast<int>(cell.at(1).integer());
+        int actual = bus.testFallbackRAM(address);
+        if (value != actual) {
+            return "$" + hex(address, 4) + " expected " + hex(value, 2) + ", got " + hex(actual, 2);
+        }
+    }
+    return "";
+}
+
+static std::string describe(uint16_t address, int value, bool write) {
+    return std::string(write ? "write" : "read") + " $" + hex(address, 4) + " = " + hex(value, 2);
+}
+
+// First difference between the recorded accesses and the expected ones, empty if there is none
+static std::string checkBus(const std::vector<Bus::Access>& accesses, const JsonValue& cycles) {
+    size_t i = 0;
+    for (JsonValue cycle : cycles) {
+        uint16_t address = static_cast<uint16_t>(cycle.at(0).integer());
+        int value = static_cast<int>(cycle.at(1).integer());
+        bool write = cycle.at(2).string() == "write";
+        if (i >= accesses.size()) {
+            return "cycle " + std::to_string(i + 1) + ": expected " + describe(address, value, write) + ", got nothing";
+        }
+        const Bus::Access& actual = accesses[i];
+        if (actual.address != address || actual.value != value || actual.write != write) {
+            return "cycle " + std::to_string(i + 1) + ": expected " + describe(address, value, write) + ", got " +
+                   describe(actual.address, actual.value, actual.write);
+        }
+        i++;
+    }
+    if (i < accesses.size()) {
+        return "cycle " + std::to_string(i + 1) + ": expected nothing, got " +
+               describe(accesses[i].address, accesses[i].value, accesses[i].write);
+    }
+    return "";
+}
+
+static void runCase(Worker& worker, const JsonValue& test, bool compareBus, OpcodeResult& result) {
+    NES& nes = *worker.nes;
+    CPU& cpu = nes.cpu;
+    JsonValue initial = test["initial"];
+    cpu.PC = static_cast<uint16_t>(initial["pc"].integer());
+    cpu.S = static_cast<uint8_t>(initial["s"].integer());
+    cpu.A = static_cast<uint8_t>(initial["a"].integer());
+    cpu.X = static_cast<uint8_t>(initial["x"].integer());
+    cpu.Y = static_cast<uint8_t>(initial["y"].integer());
+    cpu.P = static_cast<uint8_t>(initial["p"].integer());
+    for (JsonValue cell : initial["ram"]) {
+        nes.bus.testFallbackRAM(static_cast<uint16_t>(cell.at(0).integer())) =
+            static_cast<uint8_t>(cell.at(1).integer());
+    }
+
+    worker.accesses.clear();
+    cpu.cycles = 0;
+    cpu.cycleExecute();
+    // cycleExecute() has already counted the first cycle down
+    size_t taken = static_cast<size_t>(cpu.cycles) + 1;
+
+    JsonValue cycles = test["cycles"];
+    std::string stateError = checkState(nes, test["final"]);
+    std::string cycleError;
+    if (taken != cycles.size()) {
+        cycleError = "took " + std::to_string(taken) + " cycles, expected " + std::to_string(cycles.size());
+    }
+    std::string busError = compareBus ? checkBus(worker.accesses, cycles) : "";
+
+    if (!stateError.empty()) result.stateFailures++;
+    if (!cycleError.empty()) result.cycleFailures++;
+    if (!busError.empty()) result.busFailures++;
+    if (stateError.empty() && cycleError.empty() && busError.empty()) {
+        result.passed++;
+        return;
+    }
+    std::lock_guard<std::mutex> lock(result.mutex);
+    if (result.firstFailure.empty()) {
+        const std::string& why = !stateError.empty() ? stateError : !cycleError.empty() ? cycleError : busError;
+        result.firstFailure = "\"" + std::string(test["name"].string()) + "\": " + why;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    int threads = 0;
+    bool compareBus = true;
+    std::string dir;
+    std::vector<int> selected;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-j" && i + 1 < argc) {
+            threads = std::atoi(argv[++i]);
+        } else if (arg == "--no-bus") {
+            compareBus = false;
+        } else if (dir.empty() && arg[0] != '-') {
+            dir = arg;
+        } else if (!dir.empty() && arg.size() == 2) {
+            selected.push_back(static_cast<int>(std::strtol(arg.c_str(), nullptr, 16)));
+        } else {
+            dir.clear();
+            break;
+        }
+    }
+    if (dir.empty()) {
+        std::cerr << "Usage: " << argv[0] << " [-j threads] [--no-bus] dir [opcode ...]" << std::endl;
+        return 2;
+    }
+    if (selected.empty()) {
+        for (int opcode = 0; opcode < 256; opcode++) {
+            selected.push_back(opcode);
+        }
+    }
+
+    ThreadPool pool(threads);
+    std::vector<Worker> workers(pool.size());
+    for (Worker& worker : workers) {
+        worker.nes = std::make_unique<NES>(false);
+        worker.nes->bus.flatMemory = true;
+        worker.nes->bus.accessLog = &worker.accesses;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    int opcodesRun = 0;
+    int opcodesPassed = 0;
+    long long casesRun = 0;
+    long long casesPassed = 0;
+    for (int opcode : selected) {
+        // The test sets name their files in lower case
+        char name[8];
+        std::snprintf(name, sizeof(name), "%02x.json", opcode);
+        std::string path = (std::filesystem::path(dir) / name).string();
+        if (!std::filesystem::exists(path)) {
+            continue;
+        }
+        if (CPU::instructionTable[opcode].operation == nullptr) {
+            std::cout << hex(opcode, 2) << "  not implemented, skipped" << std::endl;
+            continue;
+        }
+
+        MappedFile file;
+        JsonDocument document;
+        if (!file.open(path) ||
+            !document.parse(std::string_view(reinterpret_cast<const char*>(file.data()), file.size()))) {
+            std::cerr << path << ": " << document.error() << std::endl;
+            return 2;
+        }
+        std::vector<JsonValue> cases;
+        cases.reserve(document.root().size());
+        for (JsonValue test : document.root()) {
+            cases.push_back(test);
+        }
+
+        // A few chunks per worker so stealing evens out the tail
+        OpcodeResult result;
+        size_t chunks = static_cast<size_t>(pool.size()) * 4;
+        size_t chunkSize = (cases.size() + chunks - 1) / chunks;
+        for (size_t first = 0; first < cases.size(); first += chunkSize) {
+            size_t last = std::min(cases.size(), first + chunkSize);
+            pool.submit([&, first, last](int worker) {
+                for (size_t i = first; i < last; i++) {
+                    runCase(workers[worker], cases[i], compareBus, result);
+                }
+            });
+        }
+        pool.wait();
+
+        int passed = result.passed.load();
+        opcodesRun++;
+        casesRun += static_cast<long long>(cases.size());
+        casesPassed += passed;
+        std::cout << std::dec << hex(opcode, 2) << "  " << passed << "/" << cases.size() << " pass";
+        if (passed == static_cast<int>(cases.size())) {
+            opcodesPassed++;
+        } else {
+            std::cout << "  (state " << result.stateFailures << ", cycles " << result.cycleFailures;
+            if (compareBus) {
+                std::cout << ", bus " << result.busFailures;
+            }
+            std::cout << ")  first: " << result.firstFailure;
+        }
+        std::cout << std::endl;
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cerr << opcodesPassed << " of " << opcodesRun << " opcodes pass, " << casesPassed << " of " << casesRun
+              << " cases, " << pool.size() << " threads, " << seconds << " s" << std::endl;
+    return opcodesRun > 0 && opcodesPassed == opcodesRun ? 0 : 1;
+}
@@ -0,0 +1,553 @@
+// Runs ROM regression / input replay jobs on headless NES instances across a thread pool.
+//
+// Usage: ./nesbatch [-j threads] [--no-pin] [--dump-dir dir] [--trace-dir dir] [--profile-dir dir] [--library dir]
+//                   [--footprint] [--repeat-check] [--golden file [--update-golden]] manifest
+//
+// Manifest: one job per line, blank lines and lines starting with '#' are skipped.
+//   <rom> <frames> [movie=<file>] [hash=<frame>,<frame>...] [dump=<frame>,<frame>...]
+// Paths containing spaces go in double quotes. Movies are .nesm files or FCEUX .fm2 text movies
+// (Movie.h), replayed from their start state if they have one. Frame numbers count emulated frames
+// from power on (or the movie's start state), so hash=60 is taken after the 60th frame. With --library, <rom> may also name a cartridge by
+// content as crc32:<8 hex digits> or sha1:<40 hex digits>; the directory is indexed (reusing its
+// cache file) before any job starts, so manifests do not depend on where the dumps live.
+//
+// Every finished job prints one JSON object per line to stdout, e.g.
+//   {"job":0,"rom":"ROMs/DK.nes","frames":600,"ms":812.4,"worker":3,
+//    "checkpoints":[{"frame":60,"frame_hash":"9c1d...","state_hash":"51aa..."}],"dumps":["out/job0_60.png"]}
+// Every job also reports the bus activity of the whole run (PerfCounters.h) as a workload fingerprint,
+//   "counters":{"cpu_cycles":17868287,"instructions":5977553,"dma_transfers":598,"dma_stall_cycles":307044,
+//               "nmis":598,"irqs":0,"bank_switches":0,"ppu_writes":7266,"ppu_write_scanlines":137,"status_polls":3829}
+// where ppu_write_scanlines counts the visible lines that saw a PPU register write in any frame.
+// ROMs that speak blargg's test status protocol (signature at $6001) add their result as
+//   "test":{"status":0,"message":"..."}
+// where status 0x80 means the test was still running. Battery RAM is never read from or written to
+// .sav files here, every job starts from blank work RAM.
+// With --trace-dir every job also writes its CPU trace to <dir>/job<N>.trace (builds with
+// NES_TRACE only; expand with tools/tracefmt).
+// With --profile-dir every job profiles the game code into <dir>/job<N>.profile.txt, the sorted
+// report, and <dir>/job<N>.folded, collapsed stacks for flame graphs (builds with NES_PROFILE only).
+// With --golden every checkpoint is compared with the hashes recorded for it in a golden file, and
+// the job adds "golden":"match" or, at the first checkpoint that differs,
+//   "golden":{"diverged":300,"frame_hash":"...","expected_frame_hash":"...","png":"out/job0_300_diverged.png"}
+// with a PNG of that frame written to the dump directory. Checkpoints the golden file does not have
+// count as a difference. --update-golden rewrites the file from this run instead of comparing.
+// Golden file: one checkpoint per line, `<rom> <movie or -> <frame> <frame hash> <state hash>`,
+// with ROM and movie spelled as in the manifest.
+// With --repeat-check every job runs a second time on the same worker, on a machine built where the
+// first one was freed, and adds "repeat":"match" or "repeat":{"diverged":<frame>} at the first
+// checkpoint whose hashes differ between the runs. A difference means the machine state depends on
+// something other than the ROM and the input, such as leftover memory, and counts as a failure.
+// Jobs that cannot run print {"job":N,"rom":"...","error":"..."} instead. A summary goes to stderr,
+// followed with --footprint by the memory breakdown of one worker's machine.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "../Hash.h"
+#include "../Image.h"
+#include "../Log.h"
+#include "../Movie.h"
+#include "../NES.h"
+#include "../RomLibrary.h"
+#include "../ThreadPool.h"
+
+struct Job {
+    int index = 0;
+    std::string rom;
+    std::string key;        // ROM and movie as written in the manifest, names the job in golden files
+    int frames = 0;
+    std::string movie;
+    std::set<int> hashAt;
+    std::set<int> dumpAt;
+};
+
+// ---------------------------------------------------------------------------- //
+// --------------------------------- MANIFEST --------------------------------- //
+// ---------------------------------------------------------------------------- //
+
+static bool parseFrameList(const std::string& text, std::set<int>& frames) {
+    std::stringstream list(text);
+    std::string item;
+    while (std::getline(list, item, ',')) {
+        char* end = nullptr;
+        long frame = std::strtol(item.c_str(), &end, 10);
+        if (item.empty() || *end != '\0' || frame <= 0) {
+            return false;
+        }
+        frames.insert(static_cast<int>(frame));
+    }
+    return true;
+}
+
+static std::string goldenKey(const std::string& rom, const std::string& movie) {
+    std::ostringstream key;
+    key << std::quoted(rom) << " " << std::quoted(movie.empty() ? "-" : movie);
+    return key.str();
+}
+
+static bool readManifest(const std::string& path, std::vector<Job>& jobs) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open manifest: " << path << std::endl;
+        return false;
+    }
+
+    std::string line;
+    for (int number = 1; std::getline(file, line); number++) {
+        std::istringstream fields(line);
+        Job job;
+        if (!(fields >> std::quoted(job.rom)) || job.rom[0] == '#') {
+            continue;
+        }
+        bool ok = static_cast<bool>(fields >> job.frames) && job.frames > 0;
+
+        std::string option;
+        while (ok && fields >> std::quoted(option)) {
+            size_t equals = option.find('=');
+            std::string key = option.substr(0, equals);
+            std::string value = equals == std::string::npos ? "" : option.substr(equals + 1);
+            if (key == "movie" && !value.empty()) {
+                job.movie = value;
+            } else if (key == "hash") {
+                ok = parseFrameList(value, job.hashAt);
+            } else if (key == "dump") {
+                ok = parseFrameList(value, job.dumpAt);
+            } else {
+                ok = false;
+            }
+        }
+        if (!ok) {
+            std::cerr << path << ":" << number << ": expected <rom> <frames> [movie=file] [hash=f,...] [dump=f,...]" << std::endl;
+            return false;
+        }
+        job.index = static_cast<int>(jobs.size());
+        job.key = goldenKey(job.rom, job.movie);
+        jobs.push_back(job);
+    }
+    return true;
+}
+
+// Swaps crc32:/sha1: references for paths from the library. Returns false if one is not in it.
+static bool resolveRoms(std::vector<Job>& jobs, const RomLibrary* library) {
+    bool ok = true;
+    for (Job& job : jobs) {
+        bool byCrc = job.rom.rfind("crc32:", 0) == 0;
+        bool bySha1 = job.rom.rfind("sha1:", 0) == 0;
+        if (!byCrc && !bySha1) {
+            continue;
+        }
+        const RomEntry* entry = nullptr;
+        if (library != nullptr && byCrc) {
+            entry = library->findByCrc32(static_cast<uint32_t>(std::strtoul(job.rom.c_str() + 6, nullptr, 16)));
+        } else if (library != nullptr) {
+            entry = library->findBySha1(job.rom.substr(5));
+        }
+        if (entry == nullptr) {
+            std::cerr << "Job " << job.index << ": " << job.rom << (library ? " is not in the library" : " needs --library") << std::endl;
+            ok = false;
+            continue;
+        }
+        job.rom = entry->path;
+    }
+    return ok;
+}
+
+// ---------------------------------------------------------------------------- //
+// ---------------------------------- GOLDEN ---------------------------------- //
+// ---------------------------------------------------------------------------- //
+
+struct Checkpoint {
+    int frame = 0;
+    uint64_t frameHash = 0;
+    uint64_t stateHash = 0;
+};
+
+// Checkpoints by job key and frame
+using Golden = std::map<std::pair<std::string, int>, Checkpoint>;
+
+static bool readGolden(const std::string& path, Golden& golden) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open golden file: " << path << std::endl;
+        return false;
+    }
+    std::string line;
+    for (int number = 1; std::getline(file, line); number++) {
+        std::istringstream fields(line);
+        std::string rom;
+        std::string movie;
+        Checkpoint checkpoint;
+        if (!(fields >> std::quoted(rom)) || rom[0] == '#') {
+            continue;
+        }
+        if (!(fields >> std::quoted(movie) >> checkpoint.frame >> std::hex >> checkpoint.frameHash >> checkpoint.stateHash)) {
+            std::cerr << path << ":" << number << ": expected <rom> <movie> <frame> <frame hash> <state hash>" << std::endl;
+            return false;
+        }
+        golden[{goldenKey(rom, movie == "-" ? "" : movie), checkpoint.frame}] = checkpoint;
+    }
+    return true;
+}
+
+static bool writeGolden(const std::string& path, const std::vector<Job>& jobs,
+                        const std::vector<std::vector<Checkpoint>>& results) {
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        std::cerr << "Failed to write golden file: " << path << std::endl;
+        return false;
+    }
+    file << "# Written by nesbatch --update-golden: <rom> <movie> <frame> <frame hash> <state hash>\n";
+    for (const Job& job : jobs) {
+        for (const Checkpoint& checkpoint : results[job.index]) {
+            char hashes[40];
+            std::snprintf(hashes, sizeof(hashes), "%016llx %016llx", static_cast<unsigned long long>(checkpoint.frameHash),
+                          static_cast<unsigned long long>(checkpoint.stateHash));
+            file << job.key << " " << checkpoint.frame << " " << hashes << "\n";
+        }
+    }
+    return file.good();
+}
+
+// ---------------------------------------------------------------------------- //
+// ----------------------------------- JOBS ----------------------------------- //
+// ---------------------------------------------------------------------------- //
+
+static std::string jsonString(const std::string& text) {
+    std::string out = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out += escaped;
+        } else {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+static std::string hex64(uint64_t value) {
+    char text[17];
+    std::snprintf(text, sizeof(text), "%016llx", static_cast<unsigned long long>(value));
+    return text;
+}
+
+static std::string countersJson(const PerfCounters& counters) {
+    std::ostringstream json;
+    json << "{\"cpu_cycles\":" << counters.cpuCycles << ",\"instructions\":" << counters.instructions
+         << ",\"dma_transfers\":" << counters.dmaTransfers << ",\"dma_stall_cycles\":" << counters.dmaStallCycles
+         << ",\"nmis\":" << counters.nmis << ",\"irqs\":" << counters.irqs << ",\"bank_switches\":" << counters.bankSwitches
+         << ",\"ppu_writes\":" << counters.ppuWrites << ",\"ppu_write_scanlines\":" << counters.scanlinesWithWrites()
+         << ",\"status_polls\":" << counters.statusPolls << "}";
+    return json.str();
+}
+
+// One headless machine per worker. Every job gets a freshly built one, so its result does not
+// depend on which jobs ran on the worker before it. The old one is freed first and the new one
+// usually takes its place, so leftover state in it would show up (see --repeat-check). Restoring
+// a power-on snapshot instead does not work across cartridges: the snapshot includes the mapper
+// registers, which differ per board.
+struct Worker {
+    std::unique_ptr<NES> nes;
+    std::vector<uint8_t> state;
+};
+
+// `golden` is null unless checkpoints are compared; every checkpoint taken is appended to `taken`
+static std::string runJob(const Job& job, Worker& worker, int workerIndex, const std::string& dumpDir,
+                          const std::string& traceDir, const std::string& profileDir, const Golden* golden,
+                          std::vector<Checkpoint>& taken) {
+    auto start = std::chrono::steady_clock::now();
+    std::ostringstream json;
+    json << "{\"job\":" << job.index << ",\"rom\":" << jsonString(job.rom);
+
+    Movie movie;
+    if (!job.movie.empty() && !movie.load(job.movie)) {
+        json << ",\"error\":" << jsonString("cannot load movie " + job.movie) << "}";
+        return json.str();
+    }
+
+    worker.nes.reset();
+    worker.nes = std::make_unique<NES>(false);
+    NES& nes = *worker.nes;
+    nes.rom.useSaveFiles = false;
+    if (!nes.load_rom(job.rom.c_str())) {
+        json << ",\"error\":\"cannot load rom\"}";
+        return json.str();
+    }
+    nes.initNES();
+    if (!movie.startState.empty() && !nes.loadState(movie.startState)) {
+        json << ",\"error\":\"movie start state does not match this build\"}";
+        return json.str();
+    }
+    if (!traceDir.empty() && !nes.startTrace(traceDir + "/job" + std::to_string(job.index) + ".trace")) {
+        json << ",\"error\":\"cannot create trace\"}";
+        return json.str();
+    }
+    if (!profileDir.empty()) {
+        nes.startProfile();
+    }
+    // The movie feeds controller 1 at every strobe from here on
+    movie.startPlayback(nes.bus.ppu.total_frames);
+    nes.bus.movie = &movie;
+
+    std::ostringstream checkpoints;
+    std::ostringstream dumps;
+    std::string divergence;
+    for (int frame = 1; frame <= job.frames; frame++) {
+        bool hash = job.hashAt.count(frame) != 0;
+        bool dump = job.dumpAt.count(frame) != 0;
+
+        // Pixels are only composed for frames somebody looks at
+        if (hash || dump) {
+            nes.run_frame();
+        } else {
+            nes.skip_frame();
+        }
+
+        if (hash) {
+            nes.saveState(worker.state);
+            Checkpoint checkpoint;
+            checkpoint.frame = frame;
+            checkpoint.frameHash = xxhash64(nes.bus.ppu.framebuffer, sizeof(nes.bus.ppu.framebuffer));
+            checkpoint.stateHash = xxhash64(worker.state.data(), worker.state.size());
+            taken.push_back(checkpoint);
+            checkpoints << (checkpoints.tellp() > 0 ? "," : "") << "{\"frame\":" << frame
+                        << ",\"frame_hash\":\"" << hex64(checkpoint.frameHash)
+                        << "\",\"state_hash\":\"" << hex64(checkpoint.stateHash) << "\"}";
+
+            // Only the first difference is reported; everything after it usually differs too
+            if (golden != nullptr && divergence.empty()) {
+                auto expected = golden->find({job.key, frame});
+                if (expected == golden->end()) {
+                    divergence = "{\"diverged\":" + std::to_string(frame) + ",\"missing\":true}";
+                } else if (expected->second.frameHash != checkpoint.frameHash ||
+                           expected->second.stateHash != checkpoint.stateHash) {
+                    std::string path = dumpDir + "/job" + std::to_string(job.index) + "_" + std::to_string(frame) + "_diverged.png";
+                    divergence = "{\"diverged\":" + std::to_string(frame) +
+                                 ",\"frame_hash\":\"" + hex64(checkpoint.frameHash) +
+                                 "\",\"expected_frame_hash\":\"" + hex64(expected->second.frameHash) +
+                                 "\",\"state_hash\":\"" + hex64(checkpoint.stateHash) +
+                                 "\",\"expected_state_hash\":\"" + hex64(expected->second.stateHash) + "\"";
+                    if (writePNG(path, nes.bus.ppu.rgbFrame(), 256, 240)) {
+                        divergence += ",\"png\":" + jsonString(path);
+                    }
+                    divergence += "}";
+                }
+            }
+        }
+        if (dump) {
+            std::string path = dumpDir + "/job" + std::to_string(job.index) + "_" + std::to_string(frame) + ".png";
+            if (writePNG(path, nes.bus.ppu.rgbFrame(), 256, 240)) {
+                dumps << (dumps.tellp() > 0 ? "," : "") << jsonString(path);
+            }
+        }
+    }
+
+    nes.stopTrace();
+    nes.bus.movie = nullptr;
+    if (!profileDir.empty()) {
+        std::string base = profileDir + "/job" + std::to_string(job.index);
+        nes.stopProfile(base + ".profile.txt", base + ".folded");
+    }
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    json << ",\"frames\":" << job.frames << ",\"ms\":" << std::fixed << std::setprecision(1) << ms
+         << ",\"worker\":" << workerIndex << ",\"checkpoints\":[" << checkpoints.str() << "]"
+         << ",\"dumps\":[" << dumps.str() << "]" << ",\"counters\":" << countersJson(nes.totalCounters);
+    if (golden != nullptr) {
+        json << ",\"golden\":" << (divergence.empty() ? "\"match\"" : divergence);
+    }
+    uint8_t status = 0;
+    std::string message;
+    if (nes.rom.readTestStatus(status, message)) {
+        json << ",\"test\":{\"status\":" << static_cast<int>(status) << ",\"message\":" << jsonString(message) << "}";
+    }
+    json << "}";
+    return json.str();
+}
+
+// "match", or the first checkpoint at which a second run of the same job took different hashes
+static std::string compareRuns(const std::vector<Checkpoint>& first, const std::vector<Checkpoint>& second) {
+    for (size_t i = 0; i < first.size(); i++) {
+        if (i >= second.size() || first[i].frameHash != second[i].frameHash || first[i].stateHash != second[i].stateHash) {
+            return "{\"diverged\":" + std::to_string(first[i].frame) + "}";
+        }
+    }
+    return "\"match\"";
+}
+
+// ---------------------------------------------------------------------------- //
+// ----------------------------------- MAIN ----------------------------------- //
+// ---------------------------------------------------------------------------- //
+
+int main(int argc, char* argv[]) {
+    int threads = 0;
+    bool pin = true;
+    bool footprint = false;
+    bool updateGolden = false;
+    bool repeatCheck = false;
+    std::string goldenPath;
+    std::string dumpDir = ".";
+    std::string traceDir;
+    std::string profileDir;
+    std::string libraryDir;
+    std::string manifest;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-j" && i + 1 < argc) {
+            threads = std::atoi(argv[++i]);
+        } else if (arg == "--no-pin") {
+            pin = false;
+        } else if (arg == "--footprint") {
+            footprint = true;
+        } else if (arg == "--dump-dir" && i + 1 < argc) {
+            dumpDir = argv[++i];
+        } else if (arg == "--trace-dir" && i + 1 < argc) {
+            traceDir = argv[++i];
+        } else if (arg == "--profile-dir" && i + 1 < argc) {
+            profileDir = argv[++i];
+        } else if (arg == "--golden" && i + 1 < argc) {
+            goldenPath = argv[++i];
+        } else if (arg == "--update-golden") {
+            updateGolden = true;
+        } else if (arg == "--repeat-check") {
+            repeatCheck = true;
+        } else if (arg == "--library" && i + 1 < argc) {
+            libraryDir = argv[++i];
+        } else if (manifest.empty() && arg[0] != '-') {
+            manifest = arg;
+        } else {
+            manifest.clear();
+            break;
+        }
+    }
+    if (manifest.empty() || (updateGolden && goldenPath.empty())) {
+        std::cerr << "Usage: " << argv[0] << " [-j threads] [--no-pin] [--dump-dir dir] [--trace-dir dir] [--profile-dir dir]"
+                  << " [--library dir] [--footprint] [--repeat-check] [--golden file [--update-golden]] manifest" << std::endl;
+        return 2;
+    }
+
+    std::vector<Job> jobs;
+    if (!readManifest(manifest, jobs)) {
+        return 2;
+    }
+    Golden golden;
+    bool compareGolden = !goldenPath.empty() && !updateGolden;
+    if (compareGolden && !readGolden(goldenPath, golden)) {
+        return 2;
+    }
+
+    // The core logs to stderr (Log.h), stdout only carries results. Per job notes such as the
+    // loaded cartridge would drown the summary, warnings and errors still show.
+    Log::setLevel(Log::LEVEL_WARN);
+
+    ThreadPool pool(threads, pin);
+
+    // Index the library on the same pool before the machines are built
+    RomLibrary library;
+    if (!libraryDir.empty()) {
+        std::string cache = libraryDir + "/" + RomLibrary::CACHE_FILE;
+        RomLibrary::ScanStats stats;
+        library.loadCache(cache);
+        if (!library.scan(libraryDir, pool, &stats)) {
+            return 2;
+        }
+        library.saveCache(cache);
+        std::cerr << "Library: " << stats.files << " ROMs (" << stats.hashed << " hashed, " << stats.reused
+                  << " cached, " << stats.invalid << " invalid)" << std::endl;
+    }
+    if (!resolveRoms(jobs, libraryDir.empty() ? nullptr : &library)) {
+        return 2;
+    }
+
+    std::vector<Worker> workers(pool.size());
+    for (Worker& worker : workers) {
+        worker.nes = std::make_unique<NES>(false);
+    }
+
+    std::mutex outputMutex;
+    long long totalFrames = 0;
+    int failed = 0;
+    int diverged = 0;
+    int repeatDiverged = 0;
+    std::vector<std::vector<Checkpoint>> checkpoints(jobs.size());
+    auto start = std::chrono::steady_clock::now();
+    for (const Job& job : jobs) {
+        pool.submit([&, job](int workerIndex) {
+            std::string line = runJob(job, workers[workerIndex], workerIndex, dumpDir, traceDir, profileDir,
+                                      compareGolden ? &golden : nullptr, checkpoints[job.index]);
+            if (repeatCheck && line.find("\"error\"") == std::string::npos) {
+                std::vector<Checkpoint> again;
+                runJob(job, workers[workerIndex], workerIndex, dumpDir, "", "", nullptr, again);
+                line.insert(line.size() - 1, ",\"repeat\":" + compareRuns(checkpoints[job.index], again));
+            }
+            std::lock_guard<std::mutex> lock(outputMutex);
+            std::printf("%s\n", line.c_str());
+            std::fflush(stdout);
+            if (line.find("\"error\"") != std::string::npos) {
+                failed++;
+            } else {
+                totalFrames += job.frames;
+            }
+            if (line.find("\"golden\":{") != std::string::npos) {
+                diverged++;
+            }
+            if (line.find("\"repeat\":{") != std::string::npos) {
+                repeatDiverged++;
+                failed++;
+            }
+        });
+    }
+    pool.wait();
+    Log::flush();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cerr << jobs.size() << " jobs (" << failed << " failed) on " << pool.size() << " threads in " << std::fixed
+              << std::setprecision(2) << seconds << " s, " << std::setprecision(0) << totalFrames / seconds
+              << " frames/s" << std::endl;
+    if (compareGolden) {
+        std::cerr << (diverged == 0 ? "All jobs match " : std::to_string(diverged) + " jobs differ from ") << goldenPath << std::endl;
+    }
+    if (repeatCheck) {
+        std::cerr << (repeatDiverged == 0 ? "All jobs repeat exactly"
+                                          : std::to_string(repeatDiverged) + " jobs differ between two runs") << std::endl;
+    }
+    if (updateGolden) {
+        if (failed > 0) {
+            std::cerr << "Not updating " << goldenPath << ": jobs failed" << std::endl;
+        } else if (writeGolden(goldenPath, jobs, checkpoints)) {
+            std::cerr << "Wrote " << goldenPath << std::endl;
+        } else {
+            failed++;
+        }
+    }
+
+    if (footprint) {
+        workers[0].nes->reportFootprint(std::cerr);
+#ifdef _SC_LEVEL2_CACHE_SIZE
+        long l2 = sysconf(_SC_LEVEL2_CACHE_SIZE);
+        if (l2 > 0) {
+            std::cerr << "  L2 cache " << l2 << " bytes per core" << std::endl;
+        }
+#endif
+    }
+
+    return failed == 0 && diverged == 0 ? 0 : 1;
+}
@@ -0,0 +1,48 @@
+// Expands a binary CPU trace (Trace.h) into nestest.log style text.
+//
+// Usage: ./tracefmt trace [output]
+//
+// Writes to stdout without an output file. The trace is mapped rather than read, so traces of
+// whole play sessions convert in constant memory.
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "../MappedFile.h"
+#include "../Trace.h"
+
+int main(int argc, char** argv) {
+    if (argc < 2 || argc > 3) {
+        std::cerr << "Usage: " << argv[0] << " trace [output]" << std::endl;
+        return 2;
+    }
+
+    MappedFile file;
+    if (!file.open(argv[1])) {
+        return 1;
+    }
+    const TraceRecord* records = nullptr;
+    size_t count = 0;
+    if (!parseTraceFile(file.data(), file.size(), records, count)) {
+        std::cerr << "Not a trace file: " << argv[1] << std::endl;
+        return 1;
+    }
+
+    std::ofstream output;
+    if (argc == 3) {
+        output.open(argv[2]);
+        if (!output.is_open()) {
+            std::cerr << "Failed to create " << argv[2] << std::endl;
+            return 1;
+        }
+    }
+    std::ostream& out = argc == 3 ? output : std::cout;
+    for (size_t i = 0; i < count; i++) {
+        out << formatTraceLine(records[i]) << '\n';
+    }
+    out.flush();
+    std::cerr << count << " instructions" << std::endl;
+    return out ? 0 : 1;
+}